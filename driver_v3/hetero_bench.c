@@ -0,0 +1,590 @@
+/* hetero_bench.c - RT核中断延迟与周期抖动测量
+ *
+ * 配合RT核固件 firmware/rt_core/rt_bench.c:
+ *   - IPI延迟: hrtimer每ipi_us微秒写入时间戳并给RT核发IPI,
+ *     RT核醒来后第一时间读时基, 差值计入ipi直方图
+ *   - 释放抖动: RT执行器运行一个周期为period_us的空任务,
+ *     作业开始执行距名义释放时刻的周期数计入jitter直方图
+ *   - 压力: 每个Linux hart可绑定一个线程, 反复拷贝大块DDR内存并
+ *     非缓存读取共享SRAM/寄存器, 占满DDR控制器和系统总线
+ *
+ * 直方图由RT核写在共享内存缓冲池的测量块里, 通过debugfs读取:
+ *   /sys/kernel/debug/hetero_bench/control          写 start / stop / reset
+ *   /sys/kernel/debug/hetero_bench/stress           写 压力线程数
+ *   /sys/kernel/debug/hetero_bench/ipi_latency
+ *   /sys/kernel/debug/hetero_bench/release_jitter
+ *   /sys/kernel/debug/hetero_bench/bus             小核总线等待 (自start起), 写0/1开关总线QoS
+ *   /sys/kernel/debug/hetero_bench/l2              各主设备L2命中率 (自start起), 写入L2_CTRL
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "hetero_regs.h"
+
+#define DRIVER_NAME "hetero_bench"
+
+/* 测量用的RT任务: 最高优先级的空任务 */
+#define BENCH_TASK      (HETERO_RT_MAX_TASKS - 1)
+
+static unsigned int ipi_us = 1000;
+module_param(ipi_us, uint, 0644);
+MODULE_PARM_DESC(ipi_us, "IPI latency probe interval (us)");
+
+static unsigned int period_us = 1000;
+module_param(period_us, uint, 0644);
+MODULE_PARM_DESC(period_us, "Period of the RT benchmark task (us)");
+
+static unsigned int bin_shift = 4;
+module_param(bin_shift, uint, 0644);
+MODULE_PARM_DESC(bin_shift, "Histogram bin width, log2 of timebase cycles");
+
+static unsigned int stress_kb = 4096;
+module_param(stress_kb, uint, 0644);
+MODULE_PARM_DESC(stress_kb, "DDR buffer per stress thread (KB), should exceed L2");
+
+struct hetero_bench_stress {
+    struct task_struct *task;
+    u8 *buf;
+    size_t size;
+    u32 sink;
+};
+
+struct hetero_bench {
+    struct mutex lock;
+    struct dentry *dir;
+
+    /* 共享内存中的测量块, 停止后保留供读取 */
+    struct hetero_rt_bench *blk;
+    u32 blk_bus;
+    bool attached;              /* RT核可能还在写blk, 直到RT_BENCH 0得到应答 */
+    bool running;
+
+    struct hrtimer ipi_timer;
+    ktime_t ipi_interval;
+    u32 ipi_sent;
+    u32 ipi_missed;             /* 上一个IPI还没被RT核测量, 本次不发 */
+
+    struct hetero_bench_stress stress[HETERO_NUM_HARTS];
+    int nr_stress;
+
+    /* start时的总线计数 */
+    u32 bus_wait0[HETERO_NUM_SMALL_CORES];
+    u32 bus_xfer0[HETERO_NUM_SMALL_CORES];
+    u32 l2_hit0[L2_NUM_SOURCES];
+    u32 l2_miss0[L2_NUM_SOURCES];
+};
+
+static struct hetero_bench hb;
+
+/* IPI探测 ---------------------------------------------------------------- */
+
+static enum hrtimer_restart hetero_bench_ipi_fire(struct hrtimer *timer)
+{
+    struct hetero_rt_bench *b = hb.blk;
+    u32 seq = READ_ONCE(b->ipi_seq);
+
+    if (READ_ONCE(b->ipi_seen) != seq) {
+        hb.ipi_missed++;
+    } else {
+        /* 先写时间戳再递增seq, RT核按seq判断是否为测量IPI */
+        WRITE_ONCE(b->ipi_stamp, (u32)hetero_read_cycles());
+        wmb();
+        WRITE_ONCE(b->ipi_seq, seq + 1);
+        hetero_kick_core(HETERO_CORE_RT);
+        hb.ipi_sent++;
+    }
+
+    hrtimer_forward_now(timer, hb.ipi_interval);
+    return HRTIMER_RESTART;
+}
+
+/* 压力线程 ---------------------------------------------------------------- */
+
+static int hetero_bench_stress_fn(void *data)
+{
+    struct hetero_bench_stress *st = data;
+    size_t half = st->size / 2;
+    u8 *shm = hetero_shared_mem();
+    u32 sink = 0;
+    int i;
+
+    while (!kthread_should_stop()) {
+        /* DDR: 缓冲区大于L2, 每次拷贝都落到DDR控制器 */
+        memcpy(st->buf + half, st->buf, half);
+
+        /* 系统总线: 非缓存读共享SRAM和IPI寄存器 */
+        for (i = 0; i < HETERO_SHM_POOL_OFFSET; i += 4)
+            sink += READ_ONCE(*(u32 *)(shm + i));
+        for (i = 0; i < 256; i++)
+            sink += hetero_reg_read(IPI_STATUS_OFFSET);
+
+        cond_resched();
+    }
+
+    st->sink = sink;
+    return 0;
+}
+
+static void hetero_bench_stress_stop(void)
+{
+    struct hetero_bench_stress *st;
+
+    while (hb.nr_stress > 0) {
+        st = &hb.stress[--hb.nr_stress];
+        kthread_stop(st->task);
+        vfree(st->buf);
+        st->task = NULL;
+        st->buf = NULL;
+    }
+}
+
+/* 调整压力线程数, 每个线程绑定一个在线hart */
+static int hetero_bench_stress_set(unsigned int n)
+{
+    struct hetero_bench_stress *st;
+    struct task_struct *task;
+
+    if (n > HETERO_NUM_HARTS || n > num_online_cpus())
+        return -EINVAL;
+
+    hetero_bench_stress_stop();
+
+    while (hb.nr_stress < n) {
+        st = &hb.stress[hb.nr_stress];
+        st->size = (size_t)stress_kb * 1024;
+        st->buf = vzalloc(st->size);
+        if (!st->buf)
+            goto err;
+
+        task = kthread_create_on_cpu(hetero_bench_stress_fn, st, hb.nr_stress,
+                                     "hetero_stress/%u");
+        if (IS_ERR(task)) {
+            vfree(st->buf);
+            st->buf = NULL;
+            goto err;
+        }
+
+        st->task = task;
+        wake_up_process(task);
+        hb.nr_stress++;
+    }
+
+    return 0;
+err:
+    hetero_bench_stress_stop();
+    return -ENOMEM;
+}
+
+/* 测量控制 ---------------------------------------------------------------- */
+
+static void hetero_bench_bus_snapshot(void)
+{
+    int core;
+
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        hb.bus_wait0[core] = hetero_reg_read(BUS_WAIT_OFFSET(core));
+        hb.bus_xfer0[core] = hetero_reg_read(BUS_XFER_OFFSET(core));
+    }
+}
+
+static void hetero_bench_l2_snapshot(void)
+{
+    int src;
+
+    for (src = 0; src < L2_NUM_SOURCES; src++) {
+        hb.l2_hit0[src] = hetero_reg_read(L2_HIT_OFFSET(src));
+        hb.l2_miss0[src] = hetero_reg_read(L2_MISS_OFFSET(src));
+    }
+}
+
+/* 让RT核停止写测量块; 没有应答时块不能再交给缓冲池 */
+static void hetero_bench_detach(void)
+{
+    int ret;
+
+    ret = hetero_rt_config(HETERO_MSG_RT_BENCH, 0, 0);
+    if (ret) {
+        pr_warn("%s: RT核未确认停止测量 (%d), 测量块不释放\n", DRIVER_NAME, ret);
+        return;
+    }
+    hb.attached = false;
+}
+
+static int hetero_bench_start(void)
+{
+    int ret;
+
+    if (hb.running)
+        return -EBUSY;
+    if (!period_us || !ipi_us || bin_shift >= 32)
+        return -EINVAL;
+
+    if (!hb.blk) {
+        hb.blk = hetero_buf_alloc(sizeof(*hb.blk), &hb.blk_bus);
+        if (!hb.blk)
+            return -ENOMEM;
+    }
+    memset(hb.blk, 0, sizeof(*hb.blk));
+    hb.ipi_sent = 0;
+    hb.ipi_missed = 0;
+    hetero_bench_bus_snapshot();
+    hetero_bench_l2_snapshot();
+
+    hb.attached = true;
+    ret = hetero_rt_config(HETERO_MSG_RT_BENCH, hb.blk_bus, bin_shift);
+    if (ret && ret != -ETIMEDOUT) {
+        hb.attached = false;
+        return ret;
+    }
+
+    if (!ret)
+        ret = hetero_rt_config(HETERO_MSG_RT_TASK_SET,
+                               BENCH_TASK | (HETERO_RT_FN_NOP << 16), period_us);
+    if (!ret)
+        ret = hetero_rt_config(HETERO_MSG_RT_START, BIT(BENCH_TASK), 0);
+    if (ret) {
+        hetero_bench_detach();
+        return ret;
+    }
+
+    hb.ipi_interval = us_to_ktime(ipi_us);
+    hrtimer_start(&hb.ipi_timer, hb.ipi_interval, HRTIMER_MODE_REL);
+    hb.running = true;
+
+    pr_info("%s: 开始测量, IPI间隔%uus, 任务周期%uus, 压力线程%d\n",
+            DRIVER_NAME, ipi_us, period_us, hb.nr_stress);
+    return 0;
+}
+
+static void hetero_bench_stop(void)
+{
+    if (!hb.running)
+        return;
+
+    hrtimer_cancel(&hb.ipi_timer);
+    if (hetero_rt_config(HETERO_MSG_RT_STOP, BIT(BENCH_TASK), 0))
+        pr_warn("%s: RT核未确认停止测量任务\n", DRIVER_NAME);
+    hetero_bench_detach();
+    hb.running = false;
+}
+
+/* debugfs ------------------------------------------------------------------ */
+
+static u64 hetero_bench_ns(u64 cycles)
+{
+    return div_u64(cycles * NSEC_PER_SEC, HETERO_TIMEBASE_HZ);
+}
+
+static void hetero_bench_show_hist(struct seq_file *s, bool jitter)
+{
+    struct hetero_rt_bench_hist h;
+    u32 shift;
+    u64 sum;
+    int i;
+
+    mutex_lock(&hb.lock);
+    if (!hb.blk || READ_ONCE(hb.blk->magic) != HETERO_RT_BENCH_MAGIC) {
+        mutex_unlock(&hb.lock);
+        seq_puts(s, "RT核尚未开始测量\n");
+        return;
+    }
+
+    /* RT核还在更新, 各字段不是同一时刻的快照 */
+    memcpy(&h, jitter ? &hb.blk->jitter : &hb.blk->ipi, sizeof(h));
+    shift = READ_ONCE(hb.blk->bin_shift);
+    mutex_unlock(&hb.lock);
+
+    sum = ((u64)h.sum_hi << 32) | h.sum_lo;
+    seq_printf(s, "samples  %u\n", h.count);
+    if (!h.count)
+        return;
+
+    seq_printf(s, "min      %u cycles (%llu ns)\n", h.min, hetero_bench_ns(h.min));
+    seq_printf(s, "max      %u cycles (%llu ns)\n", h.max, hetero_bench_ns(h.max));
+    seq_printf(s, "avg      %llu cycles (%llu ns)\n", div_u64(sum, h.count),
+               hetero_bench_ns(div_u64(sum, h.count)));
+    seq_printf(s, "overflow %u (>= %llu ns)\n", h.overflow,
+               hetero_bench_ns((u64)HETERO_RT_BENCH_BINS << shift));
+
+    for (i = 0; i < HETERO_RT_BENCH_BINS; i++) {
+        if (!h.bin[i])
+            continue;
+        seq_printf(s, "%8llu - %8llu ns: %u\n",
+                   hetero_bench_ns((u64)i << shift),
+                   hetero_bench_ns((u64)(i + 1) << shift) - 1, h.bin[i]);
+    }
+}
+
+static int ipi_latency_show(struct seq_file *s, void *unused)
+{
+    hetero_bench_show_hist(s, false);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ipi_latency);
+
+static int release_jitter_show(struct seq_file *s, void *unused)
+{
+    hetero_bench_show_hist(s, true);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(release_jitter);
+
+static int hetero_bench_control_show(struct seq_file *s, void *unused)
+{
+    mutex_lock(&hb.lock);
+    seq_printf(s, "state      %s\n", hb.running ? "running" : "stopped");
+    seq_printf(s, "ipi_us     %u\n", ipi_us);
+    seq_printf(s, "period_us  %u\n", period_us);
+    seq_printf(s, "stress     %d\n", hb.nr_stress);
+    seq_printf(s, "ipi_sent   %u\n", hb.ipi_sent);
+    seq_printf(s, "ipi_missed %u\n", hb.ipi_missed);
+    mutex_unlock(&hb.lock);
+    return 0;
+}
+
+static int hetero_bench_control_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hetero_bench_control_show, NULL);
+}
+
+static ssize_t hetero_bench_control_write(struct file *file, const char __user *ubuf,
+                                          size_t count, loff_t *ppos)
+{
+    char cmd[16];
+    int ret = 0;
+
+    if (count >= sizeof(cmd))
+        return -EINVAL;
+    if (copy_from_user(cmd, ubuf, count))
+        return -EFAULT;
+    cmd[count] = '\0';
+
+    mutex_lock(&hb.lock);
+    if (sysfs_streq(cmd, "start")) {
+        ret = hetero_bench_start();
+    } else if (sysfs_streq(cmd, "stop")) {
+        hetero_bench_stop();
+    } else if (sysfs_streq(cmd, "reset")) {
+        /* RT核正在写直方图时不能清零 */
+        if (hb.running)
+            ret = -EBUSY;
+        else if (hb.blk)
+            memset(&hb.blk->ipi, 0, 2 * sizeof(hb.blk->ipi));
+    } else {
+        ret = -EINVAL;
+    }
+    mutex_unlock(&hb.lock);
+
+    return ret ? ret : count;
+}
+
+static const struct file_operations hetero_bench_control_fops = {
+    .owner   = THIS_MODULE,
+    .open    = hetero_bench_control_open,
+    .read    = seq_read,
+    .write   = hetero_bench_control_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+static int hetero_bench_stress_show(struct seq_file *s, void *unused)
+{
+    seq_printf(s, "%d\n", hb.nr_stress);
+    return 0;
+}
+
+static int hetero_bench_stress_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hetero_bench_stress_show, NULL);
+}
+
+static ssize_t hetero_bench_stress_write(struct file *file, const char __user *ubuf,
+                                         size_t count, loff_t *ppos)
+{
+    unsigned int n;
+    int ret;
+
+    ret = kstrtouint_from_user(ubuf, count, 0, &n);
+    if (ret)
+        return ret;
+
+    mutex_lock(&hb.lock);
+    ret = hetero_bench_stress_set(n);
+    mutex_unlock(&hb.lock);
+
+    return ret ? ret : count;
+}
+
+static const struct file_operations hetero_bench_stress_fops = {
+    .owner   = THIS_MODULE,
+    .open    = hetero_bench_stress_open,
+    .read    = seq_read,
+    .write   = hetero_bench_stress_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+/* 每次传输的平均等待周期, 两位小数 */
+static int hetero_bench_bus_show(struct seq_file *s, void *unused)
+{
+    u32 wait, xfer, avg;
+    int core;
+
+    mutex_lock(&hb.lock);
+    seq_printf(s, "qos %s\n", hetero_reg_read(BUS_QOS_CTRL_OFFSET) & 1 ? "rt-first" : "round-robin");
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        wait = hetero_reg_read(BUS_WAIT_OFFSET(core)) - hb.bus_wait0[core];
+        xfer = hetero_reg_read(BUS_XFER_OFFSET(core)) - hb.bus_xfer0[core];
+        avg = xfer ? (u32)div_u64((u64)wait * 100, xfer) : 0;
+        seq_printf(s, "core%d wait %u xfer %u avg %u.%02u cycles/xfer\n",
+                   core, wait, xfer, avg / 100, avg % 100);
+    }
+    mutex_unlock(&hb.lock);
+    return 0;
+}
+
+static int hetero_bench_bus_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hetero_bench_bus_show, NULL);
+}
+
+static ssize_t hetero_bench_bus_write(struct file *file, const char __user *ubuf,
+                                      size_t count, loff_t *ppos)
+{
+    unsigned int on;
+    int ret;
+
+    ret = kstrtouint_from_user(ubuf, count, 0, &on);
+    if (ret)
+        return ret;
+
+    mutex_lock(&hb.lock);
+    hetero_reg_write(BUS_QOS_CTRL_OFFSET, !!on);
+    hetero_bench_bus_snapshot();
+    mutex_unlock(&hb.lock);
+
+    return count;
+}
+
+static const struct file_operations hetero_bench_bus_fops = {
+    .owner   = THIS_MODULE,
+    .open    = hetero_bench_bus_open,
+    .read    = seq_read,
+    .write   = hetero_bench_bus_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+/* 各主设备L2命中率, 两位小数 */
+static const char * const l2_source_name[L2_NUM_SOURCES] = { "io", "rt", "main" };
+
+static int hetero_bench_l2_show(struct seq_file *s, void *unused)
+{
+    u32 ctrl, hit, miss, rate;
+    int src;
+
+    mutex_lock(&hb.lock);
+    ctrl = hetero_reg_read(L2_CTRL_OFFSET);
+    seq_printf(s, "ctrl 0x%x partition %s\n", ctrl,
+               ctrl & L2_CTRL_PARTITION ? "rt-way" : "off");
+    for (src = 0; src < L2_NUM_SOURCES; src++) {
+        hit = hetero_reg_read(L2_HIT_OFFSET(src)) - hb.l2_hit0[src];
+        miss = hetero_reg_read(L2_MISS_OFFSET(src)) - hb.l2_miss0[src];
+        rate = hit + miss ? (u32)div_u64((u64)hit * 10000, hit + miss) : 0;
+        seq_printf(s, "%-4s hit %u miss %u rate %u.%02u%%%s\n",
+                   l2_source_name[src], hit, miss, rate / 100, rate % 100,
+                   ctrl & L2_CTRL_BYPASS(src) ? " bypass" : "");
+    }
+    mutex_unlock(&hb.lock);
+    return 0;
+}
+
+static int hetero_bench_l2_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hetero_bench_l2_show, NULL);
+}
+
+/* 写入L2_CTRL的新值, 同时重新开始统计 */
+static ssize_t hetero_bench_l2_write(struct file *file, const char __user *ubuf,
+                                     size_t count, loff_t *ppos)
+{
+    unsigned int ctrl;
+    int ret;
+
+    ret = kstrtouint_from_user(ubuf, count, 0, &ctrl);
+    if (ret)
+        return ret;
+    if (ctrl & ~(L2_CTRL_PARTITION | L2_CTRL_BYPASS(0) | L2_CTRL_BYPASS(1) | L2_CTRL_BYPASS(2)))
+        return -EINVAL;
+
+    mutex_lock(&hb.lock);
+    hetero_reg_write(L2_CTRL_OFFSET, ctrl);
+    hetero_bench_l2_snapshot();
+    mutex_unlock(&hb.lock);
+
+    return count;
+}
+
+static const struct file_operations hetero_bench_l2_fops = {
+    .owner   = THIS_MODULE,
+    .open    = hetero_bench_l2_open,
+    .read    = seq_read,
+    .write   = hetero_bench_l2_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+static int __init hetero_bench_init(void)
+{
+    mutex_init(&hb.lock);
+    hrtimer_init(&hb.ipi_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    hb.ipi_timer.function = hetero_bench_ipi_fire;
+
+    hb.dir = debugfs_create_dir(DRIVER_NAME, NULL);
+    debugfs_create_file("control", 0644, hb.dir, NULL, &hetero_bench_control_fops);
+    debugfs_create_file("stress", 0644, hb.dir, NULL, &hetero_bench_stress_fops);
+    debugfs_create_file("ipi_latency", 0444, hb.dir, NULL, &ipi_latency_fops);
+    debugfs_create_file("release_jitter", 0444, hb.dir, NULL, &release_jitter_fops);
+    debugfs_create_file("bus", 0644, hb.dir, NULL, &hetero_bench_bus_fops);
+    debugfs_create_file("l2", 0644, hb.dir, NULL, &hetero_bench_l2_fops);
+
+    pr_info("%s: 已加载, 见 /sys/kernel/debug/%s\n", DRIVER_NAME, DRIVER_NAME);
+    return 0;
+}
+
+static void __exit hetero_bench_exit(void)
+{
+    debugfs_remove_recursive(hb.dir);
+
+    mutex_lock(&hb.lock);
+    hetero_bench_stop();
+    hetero_bench_stress_stop();
+    mutex_unlock(&hb.lock);
+
+    /* RT核可能还在写, 和没等到应答的i2c/eth缓冲区一样留在池里 */
+    if (hb.blk && hb.attached)
+        pr_warn("%s: 测量块未释放\n", DRIVER_NAME);
+    else if (hb.blk)
+        hetero_buf_free(hb.blk, sizeof(*hb.blk));
+}
+
+module_init(hetero_bench_init);
+module_exit(hetero_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - RT core latency/jitter benchmark");
+MODULE_VERSION("0.1");
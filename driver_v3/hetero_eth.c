@@ -0,0 +1,487 @@
+/* hetero_eth.c - IO核预处理接收的以太网网卡
+ *
+ * 配合 make.py --eth-offload 和IO核固件 firmware/io_core/io_eth.c:
+ * MAC接在IO核上, IO核按目的MAC和分类掩码过滤收到的帧, 把留下的帧连同分类,
+ * 流哈希和MAC锁存的时间戳拷进共享内存的接收环. 本驱动按NAPI方式取环:
+ * 只有poll已经结束 (notify为1) 时IO核才发一条HETERO_MSG_ETH_RX, 一次poll
+ * 取走一批帧, 每帧不再有中断; 流哈希直接给RPS/GRO用, 不用再解析协议头.
+ * 发送: 帧拷进共享内存的发送缓冲区, 一条HETERO_MSG_ETH_XMIT, 应答后缓冲区可重用.
+ *
+ *   modprobe hetero_eth rx_ring=4 classes=0x1ff
+ *   ip link set eth0 up
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/skbuff.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+
+#include "hetero_regs.h"
+
+#define DRIVER_NAME "hetero_eth"
+
+#define HETERO_ETH_MAX_TX       8
+#define HETERO_ETH_TIMEOUT      msecs_to_jiffies(100)
+
+static unsigned int rx_ring = 4;
+module_param(rx_ring, uint, 0444);
+MODULE_PARM_DESC(rx_ring, "RX descriptors in shared memory (power of 2, 2-16)");
+
+static unsigned int tx_bufs = 2;
+module_param(tx_bufs, uint, 0444);
+MODULE_PARM_DESC(tx_bufs, "TX frames in flight to the IO core (1-8)");
+
+static unsigned int classes = HETERO_ETH_CLASS_ALL;
+module_param(classes, uint, 0644);
+MODULE_PARM_DESC(classes, "Bitmap of HETERO_ETH_CLASS_* the IO core passes to Linux (applied on ifup)");
+
+struct hetero_eth {
+    struct net_device *ndev;
+    struct napi_struct napi;
+
+    /*
+     * 共享内存: 环头, 描述符, 接收缓冲区, 发送缓冲区; ifup时分配, ifdown时释放,
+     * 缓冲池与hetero_i2c/hetero_spi共用. ring_lock保护ring指针和累计的丢帧数,
+     * get_stats64和set_rx_mode不持rtnl锁
+     */
+    spinlock_t ring_lock;
+    struct hetero_eth_ring *ring;
+    size_t ring_size;
+    u32 ring_bus;
+    u8 *rx_buf;
+    u8 *tx_buf;
+    u32 tx_bus;
+    u32 rx_tail;
+
+    /* 已提交未应答的发送缓冲区, 在IPI中断上下文中清除 */
+    unsigned long tx_busy;
+
+    /* 之前各次ifup时IO核丢弃的帧 */
+    u64 rx_full;
+    u64 rx_errors;
+    u64 rx_missed;
+
+    /* START/STOP的应答 */
+    struct hetero_call call;
+};
+
+static struct net_device *hetero_eth_ndev;
+
+/* 提交一条控制命令并等待应答, 由rtnl锁串行化; buf见hetero_call */
+static int hetero_eth_call(struct hetero_eth *he, u32 cmd, u32 arg0, u32 arg1,
+                           void *buf, size_t size)
+{
+    struct hetero_msg msg = { .cmd = cmd, .arg0 = arg0, .arg1 = arg1 };
+    struct hetero_msg resp;
+
+    return hetero_call(&he->call, &msg, &resp, buf, size, HETERO_ETH_TIMEOUT);
+}
+
+/* IO核发来的批通知, 在主核IPI中断上下文中调用 */
+static void hetero_eth_rx_handler(int core_id, const struct hetero_msg *msg, void *priv)
+{
+    struct hetero_eth *he = priv;
+
+    napi_schedule(&he->napi);
+}
+
+/* 发送应答: arg1高16位是缓冲区号, 出错应答也原样带回 */
+static void hetero_eth_xmit_done(int core_id, const struct hetero_msg *msg, void *priv)
+{
+    struct hetero_eth *he = priv;
+    struct net_device *ndev = he->ndev;
+    unsigned int idx = msg->arg1 >> 16;
+
+    if (idx >= tx_bufs)
+        return;
+
+    if (msg->cmd & HETERO_MSG_ERR) {
+        ndev->stats.tx_errors++;
+    } else {
+        ndev->stats.tx_packets++;
+        ndev->stats.tx_bytes += msg->arg1 & 0xFFFF;
+    }
+
+    clear_bit(idx, &he->tx_busy);
+    smp_mb__after_atomic();
+    if (netif_queue_stopped(ndev))
+        netif_wake_queue(ndev);
+}
+
+/* 时间戳是时基低32位, 按当前时基补齐高位后换算为纳秒 */
+static void hetero_eth_rx_tstamp(struct sk_buff *skb, u32 stamp)
+{
+    u64 now = hetero_read_cycles();
+    u64 cycles = now - (u32)((u32)now - stamp);
+
+    skb_hwtstamps(skb)->hwtstamp =
+        ns_to_ktime(mul_u64_u32_div(cycles, NSEC_PER_SEC / 1000, HETERO_TIMEBASE_HZ / 1000));
+}
+
+/* 取一个描述符交给协议栈, 环空返回false */
+static bool hetero_eth_rx_one(struct hetero_eth *he)
+{
+    struct hetero_eth_ring *ring = he->ring;
+    struct net_device *ndev = he->ndev;
+    struct hetero_eth_desc *d;
+    struct sk_buff *skb;
+    u32 idx, info, len, cls, hash;
+
+    if (READ_ONCE(ring->head) == he->rx_tail)
+        return false;
+    rmb();
+
+    idx = he->rx_tail & (rx_ring - 1);
+    d = &ring->desc[idx];
+    info = READ_ONCE(d->info);
+    len = info & 0xFFFF;
+    cls = (info >> 16) & ~HETERO_ETH_CLASS_VLAN & 0xFF;
+
+    /* 长度由IO核写入, 超出接收缓冲区的描述符不拷贝, 照常归还 */
+    if (len < ETH_HLEN || len > HETERO_ETH_BUF_SIZE) {
+        ndev->stats.rx_length_errors++;
+        ndev->stats.rx_errors++;
+        goto out;
+    }
+
+    skb = napi_alloc_skb(&he->napi, len);
+    if (skb) {
+        skb_put_data(skb, he->rx_buf + idx * HETERO_ETH_BUF_SIZE, len);
+        hetero_eth_rx_tstamp(skb, READ_ONCE(d->stamp));
+
+        hash = READ_ONCE(d->hash);
+        if (hash)
+            skb_set_hash(skb, hash,
+                         (cls == HETERO_ETH_CLASS_TCP4 || cls == HETERO_ETH_CLASS_UDP4 ||
+                          cls == HETERO_ETH_CLASS_TCP6 || cls == HETERO_ETH_CLASS_UDP6) ?
+                         PKT_HASH_TYPE_L4 : PKT_HASH_TYPE_L3);
+
+        skb->protocol = eth_type_trans(skb, ndev);
+        ndev->stats.rx_packets++;
+        ndev->stats.rx_bytes += len;
+        napi_gro_receive(&he->napi, skb);
+    } else {
+        ndev->stats.rx_dropped++;
+    }
+
+out:
+    /* 拷完才把描述符还给IO核 */
+    mb();
+    WRITE_ONCE(ring->tail, ++he->rx_tail);
+    return true;
+}
+
+static int hetero_eth_poll(struct napi_struct *napi, int budget)
+{
+    struct hetero_eth *he = container_of(napi, struct hetero_eth, napi);
+    int done = 0;
+
+    while (done < budget && hetero_eth_rx_one(he))
+        done++;
+
+    if (done < budget && napi_complete_done(napi, done)) {
+        /* 先请求通知再看一次环, IO核在置位之前放进的帧由这里取走 */
+        WRITE_ONCE(he->ring->notify, 1);
+        mb();
+        if (READ_ONCE(he->ring->head) != he->rx_tail)
+            napi_schedule(napi);
+    }
+
+    return done;
+}
+
+static netdev_tx_t hetero_eth_start_xmit(struct sk_buff *skb, struct net_device *ndev)
+{
+    struct hetero_eth *he = netdev_priv(ndev);
+    struct hetero_msg msg = { .cmd = HETERO_MSG_ETH_XMIT };
+    unsigned int idx;
+
+    idx = find_first_zero_bit(&he->tx_busy, tx_bufs);
+    if (idx >= tx_bufs) {
+        /* 不会发生: 最后一个缓冲区用掉时已停队列 */
+        netif_stop_queue(ndev);
+        return NETDEV_TX_BUSY;
+    }
+
+    if (skb->len > HETERO_ETH_BUF_SIZE) {
+        ndev->stats.tx_dropped++;
+        dev_kfree_skb_any(skb);
+        return NETDEV_TX_OK;
+    }
+
+    skb_copy_bits(skb, 0, he->tx_buf + idx * HETERO_ETH_BUF_SIZE, skb->len);
+    msg.arg0 = he->tx_bus + idx * HETERO_ETH_BUF_SIZE;
+    msg.arg1 = skb->len | (idx << 16);
+    dev_consume_skb_any(skb);
+
+    /* 先停队列再提交, 应答总在停队列之后到达 */
+    set_bit(idx, &he->tx_busy);
+    if (find_first_zero_bit(&he->tx_busy, tx_bufs) >= tx_bufs)
+        netif_stop_queue(ndev);
+
+    if (hetero_submit(HETERO_CORE_IO, &msg, 0)) {
+        ndev->stats.tx_dropped++;
+        clear_bit(idx, &he->tx_busy);
+        netif_wake_queue(ndev);
+    }
+
+    return NETDEV_TX_OK;
+}
+
+/* 过滤条件直接写进共享内存, IO核每帧都读, 可在原子上下文调用 */
+static void hetero_eth_set_rx_mode(struct net_device *ndev)
+{
+    struct hetero_eth *he = netdev_priv(ndev);
+    struct netdev_hw_addr *ha;
+    u32 mc_hash[2] = { 0, 0 };
+    u32 flags = 0;
+    u32 bit;
+
+    if (ndev->flags & IFF_PROMISC)
+        flags |= HETERO_ETH_F_PROMISC;
+    if (ndev->flags & IFF_ALLMULTI)
+        flags |= HETERO_ETH_F_ALLMULTI;
+
+    netdev_for_each_mc_addr(ha, ndev) {
+        bit = HETERO_ETH_MC_BIT(ha->addr);
+        mc_hash[bit >> 5] |= 1u << (bit & 31);
+    }
+
+    spin_lock_bh(&he->ring_lock);
+    if (he->ring) {
+        WRITE_ONCE(he->ring->mc_hash[0], mc_hash[0]);
+        WRITE_ONCE(he->ring->mc_hash[1], mc_hash[1]);
+        WRITE_ONCE(he->ring->flags, flags);
+    }
+    spin_unlock_bh(&he->ring_lock);
+}
+
+/* 分配接收环, 描述符指向环后面的接收缓冲区 */
+static struct hetero_eth_ring *hetero_eth_alloc_ring(struct hetero_eth *he, u32 *bus)
+{
+    size_t desc_size = sizeof(struct hetero_eth_ring) + rx_ring * sizeof(struct hetero_eth_desc);
+    struct hetero_eth_ring *ring;
+    int i;
+
+    ring = hetero_buf_alloc(he->ring_size, bus);
+    if (!ring)
+        return NULL;
+
+    memset(ring, 0, desc_size);
+    for (i = 0; i < rx_ring; i++)
+        ring->desc[i].buf = *bus + desc_size + i * HETERO_ETH_BUF_SIZE;
+
+    he->ring_bus = *bus;
+    he->rx_buf = (u8 *)ring + desc_size;
+    he->tx_buf = he->rx_buf + rx_ring * HETERO_ETH_BUF_SIZE;
+    he->tx_bus = *bus + desc_size + rx_ring * HETERO_ETH_BUF_SIZE;
+    return ring;
+}
+
+/*
+ * IO核可能还在写的环: 先发STOP, 消息按顺序处理, 应答之后IO核不再访问;
+ * 超时则交给hetero_call, 等迟到的应答再释放
+ */
+static void hetero_eth_release_ring(struct hetero_eth *he, struct hetero_eth_ring *ring)
+{
+    int ret;
+
+    ret = hetero_eth_call(he, HETERO_MSG_ETH_STOP, 0, 0, ring, he->ring_size);
+    if (ret == -ETIMEDOUT) {
+        netdev_warn(he->ndev, "IO核接收环停止超时, 共享内存等应答再释放\n");
+        return;
+    }
+    hetero_buf_free(ring, he->ring_size);
+}
+
+static int hetero_eth_open(struct net_device *ndev)
+{
+    struct hetero_eth *he = netdev_priv(ndev);
+    struct hetero_eth_ring *ring;
+    u32 bus;
+    int ret;
+
+    ring = hetero_eth_alloc_ring(he, &bus);
+    if (!ring) {
+        netdev_err(ndev, "共享内存不足 (%zu字节)\n", he->ring_size);
+        return -ENOMEM;
+    }
+
+    he->rx_tail = 0;
+    he->tx_busy = 0;
+    ring->notify = 1;
+    ring->class_mask = classes & HETERO_ETH_CLASS_ALL;
+    memcpy(ring->mac, ndev->dev_addr, ETH_ALEN);
+
+    spin_lock_bh(&he->ring_lock);
+    he->ring = ring;
+    spin_unlock_bh(&he->ring_lock);
+    hetero_eth_set_rx_mode(ndev);
+
+    napi_enable(&he->napi);
+
+    /* IO核固件未运行或没有MAC时这里出错 */
+    ret = hetero_eth_call(he, HETERO_MSG_ETH_START, bus, rx_ring, NULL, 0);
+    if (ret) {
+        netdev_err(ndev, "IO核接收环启动失败: %d\n", ret);
+        napi_disable(&he->napi);
+        spin_lock_bh(&he->ring_lock);
+        he->ring = NULL;
+        spin_unlock_bh(&he->ring_lock);
+        /* 超时的START之后可能才被执行 */
+        if (ret == -ETIMEDOUT)
+            hetero_eth_release_ring(he, ring);
+        else
+            hetero_buf_free(ring, he->ring_size);
+        return ret;
+    }
+
+    netif_carrier_on(ndev);
+    netif_start_queue(ndev);
+    return 0;
+}
+
+static int hetero_eth_stop(struct net_device *ndev)
+{
+    struct hetero_eth *he = netdev_priv(ndev);
+    struct hetero_eth_ring *ring = he->ring;
+
+    netif_stop_queue(ndev);
+    netif_carrier_off(ndev);
+    napi_disable(&he->napi);
+
+    /* 丢帧数累计下来, 环交还之后不再读 */
+    spin_lock_bh(&he->ring_lock);
+    he->rx_full += READ_ONCE(ring->rx_full);
+    he->rx_errors += READ_ONCE(ring->rx_errors);
+    he->rx_missed += READ_ONCE(ring->rx_missed);
+    he->ring = NULL;
+    spin_unlock_bh(&he->ring_lock);
+
+    hetero_eth_release_ring(he, ring);
+    return 0;
+}
+
+/* 加上IO核丢弃的帧 */
+static void hetero_eth_get_stats64(struct net_device *ndev, struct rtnl_link_stats64 *stats)
+{
+    struct hetero_eth *he = netdev_priv(ndev);
+    struct hetero_eth_ring *ring;
+
+    netdev_stats_to_stats64(stats, &ndev->stats);
+
+    spin_lock_bh(&he->ring_lock);
+    ring = he->ring;
+    stats->rx_dropped += he->rx_full + (ring ? READ_ONCE(ring->rx_full) : 0);
+    stats->rx_errors += he->rx_errors + (ring ? READ_ONCE(ring->rx_errors) : 0);
+    stats->rx_missed_errors = he->rx_missed + (ring ? READ_ONCE(ring->rx_missed) : 0);
+    spin_unlock_bh(&he->ring_lock);
+}
+
+static const struct net_device_ops hetero_eth_netdev_ops = {
+    .ndo_open            = hetero_eth_open,
+    .ndo_stop            = hetero_eth_stop,
+    .ndo_start_xmit      = hetero_eth_start_xmit,
+    .ndo_set_rx_mode     = hetero_eth_set_rx_mode,
+    .ndo_set_mac_address = eth_mac_addr,
+    .ndo_validate_addr   = eth_validate_addr,
+    .ndo_get_stats64     = hetero_eth_get_stats64,
+};
+
+static const u32 hetero_eth_cmds[] = {
+    HETERO_MSG_ETH_START | HETERO_MSG_RESP,
+    HETERO_MSG_ETH_STOP | HETERO_MSG_RESP,
+    HETERO_MSG_ETH_XMIT | HETERO_MSG_RESP,
+    HETERO_MSG_ETH_RX,
+};
+
+static void hetero_eth_unregister_handlers(int n)
+{
+    while (n--)
+        hetero_unregister_handler(HETERO_CORE_IO, hetero_eth_cmds[n]);
+}
+
+static int __init hetero_eth_init(void)
+{
+    static const hetero_handler_t fns[] = {
+        hetero_call_handler,
+        hetero_call_handler,
+        hetero_eth_xmit_done,
+        hetero_eth_rx_handler,
+    };
+    struct net_device *ndev;
+    struct hetero_eth *he;
+    int i, ret;
+
+    if (rx_ring < 2 || rx_ring > HETERO_ETH_MAX_DESC || !is_power_of_2(rx_ring) ||
+        !tx_bufs || tx_bufs > HETERO_ETH_MAX_TX)
+        return -EINVAL;
+
+    ndev = alloc_etherdev(sizeof(*he));
+    if (!ndev)
+        return -ENOMEM;
+
+    he = netdev_priv(ndev);
+    he->ndev = ndev;
+    spin_lock_init(&he->ring_lock);
+    hetero_call_init(&he->call, HETERO_CORE_IO);
+    he->ring_size = sizeof(struct hetero_eth_ring) + rx_ring * sizeof(struct hetero_eth_desc) +
+                    (rx_ring + tx_bufs) * HETERO_ETH_BUF_SIZE;
+
+    ndev->netdev_ops = &hetero_eth_netdev_ops;
+    ndev->max_mtu = HETERO_ETH_BUF_SIZE - ETH_HLEN - VLAN_HLEN;
+    eth_hw_addr_random(ndev);
+    netif_napi_add(ndev, &he->napi, hetero_eth_poll, NAPI_POLL_WEIGHT);
+
+    for (i = 0; i < ARRAY_SIZE(hetero_eth_cmds); i++) {
+        ret = hetero_register_handler(HETERO_CORE_IO, hetero_eth_cmds[i], fns[i],
+                                      fns[i] == hetero_call_handler ? (void *)&he->call : he);
+        if (ret) {
+            hetero_eth_unregister_handlers(i);
+            goto err_napi;
+        }
+    }
+
+    ret = register_netdev(ndev);
+    if (ret)
+        goto err_handlers;
+
+    hetero_eth_ndev = ndev;
+    pr_info("%s: %s, 接收环%u项, 发送缓冲区%u个, ifup时占用共享内存%zu字节\n",
+            DRIVER_NAME, ndev->name, rx_ring, tx_bufs, he->ring_size);
+    return 0;
+
+err_handlers:
+    hetero_eth_unregister_handlers(ARRAY_SIZE(hetero_eth_cmds));
+err_napi:
+    netif_napi_del(&he->napi);
+    free_netdev(ndev);
+    return ret;
+}
+
+static void __exit hetero_eth_exit(void)
+{
+    struct hetero_eth *he = netdev_priv(hetero_eth_ndev);
+
+    unregister_netdev(hetero_eth_ndev);
+    hetero_eth_unregister_handlers(ARRAY_SIZE(hetero_eth_cmds));
+    netif_napi_del(&he->napi);
+
+    /* 没等到STOP应答的环留在池里, 模块卸载后IO核仍可能写入 */
+    if (hetero_call_stale(&he->call))
+        pr_warn("%s: %d个接收环未释放\n", DRIVER_NAME, hetero_call_stale(&he->call));
+
+    free_netdev(hetero_eth_ndev);
+}
+
+module_init(hetero_eth_init);
+module_exit(hetero_eth_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - Ethernet with RX pre-processing on the IO core");
+MODULE_VERSION("0.1");
@@ -0,0 +1,181 @@
+/* hetero_i2c.c - 经IO核完成传输的I2C适配器
+ *
+ * 配合 make.py --i2c-offload 和IO核固件 firmware/io_core/io_i2c.c:
+ * I2C引脚接在IO核上, 一次i2c_transfer的所有消息连同写数据拷进共享内存,
+ * 用一条HETERO_MSG_I2C_XFER提交, IO核产生全部位时序 (消息之间重复起始),
+ * 完成后应答, 读数据再拷回. 传输期间Linux核可以调度其他任务.
+ *
+ *   modprobe hetero_i2c bus_khz=400
+ *   i2cdetect -l        # "hetero-io-i2c"
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/jiffies.h>
+
+#include "hetero_regs.h"
+
+#define DRIVER_NAME "hetero_i2c"
+
+/* 一次传输的写/读数据总量上限, 从共享内存缓冲池分配 */
+#define HETERO_I2C_MAX_DATA     1024
+
+static unsigned int bus_khz = 100;
+module_param(bus_khz, uint, 0444);
+MODULE_PARM_DESC(bus_khz, "SCL frequency (kHz), up to 1000");
+
+struct hetero_i2c {
+    struct i2c_adapter adap;
+
+    /* IO核应答; 调用者由i2c核心的总线锁串行化 */
+    struct hetero_call call;
+};
+
+static struct hetero_i2c hi;
+
+/*
+ * 共享内存布局: struct hetero_i2c_msg[num], 之后依次是各消息的数据
+ */
+static int hetero_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+    struct hetero_msg msg = { .cmd = HETERO_MSG_I2C_XFER };
+    struct hetero_msg resp;
+    struct hetero_i2c_msg *desc;
+    size_t size, off;
+    u32 bus;
+    u8 *buf;
+    int i, ret;
+
+    /* i2c核心不按functionality检查消息标志, 10位地址/NOSTART/IGNORE_NAK等在这里拒绝 */
+    size = num * sizeof(*desc);
+    for (i = 0; i < num; i++) {
+        if (msgs[i].flags & ~I2C_M_RD)
+            return -EOPNOTSUPP;
+        size += msgs[i].len;
+    }
+    if (size > num * sizeof(*desc) + HETERO_I2C_MAX_DATA)
+        return -EOPNOTSUPP;
+
+    buf = hetero_buf_alloc(size, &bus);
+    if (!buf)
+        return -ENOMEM;
+
+    desc = (struct hetero_i2c_msg *)buf;
+    off = num * sizeof(*desc);
+    for (i = 0; i < num; i++) {
+        desc[i].addr = msgs[i].addr;
+        desc[i].flags = msgs[i].flags & I2C_M_RD ? HETERO_I2C_F_RD : 0;
+        desc[i].len = msgs[i].len;
+        desc[i].reserved = 0;
+        desc[i].buf = bus + off;
+        if (!(msgs[i].flags & I2C_M_RD))
+            memcpy(buf + off, msgs[i].buf, msgs[i].len);
+        off += msgs[i].len;
+    }
+
+    msg.arg0 = bus;
+    msg.arg1 = num;
+    ret = hetero_call(&hi.call, &msg, &resp, buf, size, hi.adap.timeout);
+    if (ret == -ETIMEDOUT)
+        return ret;
+
+    if (!ret) {
+        off = num * sizeof(*desc);
+        for (i = 0; i < num; i++) {
+            if (msgs[i].flags & I2C_M_RD)
+                memcpy(msgs[i].buf, buf + off, msgs[i].len);
+            off += msgs[i].len;
+        }
+        ret = resp.arg0;
+    }
+
+    hetero_buf_free(buf, size);
+    return ret;
+}
+
+static u32 hetero_i2c_func(struct i2c_adapter *adap)
+{
+    return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm hetero_i2c_algo = {
+    .master_xfer   = hetero_i2c_xfer,
+    .functionality = hetero_i2c_func,
+};
+
+/* 消息数和长度由i2c核心按quirks检查 */
+static const struct i2c_adapter_quirks hetero_i2c_quirks = {
+    .max_num_msgs = HETERO_I2C_MAX_MSGS,
+    .max_write_len = HETERO_I2C_MAX_DATA,
+    .max_read_len = HETERO_I2C_MAX_DATA,
+};
+
+static int __init hetero_i2c_init(void)
+{
+    struct hetero_msg msg = { .cmd = HETERO_MSG_I2C_CONFIG };
+    struct hetero_msg resp;
+    int ret;
+
+    if (!bus_khz || bus_khz > 1000)
+        return -EINVAL;
+
+    hetero_call_init(&hi.call, HETERO_CORE_IO);
+
+    hi.adap.owner = THIS_MODULE;
+    hi.adap.class = I2C_CLASS_HWMON;
+    hi.adap.algo = &hetero_i2c_algo;
+    hi.adap.quirks = &hetero_i2c_quirks;
+    hi.adap.timeout = HZ;
+    strscpy(hi.adap.name, "hetero-io-i2c", sizeof(hi.adap.name));
+
+    ret = hetero_register_handler(HETERO_CORE_IO, HETERO_MSG_I2C_XFER | HETERO_MSG_RESP,
+                                  hetero_call_handler, &hi.call);
+    if (ret)
+        return ret;
+    ret = hetero_register_handler(HETERO_CORE_IO, HETERO_MSG_I2C_CONFIG | HETERO_MSG_RESP,
+                                  hetero_call_handler, &hi.call);
+    if (ret)
+        goto err_xfer;
+
+    /* IO核固件未运行时这里超时, 不注册适配器 */
+    msg.arg0 = bus_khz * 1000;
+    ret = hetero_call(&hi.call, &msg, &resp, NULL, 0, hi.adap.timeout);
+    if (ret) {
+        pr_err("%s: IO核I2C配置失败: %d\n", DRIVER_NAME, ret);
+        goto err_config;
+    }
+
+    ret = i2c_add_adapter(&hi.adap);
+    if (ret)
+        goto err_config;
+
+    pr_info("%s: %s, SCL %u kHz\n", DRIVER_NAME, hi.adap.name, bus_khz);
+    return 0;
+
+err_config:
+    hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_I2C_CONFIG | HETERO_MSG_RESP);
+err_xfer:
+    hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_I2C_XFER | HETERO_MSG_RESP);
+    return ret;
+}
+
+static void __exit hetero_i2c_exit(void)
+{
+    i2c_del_adapter(&hi.adap);
+    hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_I2C_CONFIG | HETERO_MSG_RESP);
+    hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_I2C_XFER | HETERO_MSG_RESP);
+
+    /* 没等到应答的缓冲区留在池里, 模块卸载后IO核仍可能写入 */
+    if (hetero_call_stale(&hi.call))
+        pr_warn("%s: %d次超时传输的缓冲区未释放\n", DRIVER_NAME, hetero_call_stale(&hi.call));
+}
+
+module_init(hetero_i2c_init);
+module_exit(hetero_i2c_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - I2C adapter offloaded to the IO core");
+MODULE_VERSION("0.1");
@@ -0,0 +1,235 @@
+/* hetero_mbox.c - 硬件邮箱的Linux mailbox框架控制器驱动
+ *
+ * 每个小核两个通道(方向见hetero_mbox.h), 共4个:
+ *   - send_data: 写命令/数据寄存器, 再发IPI通知小核
+ *   - txdone:    小核取走命令(命令寄存器清零)并置位主核IPI后, 在中断里确认
+ *   - rx:        小核置位状态寄存器并发主核IPI, 在中断里读取响应交给客户端
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/mailbox_controller.h>
+#include <linux/notifier.h>
+#include <linux/of.h>
+
+#include "hetero_regs.h"
+#include "hetero_mbox.h"
+
+#define DRIVER_NAME "hetero_mbox"
+
+#define NUM_CHANS   (HETERO_NUM_SMALL_CORES * 2)
+
+struct hetero_mbox {
+    struct mbox_controller mbox;
+    struct mbox_chan chans[NUM_CHANS];
+    struct notifier_block nb;
+
+    /* 已发送但小核尚未取走命令的TX通道 */
+    unsigned long tx_busy;
+};
+
+static struct platform_device *hetero_mbox_pdev;
+
+static int hetero_mbox_chan_index(struct mbox_chan *chan)
+{
+    return (int)(unsigned long)chan->con_priv;
+}
+
+static int hetero_mbox_send_data(struct mbox_chan *chan, void *data)
+{
+    struct hetero_mbox *hm = dev_get_drvdata(chan->mbox->dev);
+    struct hetero_mbox_msg *msg = data;
+    int idx = hetero_mbox_chan_index(chan);
+    int core = idx / 2;
+
+    if (idx % 2 != HETERO_MBOX_DIR_TX || !msg || !msg->cmd)
+        return -EINVAL;
+
+    if (hetero_reg_read(MBOX_MAIN_TO_CORE_CMD_OFFSET(core)) != 0)
+        return -EBUSY;
+
+    set_bit(idx, &hm->tx_busy);
+
+    /* 先写数据, 命令寄存器非零即表示有新消息 */
+    hetero_reg_write(MBOX_MAIN_TO_CORE_DATA_OFFSET(core), msg->data);
+    hetero_reg_write(MBOX_MAIN_TO_CORE_CMD_OFFSET(core), msg->cmd);
+
+    return hetero_kick_core(core);
+}
+
+static bool hetero_mbox_last_tx_done(struct mbox_chan *chan)
+{
+    int core = hetero_mbox_chan_index(chan) / 2;
+
+    return hetero_reg_read(MBOX_MAIN_TO_CORE_CMD_OFFSET(core)) == 0;
+}
+
+static bool hetero_mbox_peek_data(struct mbox_chan *chan)
+{
+    int idx = hetero_mbox_chan_index(chan);
+
+    if (idx % 2 != HETERO_MBOX_DIR_RX)
+        return false;
+
+    return hetero_reg_read(MBOX_CORE_TO_MAIN_STATUS_OFFSET(idx / 2)) != 0;
+}
+
+static const struct mbox_chan_ops hetero_mbox_ops = {
+    .send_data    = hetero_mbox_send_data,
+    .last_tx_done = hetero_mbox_last_tx_done,
+    .peek_data    = hetero_mbox_peek_data,
+};
+
+/* 主核IPI: 处理所有小核的txdone和接收 */
+static int hetero_mbox_notify(struct notifier_block *nb,
+                              unsigned long status, void *data)
+{
+    struct hetero_mbox *hm = container_of(nb, struct hetero_mbox, nb);
+    struct hetero_mbox_msg msg;
+    struct mbox_chan *chan;
+    int core;
+
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        /* TX完成 */
+        chan = &hm->chans[HETERO_MBOX_CHAN(core, HETERO_MBOX_DIR_TX)];
+        if (test_bit(HETERO_MBOX_CHAN(core, HETERO_MBOX_DIR_TX), &hm->tx_busy) &&
+            hetero_mbox_last_tx_done(chan)) {
+            clear_bit(HETERO_MBOX_CHAN(core, HETERO_MBOX_DIR_TX), &hm->tx_busy);
+            mbox_chan_txdone(chan, 0);
+        }
+
+        /* 接收 */
+        chan = &hm->chans[HETERO_MBOX_CHAN(core, HETERO_MBOX_DIR_RX)];
+        if (!chan->cl || !hetero_mbox_peek_data(chan))
+            continue;
+
+        msg.cmd = hetero_reg_read(MBOX_CORE_TO_MAIN_RESP_OFFSET(core));
+        msg.data = 0;
+        hetero_reg_write(MBOX_CORE_TO_MAIN_CTRL_OFFSET(core), MBOX_CTRL_ACK);
+
+        mbox_chan_received_data(chan, &msg);
+    }
+
+    return NOTIFY_OK;
+}
+
+/* #mbox-cells = <2>: <小核编号 方向> */
+static struct mbox_chan *hetero_mbox_of_xlate(struct mbox_controller *mbox,
+                                              const struct of_phandle_args *sp)
+{
+    u32 core, dir;
+
+    if (sp->args_count != 2)
+        return ERR_PTR(-EINVAL);
+
+    core = sp->args[0];
+    dir = sp->args[1];
+    if (core >= HETERO_NUM_SMALL_CORES || dir > HETERO_MBOX_DIR_RX)
+        return ERR_PTR(-EINVAL);
+
+    return &mbox->chans[HETERO_MBOX_CHAN(core, dir)];
+}
+
+static int hetero_mbox_probe(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;
+    struct hetero_mbox *hm;
+    int ret;
+    int i;
+
+    hm = devm_kzalloc(dev, sizeof(*hm), GFP_KERNEL);
+    if (!hm)
+        return -ENOMEM;
+
+    for (i = 0; i < NUM_CHANS; i++)
+        hm->chans[i].con_priv = (void *)(unsigned long)i;
+
+    hm->mbox.dev = dev;
+    hm->mbox.ops = &hetero_mbox_ops;
+    hm->mbox.chans = hm->chans;
+    hm->mbox.num_chans = NUM_CHANS;
+    hm->mbox.txdone_irq = true;
+    hm->mbox.of_xlate = hetero_mbox_of_xlate;
+
+    platform_set_drvdata(pdev, hm);
+
+    hm->nb.notifier_call = hetero_mbox_notify;
+    ret = hetero_register_notifier(&hm->nb);
+    if (ret)
+        return ret;
+
+    ret = devm_mbox_controller_register(dev, &hm->mbox);
+    if (ret) {
+        dev_err(dev, "mailbox控制器注册失败: %d\n", ret);
+        hetero_unregister_notifier(&hm->nb);
+        return ret;
+    }
+
+    dev_info(dev, "硬件邮箱已注册, %d个通道\n", NUM_CHANS);
+    return 0;
+}
+
+static int hetero_mbox_remove(struct platform_device *pdev)
+{
+    struct hetero_mbox *hm = platform_get_drvdata(pdev);
+
+    hetero_unregister_notifier(&hm->nb);
+    return 0;
+}
+
+static const struct of_device_id hetero_mbox_of_match[] = {
+    { .compatible = "litex,hetero-mbox" },
+    { }
+};
+MODULE_DEVICE_TABLE(of, hetero_mbox_of_match);
+
+static struct platform_driver hetero_mbox_driver = {
+    .probe  = hetero_mbox_probe,
+    .remove = hetero_mbox_remove,
+    .driver = {
+        .name = DRIVER_NAME,
+        .of_match_table = hetero_mbox_of_match,
+    },
+};
+
+static int __init hetero_mbox_init(void)
+{
+    struct device_node *np;
+    int ret;
+
+    ret = platform_driver_register(&hetero_mbox_driver);
+    if (ret)
+        return ret;
+
+    /* 设备树里没有邮箱节点时(模拟环境), 自己注册一个设备 */
+    np = of_find_matching_node(NULL, hetero_mbox_of_match);
+    if (np) {
+        of_node_put(np);
+        return 0;
+    }
+
+    hetero_mbox_pdev = platform_device_register_simple(DRIVER_NAME, -1, NULL, 0);
+    if (IS_ERR(hetero_mbox_pdev)) {
+        platform_driver_unregister(&hetero_mbox_driver);
+        return PTR_ERR(hetero_mbox_pdev);
+    }
+
+    return 0;
+}
+
+static void __exit hetero_mbox_exit(void)
+{
+    if (hetero_mbox_pdev)
+        platform_device_unregister(hetero_mbox_pdev);
+    platform_driver_unregister(&hetero_mbox_driver);
+}
+
+module_init(hetero_mbox_init);
+module_exit(hetero_mbox_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - mailbox controller");
+MODULE_VERSION("0.1");
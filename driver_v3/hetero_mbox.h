@@ -0,0 +1,32 @@
+/* hetero_mbox.h - 硬件邮箱mailbox控制器的客户端定义
+ *
+ * 设备树:
+ *   hetero_mbox: mailbox {
+ *       compatible = "litex,hetero-mbox";
+ *       #mbox-cells = <2>;              // <小核编号 方向>
+ *   };
+ *   client { mboxes = <&hetero_mbox 0 0>, <&hetero_mbox 0 1>; };
+ */
+
+#ifndef _HETERO_MBOX_H
+#define _HETERO_MBOX_H
+
+#include <linux/types.h>
+
+/* 通道方向 */
+#define HETERO_MBOX_DIR_TX  0   /* 主核 -> 小核: mbox_main_to_coreN_cmd/data */
+#define HETERO_MBOX_DIR_RX  1   /* 小核 -> 主核: mbox_coreN_to_main_resp */
+
+#define HETERO_MBOX_CHAN(core, dir)  ((core) * 2 + (dir))
+
+/*
+ * send_data/rx_callback 的消息格式
+ * TX: cmd写入命令寄存器(必须非零), data写入数据寄存器
+ * RX: cmd为小核的响应字, data保留为0
+ */
+struct hetero_mbox_msg {
+    u32 cmd;
+    u32 data;
+};
+
+#endif /* _HETERO_MBOX_H */
@@ -12,32 +12,62 @@
 #include <linux/ioctl.h>
 #include <linux/delay.h>
 #include <linux/workqueue.h>
+#include <linux/interrupt.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/genalloc.h>
+#include <linux/kfifo.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/moduleparam.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/clocksource.h>
+#include <linux/sched/clock.h>
+#include <linux/mutex.h>
+#include <linux/irq_work.h>
+#include <linux/io.h>
+#include <linux/of.h>
+#include <linux/of_reserved_mem.h>
+
+#include "hetero_regs.h"
 
 #define DRIVER_NAME "hetero_regs"
 #define DEVICE_NAME "hetero_regs"
 
+/*
+ * 旁路模式: 用户态直接拥有寄存器页和共享内存, 内核不再处理消息环/上调用,
+ * 主核IPI只转成eventfd信号或read()计数, 由用户态清除IPI后write()重新使能
+ */
+static bool bypass;
+module_param(bypass, bool, 0444);
+MODULE_PARM_DESC(bypass, "Kernel-bypass mode: deliver main IPI to userspace only");
+
+/*
+ * 一致性共享内存 (make.py --shared-mem-coherent): 共享内存在主存保留区
+ * "hetero-shm"里, 小核经SMP集群的一致性DMA口访问; 驱动按可缓存方式映射该保留区,
+ * 用户态也可以按可缓存方式映射
+ */
+static bool shm_coherent;
+module_param(shm_coherent, bool, 0444);
+MODULE_PARM_DESC(shm_coherent, "Shared memory is hardware-coherent: mmap it cacheable");
+
 /* 内存区域大小 */
 #define REG_SPACE_SIZE   4096    /* 4KB 寄存器空间 */
 #define SHARED_MEM_SIZE  (32*1024) /* 32KB 共享内存 */
 #define TOTAL_SIZE       (REG_SPACE_SIZE + SHARED_MEM_SIZE)
 
-/* 寄存器偏移量（基于你的真实硬件设计） */
-#define IPI_STATUS_OFFSET    0x00   /* @ 0xf0002000 */
-#define IPI_TRIGGER_OFFSET   0x04   /* @ 0xf0002004 */
-#define IPI_CLEAR_OFFSET     0x08   /* @ 0xf0002008 */
-#define IPI_ENABLE_OFFSET    0x0C   /* @ 0xf000200c */
-
-#define MBOX_MAIN_TO_CORE0_CMD_OFFSET   0x10  /* @ 0xf0002010 */
-#define MBOX_MAIN_TO_CORE0_DATA_OFFSET  0x14  /* @ 0xf0002014 */
-#define MBOX_CORE0_TO_MAIN_RESP_OFFSET  0x1C  /* @ 0xf000201c */
+/* 每个小核可注册的RX消息处理函数数量 */
+#define HETERO_MAX_HANDLERS  16
 
-#define MBOX_MAIN_TO_CORE1_CMD_OFFSET   0x20  /* @ 0xf0002020 */
-#define MBOX_MAIN_TO_CORE1_DATA_OFFSET  0x24  /* @ 0xf0002024 */
-#define MBOX_CORE1_TO_MAIN_RESP_OFFSET  0x2C  /* @ 0xf000202c */
+/* 上调用处理函数数量和用户态队列长度 */
+#define HETERO_MAX_UPCALLS   16
+#define HETERO_UPCALL_QLEN   32
+#define HETERO_UPCALL_BUFS   16
 
-#define HW_MUTEX_REQUEST_OFFSET  0x30  /* @ 0xf0002040 */
-#define HW_MUTEX_STATUS_OFFSET   0x34  /* @ 0xf0002044 */
-#define HW_MUTEX_RELEASE_OFFSET  0x38  /* @ 0xf0002048 */
+/* 寄存器偏移量见 hetero_regs.h */
 
 /* ioctl命令定义 */
 #define HETERO_IOC_MAGIC 'h'
@@ -45,6 +75,73 @@
 #define HETERO_IOC_CORE_STATUS   _IOR(HETERO_IOC_MAGIC, 2, int)
 #define HETERO_IOC_SEND_IPI      _IOW(HETERO_IOC_MAGIC, 3, int)
 #define HETERO_IOC_RESET         _IO(HETERO_IOC_MAGIC, 4)
+#define HETERO_IOC_UPCALL_GET    _IOR(HETERO_IOC_MAGIC, 5, struct hetero_upcall)
+#define HETERO_IOC_UPCALL_REPLY  _IOW(HETERO_IOC_MAGIC, 6, struct hetero_upcall)
+#define HETERO_IOC_SET_EVENTFD   _IOW(HETERO_IOC_MAGIC, 7, int)   /* 旁路模式, -1解除 */
+#define HETERO_IOC_WAIT_VALUE    _IOWR(HETERO_IOC_MAGIC, 8, struct hetero_wait_value)
+#define HETERO_IOC_SEND_IPI_MASK _IOW(HETERO_IOC_MAGIC, 9, __u32)  /* IPI位掩码, 见hetero_regs.h */
+#define HETERO_IOC_SUBMIT_AT     _IOWR(HETERO_IOC_MAGIC, 10, struct hetero_timed_msg)
+#define HETERO_IOC_GET_CYCLES    _IOR(HETERO_IOC_MAGIC, 11, __u64)
+#define HETERO_IOC_TIME_SYNC     _IOR(HETERO_IOC_MAGIC, 12, struct hetero_time_sync)
+#define HETERO_IOC_RT_CONFIG     _IOW(HETERO_IOC_MAGIC, 13, struct hetero_rt_config)
+#define HETERO_IOC_PWM_SUBMIT    _IOW(HETERO_IOC_MAGIC, 14, struct hetero_pwm_batch)  /* 返回RT核队列中的帧数 */
+
+/* HETERO_IOC_WAIT_VALUE 比较方式: (共享内存字 & mask) op value */
+#define HETERO_WAIT_EQ   0
+#define HETERO_WAIT_NE   1
+#define HETERO_WAIT_GE   2   /* 无符号比较 */
+#define HETERO_WAIT_LT   3
+
+/*
+ * 等待共享内存中的字满足条件 (类似futex), 小核写入后置位主核IPI唤醒
+ * timeout_ms < 0 表示一直等待; 返回时cur_value为最后读到的值
+ */
+struct hetero_wait_value {
+    __u32 offset;       /* 共享内存内偏移, 4字节对齐 */
+    __u32 value;
+    __u32 mask;
+    __u32 op;
+    __s32 timeout_ms;
+    __u32 cur_value;
+};
+
+/* 定时投递: when为时基周期数 (HETERO_IOC_GET_CYCLES), 返回时slot为占用的槽 */
+struct hetero_timed_msg {
+    __s32 core_id;
+    __s32 slot;
+    struct hetero_msg msg;
+    __u64 when;
+};
+
+/*
+ * 全局时基与CLOCK_MONOTONIC的对应关系: 同一时刻采样的一对值,
+ * 周期数c对应的单调时钟为 mono_ns + (c - cycles) * 10^9 / freq_hz
+ */
+struct hetero_time_sync {
+    __u64 cycles;
+    __u64 mono_ns;
+    __u64 freq_hz;
+};
+
+/* RT核执行器配置: cmd为HETERO_MSG_RT_*, 统计通过mmap共享内存读取 */
+struct hetero_rt_config {
+    __u32 cmd;
+    __u32 arg0;
+    __u32 arg1;
+};
+
+/* RT核PWM设定值: frames指向count个struct hetero_pwm_frame, flags为HETERO_PWM_F_* */
+struct hetero_pwm_batch {
+    __u64 frames;
+    __u32 count;
+    __u32 flags;
+};
+
+/* 用户态上调用: GET取请求, REPLY时core_id/seq原样带回, 填写cmd/arg0/arg1 */
+struct hetero_upcall {
+    int core_id;
+    struct hetero_msg msg;
+};
 
 struct hetero_info {
     int num_cores;
@@ -54,114 +151,2048 @@ struct hetero_info {
     unsigned long shared_base;
 };
 
-/* 模拟的硬件寄存器结构 */
-struct hetero_hw_regs {
-    /* IPI寄存器 */
-    volatile u32 ipi_status;
-    volatile u32 ipi_trigger;
-    volatile u32 ipi_clear;
-    volatile u32 ipi_enable;
+/* 模拟的硬件寄存器结构 */
+struct hetero_hw_regs {
+    /* IPI寄存器 */
+    volatile u32 ipi_status;
+    volatile u32 ipi_trigger;
+    volatile u32 ipi_clear;
+    volatile u32 ipi_enable;
+    
+    /* 邮箱寄存器 - Core 0 (IO核) */
+    volatile u32 mbox_main_to_core0_cmd;
+    volatile u32 mbox_main_to_core0_data;
+    volatile u32 mbox_core0_to_main_status;
+    volatile u32 mbox_core0_to_main_resp;
+    
+    /* 邮箱寄存器 - Core 1 (RT核) */
+    volatile u32 mbox_main_to_core1_cmd;
+    volatile u32 mbox_main_to_core1_data;
+    volatile u32 mbox_core1_to_main_status;
+    volatile u32 mbox_core1_to_main_resp;
+    
+    /* 互斥锁寄存器 */
+    volatile u32 hw_mutex_request;
+    volatile u32 hw_mutex_status;
+    volatile u32 hw_mutex_release;
+    
+    /* 小核复位控制 (bit N = 1 保持小核N复位) */
+    volatile u32 small_core_reset;
+    
+    /* 全局时基 (读时由模拟生成) 和邮箱时间戳 */
+    volatile u32 global_time_hi;
+    volatile u32 global_time_lo;
+    struct {
+        volatile u32 send;
+        volatile u32 take;
+        volatile u32 resp;
+        volatile u32 ack;
+    } mbox_ts[HETERO_NUM_SMALL_CORES];
+    
+    /* 小核总线统计和QoS开关 */
+    struct {
+        volatile u32 wait;
+        volatile u32 xfer;
+    } bus_stats[HETERO_NUM_SMALL_CORES];
+    volatile u32 bus_qos_ctrl;
+    
+    /* L2分区控制和命中统计 */
+    volatile u32 l2_ctrl;
+    struct {
+        volatile u32 hit;
+        volatile u32 miss;
+    } l2_stats[L2_NUM_SOURCES];
+    
+    /* 中断路由矩阵 */
+    volatile u32 irq_route_raw;
+    volatile u32 irq_route_polarity;
+    volatile u32 irq_route_rt;
+    volatile u32 irq_route_rt_pending;
+    volatile u32 irq_route_rt_clear;
+    volatile u32 irq_route_main;
+    volatile u32 irq_route_main_pending;
+    volatile u32 irq_route_main_clear;
+    volatile u32 irq_route_stamp;
+    
+    /* 邮箱响应确认 */
+    volatile u32 mbox_core_to_main_ctrl[HETERO_NUM_SMALL_CORES];
+    
+    /* 填充到4KB */
+    u8 padding[4096 - 0xC4];
+} __attribute__((packed));
+
+struct hetero_handler_entry {
+    u32 cmd;
+    hetero_handler_t fn;
+    void *priv;
+};
+
+struct hetero_upcall_entry {
+    u32 cmd;
+    hetero_upcall_fn fn;
+    void *priv;
+};
+
+/* 模拟的硬件同步块事件组 */
+struct hetero_evt_group {
+    u32 flags;
+    u32 mask;
+    u32 cfg;
+    bool match;
+};
+
+/* 模拟的硬件句柄队列, 以及驱动在其上实现的分配器/工作队列 */
+struct hetero_qm_queue {
+    u32 slot[HETERO_QM_DEPTH];
+    u32 head;
+    u32 tail;
+    u32 thresh;
+    u32 cfg;
+    bool above;
+    
+    /* 分配器 */
+    size_t buf_size;
+    int buf_count;
+    
+    /* 工作队列消费者 */
+    hetero_qm_consumer_t fn;
+    void *priv;
+};
+
+/* 模拟的定时投递邮箱槽, 比较器用hrtimer代替 */
+struct hetero_timed_slot {
+    struct hetero_msg msg;
+    u64 when;
+    bool armed;
+    bool fired;
+    int core;
+    struct hrtimer timer;
+};
+
+struct hetero_device {
+    dev_t devno;
+    struct cdev cdev;
+    struct class *class;
+    struct device *device;
+    
+    /* 内存映射 */
+    void *mem_base;              /* 整个映射区域基地址 */
+    struct hetero_hw_regs *regs; /* 寄存器区域 */
+    void *shared_mem;            /* 共享内存区域 */
+    phys_addr_t shm_phys;        /* 共享内存物理地址, 一致性模式下为保留区 */
+    
+    /* 工作队列 - 模拟小核响应 */
+    struct work_struct core0_work;
+    struct work_struct core1_work;
+    
+    /* 消息环 */
+    spinlock_t tx_lock[HETERO_NUM_SMALL_CORES];
+    u32 tx_seq[HETERO_NUM_SMALL_CORES];
+    spinlock_t rx_lock;
+    struct hetero_handler_entry handlers[HETERO_NUM_SMALL_CORES][HETERO_MAX_HANDLERS];
+    
+    /* 上调用 */
+    struct work_struct upcall_work;
+    spinlock_t upcall_lock;
+    struct hetero_upcall_entry upcalls[HETERO_MAX_UPCALLS];
+    spinlock_t reply_lock[HETERO_NUM_SMALL_CORES];
+    DECLARE_KFIFO(user_upcalls, struct hetero_upcall, HETERO_UPCALL_QLEN);
+    spinlock_t user_upcall_lock;
+    wait_queue_head_t upcall_wq;
+    
+    /* 共享内存缓冲池 */
+    struct gen_pool *buf_pool;
+    
+    /* 小核经BUF_ALLOC上调用分配的缓冲区, 只在upcall_work中访问 */
+    struct {
+        u32 bus;
+        u32 size;
+        int core_id;
+    } upcall_bufs[HETERO_UPCALL_BUFS];
+    
+    /* 模拟小核上调用序号 */
+    u32 sim_upcall_seq;
+    
+    /* 旁路模式 */
+    spinlock_t bypass_lock;
+    struct eventfd_ctx *bypass_eventfd;
+    atomic_t bypass_events;          /* 上次read()之后的中断次数 */
+    wait_queue_head_t bypass_wq;
+    struct delayed_work doorbell_work;
+    
+    /* HETERO_IOC_WAIT_VALUE 等待者, 每次主核IPI都唤醒重新检查 */
+    wait_queue_head_t value_wq;
+    
+    /* 硬件同步块 (模拟) */
+    spinlock_t sync_lock;
+    atomic_t sync_main_pending;      /* 待置位的Linux hart IPI位 */
+    struct irq_work sync_work;
+    u16 sems[HETERO_SYNC_NUM_SEMS];
+    struct hetero_evt_group evts[HETERO_SYNC_NUM_GROUPS];
+    
+    /* 硬件句柄队列 (模拟) */
+    spinlock_t qm_lock;
+    struct hetero_qm_queue qm[HETERO_QM_NUM_QUEUES];
+    struct work_struct qm_work;
+    
+    /* 定时投递邮箱 (模拟) */
+    spinlock_t tmbox_lock;
+    struct hetero_timed_slot tmbox[HETERO_NUM_SMALL_CORES][HETERO_TMBOX_SLOTS];
+    
+    /* 中断路由矩阵: 配置寄存器的读-改-写, 以及转发到Linux的源的处理函数 */
+    spinlock_t route_lock;
+    struct {
+        hetero_irq_route_fn fn;
+        void *priv;
+    } route[IRQ_ROUTE_NUM_SOURCES];
+    
+    bool cs_registered;
+    
+    /* RT执行器配置, 同一时间只有一条在途 */
+    struct mutex rt_cfg_lock;
+    struct hetero_call rt_call;
+    
+    /* 统计 */
+    atomic_t ipi_count;
+    atomic_t msg_count;
+    atomic_t msg_dropped;
+    atomic_t upcall_count;
+};
+
+static struct hetero_device *hdev;
+
+/* 主核IPI通知链 (remoteproc等驱动订阅) */
+static ATOMIC_NOTIFIER_HEAD(hetero_main_ipi_chain);
+
+static struct hetero_ring *hetero_ring_at(struct hetero_device *dev, u32 offset)
+{
+    return (struct hetero_ring *)(dev->shared_mem + offset);
+}
+
+/* 入队 (单生产者), 环满返回-ENOSPC */
+static int hetero_ring_push(struct hetero_ring *ring, const struct hetero_msg *msg)
+{
+    u32 head = READ_ONCE(ring->head);
+    
+    if (head - READ_ONCE(ring->tail) >= HETERO_RING_SLOTS)
+        return -ENOSPC;
+    
+    ring->slot[head % HETERO_RING_SLOTS] = *msg;
+    wmb();
+    WRITE_ONCE(ring->head, head + 1);
+    return 0;
+}
+
+/* 出队 (单消费者), 环空返回false */
+static bool hetero_ring_pop(struct hetero_ring *ring, struct hetero_msg *msg)
+{
+    u32 tail = READ_ONCE(ring->tail);
+    
+    if (tail == READ_ONCE(ring->head))
+        return false;
+    
+    rmb();
+    *msg = ring->slot[tail % HETERO_RING_SLOTS];
+    mb();
+    WRITE_ONCE(ring->tail, tail + 1);
+    return true;
+}
+
+/* 取出所有小核RX环里的消息, 按cmd分发给注册的处理函数 */
+static void hetero_dispatch_rx(struct hetero_device *dev)
+{
+    struct hetero_handler_entry *h;
+    struct hetero_msg msg;
+    bool handled;
+    int core, i;
+    
+    spin_lock(&dev->rx_lock);
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        while (hetero_ring_pop(hetero_ring_at(dev, HETERO_RING_RX_OFFSET(core)), &msg)) {
+            handled = false;
+            for (i = 0; i < HETERO_MAX_HANDLERS; i++) {
+                h = &dev->handlers[core][i];
+                if (h->fn && h->cmd == (msg.cmd & ~HETERO_MSG_ERR)) {
+                    h->fn(core, &msg, h->priv);
+                    handled = true;
+                    break;
+                }
+            }
+            if (!handled)
+                atomic_inc(&dev->msg_dropped);
+        }
+    }
+    spin_unlock(&dev->rx_lock);
+}
+
+/* 是否有小核发起的上调用等待处理 */
+static bool hetero_upcall_pending(struct hetero_device *dev)
+{
+    struct hetero_ring *up;
+    int core;
+    
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        up = hetero_ring_at(dev, HETERO_RING_UP_OFFSET(core));
+        if (READ_ONCE(up->head) != READ_ONCE(up->tail))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * 旁路模式的主核IPI: 屏蔽主核IPI(电平中断, 状态位留给用户态清除),
+ * 计数并通知eventfd和read()等待者
+ */
+static void hetero_bypass_irq(struct hetero_device *dev)
+{
+    unsigned long flags;
+    
+    dev->regs->ipi_enable &= ~HETERO_IPI_MAIN_MASK;
+    atomic_inc(&dev->bypass_events);
+    
+    spin_lock_irqsave(&dev->bypass_lock, flags);
+    if (dev->bypass_eventfd)
+        eventfd_signal(dev->bypass_eventfd, 1);
+    spin_unlock_irqrestore(&dev->bypass_lock, flags);
+    
+    wake_up_interruptible(&dev->bypass_wq);
+}
+
+/* 是否有注册了消费者的句柄队列非空 */
+static bool hetero_qm_consumer_pending(struct hetero_device *dev)
+{
+    struct hetero_qm_queue *queue;
+    int q;
+    
+    for (q = 0; q < HETERO_QM_NUM_QUEUES; q++) {
+        queue = &dev->qm[q];
+        if (READ_ONCE(queue->fn) && READ_ONCE(queue->head) != READ_ONCE(queue->tail))
+            return true;
+    }
+    return false;
+}
+
+/* 转发到Linux的路由源: 清除挂起位后交给注册的处理函数 */
+static void hetero_dispatch_irq_route(struct hetero_device *dev)
+{
+    u32 pending = dev->regs->irq_route_main_pending;
+    u32 stamp;
+    int src;
+    
+    if (!pending)
+        return;
+    
+    stamp = dev->regs->irq_route_stamp;
+    /* 写1清除, 清除期间新挂起的源不会丢 */
+    hetero_reg_write(IRQ_ROUTE_MAIN_CLEAR_OFFSET, pending);
+    
+    spin_lock(&dev->route_lock);
+    for (src = 0; src < IRQ_ROUTE_NUM_SOURCES; src++) {
+        if ((pending & (1 << src)) && dev->route[src].fn)
+            dev->route[src].fn(src, stamp, dev->route[src].priv);
+    }
+    spin_unlock(&dev->route_lock);
+}
+
+/* 主核IPI中断处理: 读取并清除主核位, 分发RX消息并通知订阅者 */
+static irqreturn_t hetero_main_ipi_irq(int irq, void *data)
+{
+    struct hetero_device *dev = data;
+    u32 status = dev->regs->ipi_status & dev->regs->ipi_enable;
+    
+    if (!(status & HETERO_IPI_MAIN_MASK))
+        return IRQ_NONE;
+    
+    wake_up_interruptible_all(&dev->value_wq);
+    
+    if (bypass) {
+        hetero_bypass_irq(dev);
+        return IRQ_HANDLED;
+    }
+    
+    dev->regs->ipi_status &= ~HETERO_IPI_MAIN_MASK;
+    hetero_dispatch_rx(dev);
+    hetero_dispatch_irq_route(dev);
+    if (hetero_upcall_pending(dev))
+        schedule_work(&dev->upcall_work);
+    if (hetero_qm_consumer_pending(dev))
+        schedule_work(&dev->qm_work);
+    atomic_notifier_call_chain(&hetero_main_ipi_chain, status, NULL);
+    
+    return IRQ_HANDLED;
+}
+
+/*
+ * 模拟置位Linux hart的IPI位, 在关中断的上下文中调用中断处理函数
+ * (模拟环境只有一个中断处理函数, 代表所有hart)
+ */
+static void hetero_sim_raise_harts(struct hetero_device *dev, u32 hart_bits)
+{
+    unsigned long flags;
+    
+    dev->regs->ipi_status |= hart_bits & HETERO_IPI_MAIN_MASK;
+    
+    local_irq_save(flags);
+    hetero_main_ipi_irq(0, dev);
+    local_irq_restore(flags);
+}
+
+/* 模拟小核置位主核IPI (默认通知hart0) */
+static void hetero_sim_raise_main_ipi(struct hetero_device *dev)
+{
+    hetero_sim_raise_harts(dev, 1 << HETERO_IPI_MAIN_BIT);
+}
+
+/*
+ * 模拟小核写响应: RX环满时先通知主核取走. 旁路模式下主核IPI被屏蔽, RX环由
+ * 用户态取, 在这里等会一直空转, 环满时丢弃并计入msg_dropped
+ */
+static void hetero_sim_push_resp(struct hetero_device *dev, struct hetero_ring *rx,
+                                 struct hetero_msg *msg)
+{
+    while (hetero_ring_push(rx, msg) == -ENOSPC) {
+        if (bypass) {
+            atomic_inc(&dev->msg_dropped);
+            return;
+        }
+        hetero_sim_raise_main_ipi(dev);
+    }
+}
+
+/* 模拟小核处理TX环: 每条请求回一条响应, 参数原样返回 */
+static int hetero_sim_service_ring(struct hetero_device *dev, int core_id)
+{
+    struct hetero_ring *tx = hetero_ring_at(dev, HETERO_RING_TX_OFFSET(core_id));
+    struct hetero_ring *rx = hetero_ring_at(dev, HETERO_RING_RX_OFFSET(core_id));
+    struct hetero_msg msg;
+    int count = 0;
+    
+    while (hetero_ring_pop(tx, &msg)) {
+        msg.cmd |= HETERO_MSG_RESP;
+        hetero_sim_push_resp(dev, rx, &msg);
+        count++;
+    }
+    
+    return count;
+}
+
+/* 模拟邮箱时间戳: 硬件在对应的寄存器写入时锁存时基低32位 */
+static u32 hetero_sim_stamp(void)
+{
+    return (u32)hetero_read_cycles();
+}
+
+/* 模拟中断路由矩阵的边沿锁存, 源电平由old变为raw */
+static void hetero_sim_irq_route_input(struct hetero_device *dev, u32 old, u32 raw)
+{
+    u32 pol = dev->regs->irq_route_polarity;
+    u32 edge = ((raw & ~old & ~pol) | (~raw & old & pol)) & (BIT(IRQ_ROUTE_NUM_SOURCES) - 1);
+    u32 rt = edge & dev->regs->irq_route_rt;
+    u32 main = edge & dev->regs->irq_route_main;
+    
+    if (!(rt | main))
+        return;
+    
+    dev->regs->irq_route_stamp = hetero_sim_stamp();
+    dev->regs->irq_route_rt_pending |= rt;
+    if (main) {
+        dev->regs->irq_route_main_pending |= main;
+        hetero_sim_raise_main_ipi(dev);
+    }
+}
+
+/* 模拟小核取走已投递的定时消息, 和TX环消息一样回一条响应 */
+static int hetero_sim_service_timed(struct hetero_device *dev, int core_id)
+{
+    struct hetero_ring *rx = hetero_ring_at(dev, HETERO_RING_RX_OFFSET(core_id));
+    struct hetero_timed_slot *ts;
+    struct hetero_msg msg;
+    unsigned long flags;
+    int count = 0;
+    int slot;
+    
+    for (slot = 0; slot < HETERO_TMBOX_SLOTS; slot++) {
+        ts = &dev->tmbox[core_id][slot];
+        
+        spin_lock_irqsave(&dev->tmbox_lock, flags);
+        if (!ts->fired) {
+            spin_unlock_irqrestore(&dev->tmbox_lock, flags);
+            continue;
+        }
+        msg = ts->msg;
+        ts->fired = false;  /* 写CTRL释放槽 */
+        spin_unlock_irqrestore(&dev->tmbox_lock, flags);
+        
+        msg.cmd |= HETERO_MSG_RESP;
+        hetero_sim_push_resp(dev, rx, &msg);
+        count++;
+    }
+    
+    return count;
+}
+
+/* 模拟小核取走REPLY环里的上调用应答 */
+static void hetero_sim_consume_replies(struct hetero_device *dev, int core_id)
+{
+    struct hetero_msg reply;
+    
+    while (hetero_ring_pop(hetero_ring_at(dev, HETERO_RING_REPLY_OFFSET(core_id)), &reply))
+        pr_info("%s: [Core %d] 上调用应答: cmd=0x%04x seq=%u arg0=0x%08x\n",
+                DRIVER_NAME, core_id, reply.cmd, reply.seq, reply.arg0);
+}
+
+/* 模拟IO核(Core 0)的响应 */
+static void core0_response_work(struct work_struct *work)
+{
+    struct hetero_device *dev = container_of(work, struct hetero_device, core0_work);
+    struct hetero_msg up;
+    u32 cmd, data;
+    int ring_count;
+    
+    /* 取走主核的上调用应答 */
+    hetero_sim_consume_replies(dev, 0);
+    
+    /* 读取邮箱命令 */
+    cmd = dev->regs->mbox_main_to_core0_cmd;
+    data = dev->regs->mbox_main_to_core0_data;
+    
+    if (cmd != 0) {
+        pr_info("%s: [IO Core] 收到命令: cmd=0x%04x, data=0x%08x\n", 
+                DRIVER_NAME, cmd, data);
+        
+        /* 模拟处理延迟 */
+        msleep(1);
+        
+        /* 发送响应 */
+        switch (cmd) {
+        case 0x0001:  /* PING命令 */
+            dev->regs->mbox_core0_to_main_resp = 0x8001;  /* PONG响应 */
+            break;
+        case 0x0010:  /* 读取状态 */
+            dev->regs->mbox_core0_to_main_resp = 0x8010 | (jiffies & 0xFF);
+            break;
+        case 0x0020:  /* 发起上调用, data为上调用命令 */
+            up.cmd = data;
+            up.seq = ++dev->sim_upcall_seq;
+            up.arg0 = 0x1234;
+            up.arg1 = 0;
+            if (hetero_ring_push(hetero_ring_at(dev, HETERO_RING_UP_OFFSET(0)), &up))
+                dev->regs->mbox_core0_to_main_resp = 0xFFFE;  /* 上调用环满 */
+            else
+                dev->regs->mbox_core0_to_main_resp = 0x8020;
+            break;
+        case 0x0030:  /* 共享内存字加一, data为偏移 */
+            if (data % 4 == 0 && data < HETERO_AMO_SIZE) {
+                hetero_atomic_fetch_add(data, 1);
+                dev->regs->mbox_core0_to_main_resp = 0x8030;
+            } else {
+                dev->regs->mbox_core0_to_main_resp = 0xFFFF;
+            }
+            break;
+        case 0x0040:  /* 句柄队列转发: data[7:0]出队, data[15:8]入队 */
+            ring_count = 0;
+            if ((data & 0xFF) >= HETERO_QM_NUM_QUEUES ||
+                ((data >> 8) & 0xFF) >= HETERO_QM_NUM_QUEUES) {
+                dev->regs->mbox_core0_to_main_resp = 0xFFFF;
+                break;
+            }
+            while (hetero_qm_count((data >> 8) & 0xFF) < HETERO_QM_DEPTH &&
+                   !hetero_qm_pop(data & 0xFF, &up.arg0)) {
+                hetero_qm_push((data >> 8) & 0xFF, up.arg0);
+                ring_count++;
+            }
+            dev->regs->mbox_core0_to_main_resp = 0x8040 | (ring_count & 0xFF);
+            break;
+        default:
+            dev->regs->mbox_core0_to_main_resp = 0xFFFF;  /* 未知命令 */
+        }
+        
+        dev->regs->mbox_ts[0].resp = hetero_sim_stamp();
+        
+        /* 清除命令，表示已处理 */
+        dev->regs->mbox_main_to_core0_cmd = 0;
+        dev->regs->mbox_ts[0].take = hetero_sim_stamp();
+        
+        /* 设置状态位，通知主核 */
+        dev->regs->mbox_core0_to_main_status = 1;
+        
+        pr_info("%s: [IO Core] 发送响应: 0x%04x\n", 
+                DRIVER_NAME, dev->regs->mbox_core0_to_main_resp);
+    }
+    
+    /* 处理定时消息和消息环 */
+    ring_count = hetero_sim_service_timed(dev, 0);
+    ring_count += hetero_sim_service_ring(dev, 0);
+    
+    /* 清除IPI */
+    dev->regs->ipi_status &= ~0x01;
+    
+    if (cmd != 0 || ring_count)
+        hetero_sim_raise_main_ipi(dev);
+}
+
+/* 模拟RT核(Core 1)的响应 */
+static void core1_response_work(struct work_struct *work)
+{
+    struct hetero_device *dev = container_of(work, struct hetero_device, core1_work);
+    
+    pr_info("%s: [RT Core] 收到IPI中断\n", DRIVER_NAME);
+    
+    /* 取走主核的上调用应答 */
+    hetero_sim_consume_replies(dev, 1);
+    
+    /* RT核的快速响应 */
+    dev->regs->mbox_core1_to_main_resp = 0x5200 | (jiffies & 0xFF);
+    dev->regs->mbox_ts[1].resp = hetero_sim_stamp();
+    
+    /* 清除命令，表示已处理 */
+    if (dev->regs->mbox_main_to_core1_cmd)
+        dev->regs->mbox_ts[1].take = hetero_sim_stamp();
+    dev->regs->mbox_main_to_core1_cmd = 0;
+    dev->regs->mbox_core1_to_main_status = 1;
+    
+    /* 处理定时消息和消息环 */
+    hetero_sim_service_timed(dev, 1);
+    hetero_sim_service_ring(dev, 1);
+    
+    /* 清除IPI */
+    dev->regs->ipi_status &= ~0x02;
+    
+    hetero_sim_raise_main_ipi(dev);
+}
+
+/* 模拟IPI到达小核 */
+static void hetero_sim_deliver_ipi(struct hetero_device *dev, int core_id)
+{
+    dev->regs->ipi_status |= (1 << core_id);
+    atomic_inc(&dev->ipi_count);
+    
+    /* 处于复位中的小核不响应 */
+    if (dev->regs->small_core_reset & (1 << core_id))
+        return;
+    
+    /* 调度工作队列模拟小核响应 */
+    if (core_id == 0) {
+        schedule_work(&dev->core0_work);
+    } else if (core_id == 1) {
+        schedule_work(&dev->core1_work);
+    }
+}
+
+/* 模拟ipi_trigger写入: 小核位调度小核, hart位进入Linux中断 */
+static void hetero_sim_trigger(struct hetero_device *dev, u32 mask)
+{
+    int core;
+    
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++)
+        if (mask & (1 << core))
+            hetero_sim_deliver_ipi(dev, core);
+    
+    if (mask & HETERO_IPI_MAIN_MASK)
+        hetero_sim_raise_harts(dev, mask);
+}
+
+/*
+ * 模拟硬件的地址译码: 旁路模式下用户态直接写IPI_TRIGGER/IPI_CLEAR,
+ * 内核看不到这些写操作, 只能周期性地轮询
+ */
+static void hetero_sim_doorbell_work(struct work_struct *work)
+{
+    struct hetero_device *dev = container_of(to_delayed_work(work),
+                                             struct hetero_device, doorbell_work);
+    u32 trigger, clear;
+    
+    clear = dev->regs->ipi_clear;
+    if (clear) {
+        dev->regs->ipi_clear = 0;
+        dev->regs->ipi_status &= ~clear;
+    }
+    
+    trigger = dev->regs->ipi_trigger;
+    if (trigger) {
+        dev->regs->ipi_trigger = 0;
+        hetero_sim_trigger(dev, trigger);
+    }
+    
+    schedule_delayed_work(&dev->doorbell_work, 1);
+}
+
+/* 一次写ipi_trigger同时触发mask中的所有核, 可在原子上下文调用 */
+static int hetero_send_ipi_mask(struct hetero_device *dev, u32 mask)
+{
+    if (!mask || (mask & ~HETERO_IPI_ALL_MASK))
+        return -EINVAL;
+    
+    /* 设置IPI触发寄存器 */
+    dev->regs->ipi_trigger = mask;
+    if (bypass) {
+        /* 和用户态直接写寄存器一样, 交给门铃轮询 */
+        return 0;
+    }
+    
+    dev->regs->ipi_trigger = 0;
+    hetero_sim_trigger(dev, mask);
+    return 0;
+}
+
+/* 发送IPI到小核, 可在原子上下文调用 */
+static int hetero_send_ipi(struct hetero_device *dev, int core_id)
+{
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES)
+        return -EINVAL;
+    
+    return hetero_send_ipi_mask(dev, 1 << core_id);
+}
+
+/* 写一条上调用应答到小核的REPLY环 */
+static int hetero_upcall_reply(struct hetero_device *dev, int core_id,
+                               const struct hetero_msg *reply)
+{
+    unsigned long flags;
+    int ret;
+    
+    spin_lock_irqsave(&dev->reply_lock[core_id], flags);
+    ret = hetero_ring_push(hetero_ring_at(dev, HETERO_RING_REPLY_OFFSET(core_id)), reply);
+    spin_unlock_irqrestore(&dev->reply_lock[core_id], flags);
+    
+    if (ret)
+        pr_warn_ratelimited("%s: 小核%d应答环满, 丢弃应答seq=%u\n",
+                            DRIVER_NAME, core_id, reply->seq);
+    return ret;
+}
+
+/* 查找上调用处理函数 */
+static hetero_upcall_fn hetero_upcall_lookup(struct hetero_device *dev, u32 cmd,
+                                             void **priv)
+{
+    hetero_upcall_fn fn = NULL;
+    unsigned long flags;
+    int i;
+    
+    spin_lock_irqsave(&dev->upcall_lock, flags);
+    for (i = 0; i < HETERO_MAX_UPCALLS; i++) {
+        if (dev->upcalls[i].fn && dev->upcalls[i].cmd == cmd) {
+            fn = dev->upcalls[i].fn;
+            *priv = dev->upcalls[i].priv;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&dev->upcall_lock, flags);
+    
+    return fn;
+}
+
+/* 处理小核发起的上调用: 内核处理函数优先, 否则交给用户态 */
+static void hetero_upcall_work(struct work_struct *work)
+{
+    struct hetero_device *dev = container_of(work, struct hetero_device, upcall_work);
+    struct hetero_upcall uc;
+    struct hetero_msg reply;
+    hetero_upcall_fn fn;
+    bool queued, kick;
+    void *priv;
+    int core, ret;
+    
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        kick = false;
+        
+        while (hetero_ring_pop(hetero_ring_at(dev, HETERO_RING_UP_OFFSET(core)), &uc.msg)) {
+            atomic_inc(&dev->upcall_count);
+            
+            reply.cmd = uc.msg.cmd | HETERO_MSG_RESP;
+            reply.seq = uc.msg.seq;
+            reply.arg0 = 0;
+            reply.arg1 = 0;
+            
+            fn = hetero_upcall_lookup(dev, uc.msg.cmd, &priv);
+            if (fn) {
+                ret = fn(core, &uc.msg, &reply, priv);
+            } else {
+                uc.core_id = core;
+                queued = kfifo_in_spinlocked(&dev->user_upcalls, &uc, 1,
+                                             &dev->user_upcall_lock);
+                if (queued) {
+                    wake_up_interruptible(&dev->upcall_wq);
+                    continue;
+                }
+                ret = -ENOENT;
+            }
+            
+            /* seq为0是单向通知 */
+            if (!uc.msg.seq)
+                continue;
+            
+            if (ret < 0) {
+                reply.cmd |= HETERO_MSG_ERR;
+                reply.arg0 = -ret;
+            }
+            hetero_upcall_reply(dev, core, &reply);
+            kick = true;
+        }
+        
+        if (kick)
+            hetero_send_ipi(dev, core);
+    }
+}
+
+/* 查找小核分配的缓冲区, 地址, 大小和核号都要一致 */
+static int hetero_upcall_buf_find(int core_id, u32 bus, u32 size)
+{
+    int i;
+    
+    for (i = 0; i < HETERO_UPCALL_BUFS; i++) {
+        if (hdev->upcall_bufs[i].size && hdev->upcall_bufs[i].bus == bus &&
+            hdev->upcall_bufs[i].size == size && hdev->upcall_bufs[i].core_id == core_id)
+            return i;
+    }
+    return -1;
+}
+
+/* 内置上调用: 从共享内存缓冲池分配/释放, 打印小核日志 */
+static int hetero_upcall_builtin(int core_id, const struct hetero_msg *req,
+                                 struct hetero_msg *reply, void *priv)
+{
+    void *buf;
+    u32 bus;
+    int i;
+    
+    switch (req->cmd) {
+    case HETERO_UPCALL_BUF_ALLOC:
+        for (i = 0; i < HETERO_UPCALL_BUFS && hdev->upcall_bufs[i].size; i++)
+            ;
+        if (i == HETERO_UPCALL_BUFS)
+            return -ENOSPC;
+        if (!req->arg0 || !hetero_buf_alloc(req->arg0, &bus))
+            return -ENOMEM;
+        hdev->upcall_bufs[i].bus = bus;
+        hdev->upcall_bufs[i].size = req->arg0;
+        hdev->upcall_bufs[i].core_id = core_id;
+        reply->arg0 = bus;
+        return 0;
+        
+    case HETERO_UPCALL_BUF_FREE:
+        /* 只释放本核分配过的缓冲区, 错误的地址/大小或重复释放不交给gen_pool */
+        i = hetero_upcall_buf_find(core_id, req->arg0, req->arg1);
+        if (i < 0)
+            return -EINVAL;
+        hetero_buf_free(hetero_bus_to_buf(req->arg0), req->arg1);
+        hdev->upcall_bufs[i].size = 0;
+        return 0;
+        
+    case HETERO_UPCALL_LOG:
+        buf = hetero_bus_to_buf(req->arg0);
+        if (!buf || !hetero_bus_to_buf(req->arg0 + req->arg1 - 1))
+            return -EINVAL;
+        pr_info("%s: [Core %d] %.*s\n", DRIVER_NAME, core_id,
+                (int)req->arg1, (char *)buf);
+        return 0;
+        
+    case HETERO_UPCALL_RT_OVERRUN:
+        if (req->arg1)
+            pr_warn_ratelimited("%s: [Core %d] RT任务%u超过截止期, 响应时间%u周期\n",
+                                DRIVER_NAME, core_id, req->arg0, req->arg1);
+        else
+            pr_warn_ratelimited("%s: [Core %d] RT任务%u错过释放\n",
+                                DRIVER_NAME, core_id, req->arg0);
+        return 0;
+    }
+    
+    return -ENOENT;
+}
+
+/* ---------------- 导出给其他内核模块的接口 ---------------- */
+
+void *hetero_shared_mem(void)
+{
+    return hdev->shared_mem;
+}
+EXPORT_SYMBOL_GPL(hetero_shared_mem);
+
+phys_addr_t hetero_shared_phys(void)
+{
+    return hdev->shm_phys;
+}
+EXPORT_SYMBOL_GPL(hetero_shared_phys);
+
+u32 hetero_reg_read(u32 offset)
+{
+    /* 模拟全局时基 */
+    if (offset == GLOBAL_TIME_HI_OFFSET)
+        return (u32)(hetero_read_cycles() >> 32);
+    if (offset == GLOBAL_TIME_LO_OFFSET)
+        return (u32)hetero_read_cycles();
+    
+    return *(volatile u32 *)((u8 *)hdev->regs + offset);
+}
+EXPORT_SYMBOL_GPL(hetero_reg_read);
+
+void hetero_reg_write(u32 offset, u32 val)
+{
+    u32 old_raw = hdev->regs->irq_route_raw;
+    int core;
+    
+    *(volatile u32 *)((u8 *)hdev->regs + offset) = val;
+    
+    /* 模拟邮箱: 写入非零命令记录时间戳; 向ctrl写bit0确认响应, 清除响应挂起 */
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        if (offset == MBOX_MAIN_TO_CORE_CMD_OFFSET(core) && val) {
+            hdev->regs->mbox_ts[core].send = hetero_sim_stamp();
+        } else if (offset == MBOX_CORE_TO_MAIN_CTRL_OFFSET(core) && (val & MBOX_CTRL_ACK)) {
+            hdev->regs->mbox_ts[core].ack = hetero_sim_stamp();
+            *(volatile u32 *)((u8 *)hdev->regs + MBOX_CORE_TO_MAIN_STATUS_OFFSET(core)) = 0;
+        }
+    }
+    
+    /* 模拟中断路由矩阵: 写RAW即改变源电平, 挂起寄存器写1清除 */
+    if (offset == IRQ_ROUTE_RAW_OFFSET)
+        hetero_sim_irq_route_input(hdev, old_raw, val);
+    else if (offset == IRQ_ROUTE_RT_CLEAR_OFFSET)
+        hdev->regs->irq_route_rt_pending &= ~val;
+    else if (offset == IRQ_ROUTE_MAIN_CLEAR_OFFSET)
+        hdev->regs->irq_route_main_pending &= ~val;
+}
+EXPORT_SYMBOL_GPL(hetero_reg_write);
+
+int hetero_kick_core(int core_id)
+{
+    return hetero_send_ipi(hdev, core_id);
+}
+EXPORT_SYMBOL_GPL(hetero_kick_core);
+
+int hetero_kick_mask(u32 ipi_mask)
+{
+    return hetero_send_ipi_mask(hdev, ipi_mask);
+}
+EXPORT_SYMBOL_GPL(hetero_kick_mask);
+
+int hetero_core_set_reset(int core_id, bool assert)
+{
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES)
+        return -EINVAL;
+    
+    if (assert)
+        hdev->regs->small_core_reset |= (1 << core_id);
+    else
+        hdev->regs->small_core_reset &= ~(1 << core_id);
+    
+    pr_info("%s: 小核%d %s\n", DRIVER_NAME, core_id,
+            assert ? "保持复位" : "释放复位");
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_core_set_reset);
+
+int hetero_register_notifier(struct notifier_block *nb)
+{
+    /* 旁路模式下主核IPI归用户态所有 */
+    if (bypass)
+        return -EBUSY;
+    
+    return atomic_notifier_chain_register(&hetero_main_ipi_chain, nb);
+}
+EXPORT_SYMBOL_GPL(hetero_register_notifier);
+
+int hetero_unregister_notifier(struct notifier_block *nb)
+{
+    return atomic_notifier_chain_unregister(&hetero_main_ipi_chain, nb);
+}
+EXPORT_SYMBOL_GPL(hetero_unregister_notifier);
+
+int hetero_submit(int core_id, struct hetero_msg *msg, unsigned int flags)
+{
+    struct hetero_ring *tx;
+    unsigned long irqflags;
+    int ret;
+    
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES || !msg)
+        return -EINVAL;
+    /* 旁路模式下消息环和主核IPI归用户态所有, 响应不会进入内核 */
+    if (bypass)
+        return -EBUSY;
+    
+    tx = hetero_ring_at(hdev, HETERO_RING_TX_OFFSET(core_id));
+    
+    spin_lock_irqsave(&hdev->tx_lock[core_id], irqflags);
+    msg->seq = ++hdev->tx_seq[core_id];
+    ret = hetero_ring_push(tx, msg);
+    spin_unlock_irqrestore(&hdev->tx_lock[core_id], irqflags);
+    
+    if (ret)
+        return ret;
+    
+    atomic_inc(&hdev->msg_count);
+    
+    if (!(flags & HETERO_SUBMIT_NOKICK))
+        ret = hetero_send_ipi(hdev, core_id);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_submit);
+
+int hetero_broadcast(u32 core_mask, const struct hetero_msg *msg)
+{
+    struct hetero_msg m;
+    u32 queued = 0;
+    int ret = 0;
+    int core;
+    
+    if (!msg || !core_mask || (core_mask & ~HETERO_IPI_SMALL_MASK))
+        return -EINVAL;
+    if (bypass)
+        return -EBUSY;
+    
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++) {
+        if (!(core_mask & (1 << core)))
+            continue;
+        
+        m = *msg;
+        if (hetero_submit(core, &m, HETERO_SUBMIT_NOKICK))
+            ret = -ENOSPC;
+        else
+            queued |= 1 << core;
+    }
+    
+    /* 所有入队成功的小核一次唤醒 */
+    if (queued)
+        hetero_send_ipi_mask(hdev, queued);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_broadcast);
+
+static u64 hetero_cycles_to_ns(u64 cycles)
+{
+    return mul_u64_u32_div(cycles, NSEC_PER_SEC / 1000, HETERO_TIMEBASE_HZ / 1000);
+}
+
+/*
+ * 模拟的全局时基: 由local_clock()换算, 不经过timekeeping,
+ * 因此也可以作为clocksource被选为系统时钟
+ */
+u64 hetero_read_cycles(void)
+{
+    return mul_u64_u32_div(local_clock(), HETERO_TIMEBASE_HZ / 1000, NSEC_PER_SEC / 1000);
+}
+EXPORT_SYMBOL_GPL(hetero_read_cycles);
+
+static u64 hetero_cs_read(struct clocksource *cs)
+{
+    return hetero_read_cycles();
+}
+
+/* 评级低于CPU定时器, 默认不替换系统时钟, 供对比和时间戳换算 */
+static struct clocksource hetero_clocksource = {
+    .name   = "hetero_gtime",
+    .rating = 100,
+    .read   = hetero_cs_read,
+    .mask   = CLOCKSOURCE_MASK(64),
+    .flags  = CLOCK_SOURCE_IS_CONTINUOUS,
+};
+
+/* 采样一对同一时刻的 (时基, CLOCK_MONOTONIC), 时基取前后两次读数的中点 */
+static void hetero_time_sync(struct hetero_time_sync *sync)
+{
+    unsigned long flags;
+    u64 before, after;
+    
+    local_irq_save(flags);
+    before = hetero_read_cycles();
+    sync->mono_ns = ktime_get_ns();
+    after = hetero_read_cycles();
+    local_irq_restore(flags);
+    
+    sync->cycles = before + (after - before) / 2;
+    sync->freq_hz = HETERO_TIMEBASE_HZ;
+}
+
+/* 模拟定时邮箱的比较器: 到达目标时刻时投递并触发小核IPI */
+static enum hrtimer_restart hetero_tmbox_fire(struct hrtimer *timer)
+{
+    struct hetero_timed_slot *ts = container_of(timer, struct hetero_timed_slot, timer);
+    enum hrtimer_restart restart = HRTIMER_NORESTART;
+    unsigned long flags;
+    bool fire = false;
+    u64 now;
+    
+    spin_lock_irqsave(&hdev->tmbox_lock, flags);
+    /* 槽可能已被取消后重新装填, 以当前的目标时刻为准 */
+    if (ts->armed) {
+        now = hetero_read_cycles();
+        if (now >= ts->when) {
+            ts->armed = false;
+            ts->fired = true;
+            fire = true;
+        } else {
+            /* hrtimer按CLOCK_MONOTONIC到期, 与时基有微小偏差时补足剩余时间 */
+            hrtimer_forward_now(timer, ns_to_ktime(hetero_cycles_to_ns(ts->when - now)));
+            restart = HRTIMER_RESTART;
+        }
+    }
+    spin_unlock_irqrestore(&hdev->tmbox_lock, flags);
+    
+    if (fire)
+        hetero_sim_deliver_ipi(hdev, ts->core);
+    
+    return restart;
+}
+
+int hetero_submit_at(int core_id, struct hetero_msg *msg, u64 when)
+{
+    struct hetero_timed_slot *ts = NULL;
+    unsigned long flags;
+    u64 now;
+    int slot;
+    
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES || !msg)
+        return -EINVAL;
+    /* 和hetero_submit一样, 旁路模式下响应环归用户态 */
+    if (bypass)
+        return -EBUSY;
+    
+    now = hetero_read_cycles();
+    if (when <= now)
+        return -ETIME;
+    
+    spin_lock_irqsave(&hdev->tmbox_lock, flags);
+    for (slot = 0; slot < HETERO_TMBOX_SLOTS; slot++) {
+        if (!hdev->tmbox[core_id][slot].armed && !hdev->tmbox[core_id][slot].fired) {
+            ts = &hdev->tmbox[core_id][slot];
+            break;
+        }
+    }
+    if (!ts) {
+        spin_unlock_irqrestore(&hdev->tmbox_lock, flags);
+        return -EBUSY;
+    }
+    
+    /* 和TX环共用序号, 响应都从RX环回来 */
+    spin_lock(&hdev->tx_lock[core_id]);
+    msg->seq = ++hdev->tx_seq[core_id];
+    spin_unlock(&hdev->tx_lock[core_id]);
+    
+    /* 写消息和目标时刻, 最后写CTRL装填 */
+    ts->msg = *msg;
+    ts->when = when;
+    ts->armed = true;
+    hrtimer_start(&ts->timer, ns_to_ktime(hetero_cycles_to_ns(when - now)), HRTIMER_MODE_REL);
+    spin_unlock_irqrestore(&hdev->tmbox_lock, flags);
+    
+    atomic_inc(&hdev->msg_count);
+    return slot;
+}
+EXPORT_SYMBOL_GPL(hetero_submit_at);
+
+int hetero_cancel_at(int core_id, int slot)
+{
+    struct hetero_timed_slot *ts;
+    unsigned long flags;
+    int ret = 0;
+    
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES ||
+        slot < 0 || slot >= HETERO_TMBOX_SLOTS)
+        return -EINVAL;
+    
+    ts = &hdev->tmbox[core_id][slot];
+    
+    /*
+     * 持锁取消定时器: 放锁后槽可能马上被hetero_submit_at重新装填, 再取消就会
+     * 停掉新的定时器. hrtimer_try_to_cancel不等待, 正在运行的hetero_tmbox_fire
+     * 拿到锁后看到armed已清除, 不会投递
+     */
+    spin_lock_irqsave(&hdev->tmbox_lock, flags);
+    if (ts->fired) {
+        ret = -EALREADY;
+    } else if (!ts->armed) {
+        ret = -ENOENT;
+    } else {
+        ts->armed = false;  /* 写CTRL释放 */
+        hrtimer_try_to_cancel(&ts->timer);
+    }
+    spin_unlock_irqrestore(&hdev->tmbox_lock, flags);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_cancel_at);
+
+/* 发送一条RT核配置消息并等待应答, buf见hetero_call */
+static int hetero_rt_call(struct hetero_msg *msg, struct hetero_msg *resp,
+                          void *buf, size_t size)
+{
+    int ret;
+    
+    if (bypass)
+        return -EBUSY;
+    
+    mutex_lock(&hdev->rt_cfg_lock);
+    ret = hetero_call(&hdev->rt_call, msg, resp, buf, size, msecs_to_jiffies(100));
+    mutex_unlock(&hdev->rt_cfg_lock);
+    return ret;
+}
+
+int hetero_rt_config(u32 cmd, u32 arg0, u32 arg1)
+{
+    struct hetero_msg msg = { .cmd = cmd, .arg0 = arg0, .arg1 = arg1 };
+    struct hetero_msg resp;
+    
+    if (cmd < HETERO_MSG_RT_POLICY || cmd > HETERO_MSG_RT_LAST)
+        return -EINVAL;
+    
+    return hetero_rt_call(&msg, &resp, NULL, 0);
+}
+EXPORT_SYMBOL_GPL(hetero_rt_config);
+
+int hetero_pwm_submit(const struct hetero_pwm_frame *frames, int n, unsigned int flags)
+{
+    struct hetero_msg msg = { .cmd = HETERO_MSG_RT_PWM_BATCH };
+    struct hetero_msg resp;
+    size_t size = n * sizeof(*frames);
+    void *buf;
+    u32 bus;
+    int ret;
+    
+    if (n <= 0 || n > HETERO_PWM_QUEUE_LEN || (flags & ~HETERO_PWM_F_FLUSH))
+        return -EINVAL;
+    
+    buf = hetero_buf_alloc(size, &bus);
+    if (!buf)
+        return -ENOMEM;
+    memcpy(buf, frames, size);
+    
+    msg.arg0 = bus;
+    msg.arg1 = n | (flags << 16);
+    ret = hetero_rt_call(&msg, &resp, buf, size);
+    if (ret == -ETIMEDOUT)
+        return ret;     /* RT核之后仍可能读这批帧, 缓冲区等应答再释放 */
+    
+    hetero_buf_free(buf, size);
+    return ret ? ret : (int)(resp.arg1 & 0xFFFF);
+}
+EXPORT_SYMBOL_GPL(hetero_pwm_submit);
+
+const struct hetero_rt_stats *hetero_rt_stats(void)
+{
+    return (const struct hetero_rt_stats *)(hdev->shared_mem + HETERO_SHM_RT_OFFSET);
+}
+EXPORT_SYMBOL_GPL(hetero_rt_stats);
+
+/* 改变电平不会产生边沿, 先改极性再打开路由即可; 撤销路由时清除残留的挂起位 */
+int hetero_irq_route(int src, unsigned int flags)
+{
+    u32 bit = 1 << src;
+    unsigned long irqflags;
+
+    if (src < 0 || src >= IRQ_ROUTE_NUM_SOURCES ||
+        (flags & ~(HETERO_IRQ_ROUTE_RT | HETERO_IRQ_ROUTE_MAIN | HETERO_IRQ_ROUTE_FALLING)))
+        return -EINVAL;
+
+    spin_lock_irqsave(&hdev->route_lock, irqflags);
+    if (flags & HETERO_IRQ_ROUTE_FALLING)
+        hdev->regs->irq_route_polarity |= bit;
+    else
+        hdev->regs->irq_route_polarity &= ~bit;
+
+    if (flags & HETERO_IRQ_ROUTE_RT) {
+        hdev->regs->irq_route_rt |= bit;
+    } else {
+        hdev->regs->irq_route_rt &= ~bit;
+        hetero_reg_write(IRQ_ROUTE_RT_CLEAR_OFFSET, bit);
+    }
+
+    if (flags & HETERO_IRQ_ROUTE_MAIN) {
+        hdev->regs->irq_route_main |= bit;
+    } else {
+        hdev->regs->irq_route_main &= ~bit;
+        hetero_reg_write(IRQ_ROUTE_MAIN_CLEAR_OFFSET, bit);
+    }
+    spin_unlock_irqrestore(&hdev->route_lock, irqflags);
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_irq_route);
+
+int hetero_irq_route_register(int src, hetero_irq_route_fn fn, void *priv)
+{
+    unsigned long flags;
+    int ret = 0;
+
+    if (src < 0 || src >= IRQ_ROUTE_NUM_SOURCES || !fn)
+        return -EINVAL;
+    /* 旁路模式下主核IPI归用户态所有 */
+    if (bypass)
+        return -EBUSY;
+
+    spin_lock_irqsave(&hdev->route_lock, flags);
+    if (hdev->route[src].fn) {
+        ret = -EBUSY;
+    } else {
+        hdev->route[src].priv = priv;
+        hdev->route[src].fn = fn;
+    }
+    spin_unlock_irqrestore(&hdev->route_lock, flags);
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_irq_route_register);
+
+/* 分发在route_lock内进行, 返回后处理函数不会再被调用 */
+void hetero_irq_route_unregister(int src)
+{
+    unsigned long flags;
+
+    if (src < 0 || src >= IRQ_ROUTE_NUM_SOURCES)
+        return;
+
+    spin_lock_irqsave(&hdev->route_lock, flags);
+    hdev->route[src].fn = NULL;
+    hdev->route[src].priv = NULL;
+    spin_unlock_irqrestore(&hdev->route_lock, flags);
+}
+EXPORT_SYMBOL_GPL(hetero_irq_route_unregister);
+
+int hetero_register_handler(int core_id, u32 cmd, hetero_handler_t fn, void *priv)
+{
+    struct hetero_handler_entry *free_slot = NULL;
+    struct hetero_handler_entry *h;
+    unsigned long flags;
+    int ret = 0;
+    int i;
+    
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES || !fn)
+        return -EINVAL;
+    if (bypass)
+        return -EBUSY;
+    
+    spin_lock_irqsave(&hdev->rx_lock, flags);
+    for (i = 0; i < HETERO_MAX_HANDLERS; i++) {
+        h = &hdev->handlers[core_id][i];
+        if (h->fn && h->cmd == cmd) {
+            ret = -EBUSY;
+            goto out;
+        }
+        if (!h->fn && !free_slot)
+            free_slot = h;
+    }
+    
+    if (!free_slot) {
+        ret = -ENOSPC;
+        goto out;
+    }
+    
+    free_slot->cmd = cmd;
+    free_slot->priv = priv;
+    free_slot->fn = fn;
+out:
+    spin_unlock_irqrestore(&hdev->rx_lock, flags);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_register_handler);
+
+int hetero_unregister_handler(int core_id, u32 cmd)
+{
+    struct hetero_handler_entry *h;
+    unsigned long flags;
+    int ret = -ENOENT;
+    int i;
+    
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES)
+        return -EINVAL;
+    
+    /* 分发在rx_lock下进行, 返回后处理函数不会再被调用 */
+    spin_lock_irqsave(&hdev->rx_lock, flags);
+    for (i = 0; i < HETERO_MAX_HANDLERS; i++) {
+        h = &hdev->handlers[core_id][i];
+        if (h->fn && h->cmd == cmd) {
+            h->fn = NULL;
+            h->priv = NULL;
+            ret = 0;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&hdev->rx_lock, flags);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_unregister_handler);
+
+void hetero_call_init(struct hetero_call *call, int core_id)
+{
+    memset(call, 0, sizeof(*call));
+    call->core_id = core_id;
+    spin_lock_init(&call->lock);
+    init_waitqueue_head(&call->wq);
+}
+EXPORT_SYMBOL_GPL(hetero_call_init);
+
+/* 应答处理函数, 在主核IPI中断上下文中; 迟到的应答释放对应的缓冲区 */
+void hetero_call_handler(int core_id, const struct hetero_msg *msg, void *priv)
+{
+    struct hetero_call *call = priv;
+    int i;
+    
+    spin_lock(&call->lock);
+    for (i = 0; i < HETERO_CALL_STALE; i++) {
+        if (call->stale[i].buf && call->stale[i].seq == msg->seq) {
+            hetero_buf_free(call->stale[i].buf, call->stale[i].size);
+            call->stale[i].buf = NULL;
+        }
+    }
+    call->resp = *msg;
+    spin_unlock(&call->lock);
+    wake_up(&call->wq);
+}
+EXPORT_SYMBOL_GPL(hetero_call_handler);
+
+static bool hetero_call_match(struct hetero_call *call, u32 seq, struct hetero_msg *resp)
+{
+    unsigned long flags;
+    bool match;
+    
+    spin_lock_irqsave(&call->lock, flags);
+    match = call->resp.seq == seq;
+    if (match)
+        *resp = call->resp;
+    spin_unlock_irqrestore(&call->lock, flags);
+    
+    return match;
+}
+
+int hetero_call(struct hetero_call *call, struct hetero_msg *msg, struct hetero_msg *resp,
+                void *buf, size_t size, unsigned long timeout)
+{
+    unsigned long flags;
+    int ret, i = 0;
+    
+    ret = hetero_submit(call->core_id, msg, 0);
+    if (ret)
+        return ret;
+    
+    if (!wait_event_timeout(call->wq, hetero_call_match(call, msg->seq, resp), timeout)) {
+        /* 在锁内再查一次, 应答可能恰好在超时后到达 */
+        spin_lock_irqsave(&call->lock, flags);
+        ret = call->resp.seq == msg->seq ? 0 : -ETIMEDOUT;
+        if (!ret) {
+            *resp = call->resp;
+        } else if (buf) {
+            for (i = 0; i < HETERO_CALL_STALE && call->stale[i].buf; i++)
+                ;
+            if (i < HETERO_CALL_STALE) {
+                call->stale[i].buf = buf;
+                call->stale[i].size = size;
+                call->stale[i].seq = msg->seq;
+            }
+        }
+        spin_unlock_irqrestore(&call->lock, flags);
+        if (ret) {
+            if (buf && i == HETERO_CALL_STALE)
+                pr_warn_ratelimited("%s: 核%d应答超时, 缓冲区未释放\n",
+                                    DRIVER_NAME, call->core_id);
+            return ret;
+        }
+    }
+    
+    if (resp->cmd & HETERO_MSG_ERR)
+        return -(int)resp->arg0;
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_call);
+
+int hetero_call_stale(struct hetero_call *call)
+{
+    unsigned long flags;
+    int i, n = 0;
+    
+    spin_lock_irqsave(&call->lock, flags);
+    for (i = 0; i < HETERO_CALL_STALE; i++)
+        n += call->stale[i].buf != NULL;
+    spin_unlock_irqrestore(&call->lock, flags);
+    
+    return n;
+}
+EXPORT_SYMBOL_GPL(hetero_call_stale);
+
+int hetero_register_upcall(u32 cmd, hetero_upcall_fn fn, void *priv)
+{
+    struct hetero_upcall_entry *free_slot = NULL;
+    unsigned long flags;
+    int ret = 0;
+    int i;
+    
+    if (!fn)
+        return -EINVAL;
+    if (bypass)
+        return -EBUSY;
+    
+    spin_lock_irqsave(&hdev->upcall_lock, flags);
+    for (i = 0; i < HETERO_MAX_UPCALLS; i++) {
+        if (hdev->upcalls[i].fn && hdev->upcalls[i].cmd == cmd) {
+            ret = -EBUSY;
+            goto out;
+        }
+        if (!hdev->upcalls[i].fn && !free_slot)
+            free_slot = &hdev->upcalls[i];
+    }
+    
+    if (!free_slot) {
+        ret = -ENOSPC;
+        goto out;
+    }
+    
+    free_slot->cmd = cmd;
+    free_slot->priv = priv;
+    free_slot->fn = fn;
+out:
+    spin_unlock_irqrestore(&hdev->upcall_lock, flags);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_register_upcall);
+
+int hetero_unregister_upcall(u32 cmd)
+{
+    unsigned long flags;
+    int ret = -ENOENT;
+    int i;
+    
+    spin_lock_irqsave(&hdev->upcall_lock, flags);
+    for (i = 0; i < HETERO_MAX_UPCALLS; i++) {
+        if (hdev->upcalls[i].fn && hdev->upcalls[i].cmd == cmd) {
+            hdev->upcalls[i].fn = NULL;
+            hdev->upcalls[i].priv = NULL;
+            ret = 0;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&hdev->upcall_lock, flags);
+    
+    /* 等待正在执行的处理函数返回 */
+    if (!ret)
+        flush_work(&hdev->upcall_work);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_unregister_upcall);
+
+u32 hetero_buf_to_bus(const void *buf)
+{
+    return HETERO_SHM_BUS_BASE + (u32)((const u8 *)buf - (const u8 *)hdev->shared_mem);
+}
+EXPORT_SYMBOL_GPL(hetero_buf_to_bus);
+
+void *hetero_bus_to_buf(u32 bus_addr)
+{
+    if (bus_addr < HETERO_SHM_BUS_BASE ||
+        bus_addr >= HETERO_SHM_BUS_BASE + HETERO_SHM_SIZE)
+        return NULL;
+    
+    return hdev->shared_mem + (bus_addr - HETERO_SHM_BUS_BASE);
+}
+EXPORT_SYMBOL_GPL(hetero_bus_to_buf);
+
+/* genalloc无锁分配, 可在中断上下文使用 */
+void *hetero_buf_alloc(size_t size, u32 *bus_addr)
+{
+    unsigned long va;
+    
+    va = gen_pool_alloc(hdev->buf_pool, size);
+    if (!va)
+        return NULL;
+    
+    if (bus_addr)
+        *bus_addr = hetero_buf_to_bus((void *)va);
+    
+    return (void *)va;
+}
+EXPORT_SYMBOL_GPL(hetero_buf_alloc);
+
+void hetero_buf_free(void *buf, size_t size)
+{
+    if (buf)
+        gen_pool_free(hdev->buf_pool, (unsigned long)buf, size);
+}
+EXPORT_SYMBOL_GPL(hetero_buf_free);
+
+/* 缓冲池剩余字节数, 有碎片时不保证能一次分配这么多 */
+size_t hetero_buf_avail(void)
+{
+    return gen_pool_avail(hdev->buf_pool);
+}
+EXPORT_SYMBOL_GPL(hetero_buf_avail);
+
+/*
+ * 共享内存原子操作
+ * 硬件: 写Linux上下文(HETERO_AMO_CTX_LINUX)的operand/compare, 再读该上下文的别名
+ * 窗口; 各hart共用一个上下文, 两步之间持hetero_amo_lock. 这里模拟SRAM控制器,
+ * 同一把锁串行化读改写
+ */
+static DEFINE_SPINLOCK(hetero_amo_lock);
+
+static u32 *hetero_amo_word(u32 offset)
+{
+    if (WARN_ON_ONCE(offset % 4 || offset >= HETERO_AMO_SIZE))
+        return NULL;
+    return (u32 *)(hdev->shared_mem + offset);
+}
+
+u32 hetero_atomic_fetch_add(u32 offset, u32 val)
+{
+    u32 *p = hetero_amo_word(offset);
+    unsigned long flags;
+    u32 old;
+    
+    if (!p)
+        return 0;
+    
+    spin_lock_irqsave(&hetero_amo_lock, flags);
+    old = READ_ONCE(*p);
+    WRITE_ONCE(*p, old + val);
+    spin_unlock_irqrestore(&hetero_amo_lock, flags);
+    
+    return old;
+}
+EXPORT_SYMBOL_GPL(hetero_atomic_fetch_add);
+
+u32 hetero_atomic_xchg(u32 offset, u32 val)
+{
+    u32 *p = hetero_amo_word(offset);
+    unsigned long flags;
+    u32 old;
+    
+    if (!p)
+        return 0;
+    
+    spin_lock_irqsave(&hetero_amo_lock, flags);
+    old = READ_ONCE(*p);
+    WRITE_ONCE(*p, val);
+    spin_unlock_irqrestore(&hetero_amo_lock, flags);
+    
+    return old;
+}
+EXPORT_SYMBOL_GPL(hetero_atomic_xchg);
+
+u32 hetero_atomic_cmpxchg(u32 offset, u32 old, u32 new)
+{
+    u32 *p = hetero_amo_word(offset);
+    unsigned long flags;
+    u32 cur;
+    
+    if (!p)
+        return 0;
+    
+    spin_lock_irqsave(&hetero_amo_lock, flags);
+    cur = READ_ONCE(*p);
+    if (cur == old)
+        WRITE_ONCE(*p, new);
+    spin_unlock_irqrestore(&hetero_amo_lock, flags);
+    
+    return cur;
+}
+EXPORT_SYMBOL_GPL(hetero_atomic_cmpxchg);
+
+/* ---------------- 硬件同步块 ---------------- */
+
+/* 重新计算事件组条件, 返回由不满足变为满足时要触发的IPI位 (调用者持sync_lock) */
+static u32 hetero_evt_update(struct hetero_evt_group *evt)
+{
+    u32 hit = evt->flags & evt->mask;
+    bool match;
+    
+    if (!evt->mask)
+        match = false;
+    else if (evt->cfg & HETERO_EVT_ALL)
+        match = hit == evt->mask;
+    else
+        match = hit != 0;
+    
+    if (match == evt->match)
+        return 0;
+    evt->match = match;
+    
+    return match ? (evt->cfg & 0xFF) : 0;
+}
+
+/* 同步块的主核IPI: 在irq_work中进入中断处理函数 */
+static void hetero_sync_work(struct irq_work *work)
+{
+    struct hetero_device *dev = container_of(work, struct hetero_device, sync_work);
+    u32 harts;
+    
+    harts = atomic_xchg(&dev->sync_main_pending, 0);
+    if (harts)
+        hetero_sim_raise_harts(dev, harts);
+}
+
+/*
+ * 模拟同步块的IPI输出. 调用者可能就是持rx_lock的消息处理函数 (如在处理函数里
+ * post信号量或push句柄), 直接调用主核中断处理函数会在rx_lock上自锁; 硬件上
+ * IPI也要等调用者开中断后才进入, 所以主核部分推迟到irq_work
+ */
+static void hetero_sync_fire(struct hetero_device *dev, u32 targets)
+{
+    int core;
+    
+    for (core = 0; core < HETERO_NUM_SMALL_CORES; core++)
+        if (targets & (1 << core))
+            hetero_sim_deliver_ipi(dev, core);
+    
+    if (targets & HETERO_IPI_MAIN_MASK) {
+        atomic_or(targets & HETERO_IPI_MAIN_MASK, &dev->sync_main_pending);
+        irq_work_queue(&dev->sync_work);
+    }
+}
+
+int hetero_sem_init(int sem, u32 count)
+{
+    unsigned long flags;
+    
+    if (sem < 0 || sem >= HETERO_SYNC_NUM_SEMS)
+        return -EINVAL;
+    
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    hdev->sems[sem] = min_t(u32, count, U16_MAX);
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_sem_init);
+
+bool hetero_sem_take(int sem)
+{
+    unsigned long flags;
+    bool taken = false;
+    
+    if (sem < 0 || sem >= HETERO_SYNC_NUM_SEMS)
+        return false;
+    
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    if (hdev->sems[sem]) {
+        hdev->sems[sem]--;
+        taken = true;
+    }
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    return taken;
+}
+EXPORT_SYMBOL_GPL(hetero_sem_take);
+
+int hetero_sem_give(int sem, u32 count)
+{
+    unsigned long flags;
+    
+    if (sem < 0 || sem >= HETERO_SYNC_NUM_SEMS)
+        return -EINVAL;
+    
+    /* 硬件计数16位, 饱和 */
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    hdev->sems[sem] = min_t(u32, (u32)hdev->sems[sem] + min_t(u32, count, U16_MAX), U16_MAX);
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_sem_give);
+
+u32 hetero_evt_get(int group)
+{
+    if (group < 0 || group >= HETERO_SYNC_NUM_GROUPS)
+        return 0;
+    
+    return READ_ONCE(hdev->evts[group].flags);
+}
+EXPORT_SYMBOL_GPL(hetero_evt_get);
+
+int hetero_evt_set(int group, u32 bits)
+{
+    unsigned long flags;
+    u32 targets;
+    
+    if (group < 0 || group >= HETERO_SYNC_NUM_GROUPS)
+        return -EINVAL;
+    
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    hdev->evts[group].flags |= bits;
+    targets = hetero_evt_update(&hdev->evts[group]);
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    hetero_sync_fire(hdev, targets);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_evt_set);
+
+int hetero_evt_clear(int group, u32 bits)
+{
+    unsigned long flags;
+    
+    if (group < 0 || group >= HETERO_SYNC_NUM_GROUPS)
+        return -EINVAL;
+    
+    /* 清除只会让条件变为不满足, 不会触发 */
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    hdev->evts[group].flags &= ~bits;
+    hetero_evt_update(&hdev->evts[group]);
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_evt_clear);
+
+int hetero_evt_config(int group, u32 mask, u32 cfg)
+{
+    unsigned long flags;
+    u32 targets;
+    
+    if (group < 0 || group >= HETERO_SYNC_NUM_GROUPS)
+        return -EINVAL;
+    
+    spin_lock_irqsave(&hdev->sync_lock, flags);
+    hdev->evts[group].mask = mask;
+    hdev->evts[group].cfg = cfg & (HETERO_EVT_ALL | 0xFF);
+    targets = hetero_evt_update(&hdev->evts[group]);
+    spin_unlock_irqrestore(&hdev->sync_lock, flags);
+    
+    hetero_sync_fire(hdev, targets);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_evt_config);
+
+/* ---------------- 硬件句柄队列 ---------------- */
+
+/* 句柄数由低于阈值变为达到阈值时返回要触发的IPI位 (调用者持qm_lock) */
+static u32 hetero_qm_update(struct hetero_qm_queue *queue)
+{
+    bool above = queue->thresh && queue->head - queue->tail >= queue->thresh;
+    
+    if (above == queue->above)
+        return 0;
+    queue->above = above;
+    
+    return above ? (queue->cfg & 0xFF) : 0;
+}
+
+/* 可在消息处理函数 (持rx_lock) 中调用: 主核IPI经hetero_sync_fire推迟 */
+int hetero_qm_push(int q, u32 handle)
+{
+    struct hetero_qm_queue *queue;
+    unsigned long flags;
+    u32 targets = 0;
+    int ret = 0;
+    
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES)
+        return -EINVAL;
+    queue = &hdev->qm[q];
+    
+    spin_lock_irqsave(&hdev->qm_lock, flags);
+    if (queue->head - queue->tail >= HETERO_QM_DEPTH) {
+        queue->cfg |= HETERO_QM_CFG_OVERFLOW;
+        ret = -ENOSPC;
+    } else {
+        queue->slot[queue->head % HETERO_QM_DEPTH] = handle;
+        queue->head++;
+        targets = hetero_qm_update(queue);
+    }
+    spin_unlock_irqrestore(&hdev->qm_lock, flags);
+    
+    hetero_sync_fire(hdev, targets);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_qm_push);
+
+int hetero_qm_pop(int q, u32 *handle)
+{
+    struct hetero_qm_queue *queue;
+    unsigned long flags;
+    int ret = 0;
+    
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES)
+        return -EINVAL;
+    queue = &hdev->qm[q];
+    
+    spin_lock_irqsave(&hdev->qm_lock, flags);
+    if (queue->head == queue->tail) {
+        ret = -ENODATA;
+    } else {
+        *handle = queue->slot[queue->tail % HETERO_QM_DEPTH];
+        queue->tail++;
+        hetero_qm_update(queue);
+    }
+    spin_unlock_irqrestore(&hdev->qm_lock, flags);
+    
+    return ret;
+}
+EXPORT_SYMBOL_GPL(hetero_qm_pop);
+
+int hetero_qm_count(int q)
+{
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES)
+        return -EINVAL;
     
-    /* 邮箱寄存器 - Core 0 (IO核) */
-    volatile u32 mbox_main_to_core0_cmd;
-    volatile u32 mbox_main_to_core0_data;
-    volatile u32 mbox_core0_to_main_status;
-    volatile u32 mbox_core0_to_main_resp;
+    return READ_ONCE(hdev->qm[q].head) - READ_ONCE(hdev->qm[q].tail);
+}
+EXPORT_SYMBOL_GPL(hetero_qm_count);
+
+int hetero_qm_config(int q, u32 thresh, u32 ipi_bits)
+{
+    struct hetero_qm_queue *queue;
+    unsigned long flags;
+    u32 targets;
     
-    /* 邮箱寄存器 - Core 1 (RT核) */
-    volatile u32 mbox_main_to_core1_cmd;
-    volatile u32 mbox_main_to_core1_data;
-    volatile u32 mbox_core1_to_main_status;
-    volatile u32 mbox_core1_to_main_resp;
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES || thresh > HETERO_QM_DEPTH)
+        return -EINVAL;
+    queue = &hdev->qm[q];
     
-    /* 互斥锁寄存器 */
-    volatile u32 hw_mutex_request;
-    volatile u32 hw_mutex_status;
-    volatile u32 hw_mutex_release;
+    spin_lock_irqsave(&hdev->qm_lock, flags);
+    queue->thresh = thresh;
+    queue->cfg = (queue->cfg & HETERO_QM_CFG_OVERFLOW) | (ipi_bits & 0xFF);
+    targets = hetero_qm_update(queue);
+    spin_unlock_irqrestore(&hdev->qm_lock, flags);
     
-    /* 填充到4KB */
-    u8 padding[4096 - 0x4C];
-} __attribute__((packed));
+    hetero_sync_fire(hdev, targets);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(hetero_qm_config);
 
-struct hetero_device {
-    dev_t devno;
-    struct cdev cdev;
-    struct class *class;
-    struct device *device;
+int hetero_qm_pool_create(int q, size_t size, int count)
+{
+    struct hetero_qm_queue *queue;
+    void *buf;
+    u32 bus;
+    int i;
     
-    /* 内存映射 */
-    void *mem_base;              /* 整个映射区域基地址 */
-    struct hetero_hw_regs *regs; /* 寄存器区域 */
-    void *shared_mem;            /* 共享内存区域 */
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES || count <= 0 || count > HETERO_QM_DEPTH)
+        return -EINVAL;
+    queue = &hdev->qm[q];
     
-    /* 工作队列 - 模拟小核响应 */
-    struct work_struct core0_work;
-    struct work_struct core1_work;
+    if (queue->buf_count || queue->fn || hetero_qm_count(q))
+        return -EBUSY;
     
-    /* 统计 */
-    atomic_t ipi_count;
-    atomic_t msg_count;
-};
+    for (i = 0; i < count; i++) {
+        buf = hetero_buf_alloc(size, &bus);
+        if (!buf)
+            goto err;
+        hetero_qm_push(q, bus);
+    }
+    
+    queue->buf_size = size;
+    queue->buf_count = count;
+    return 0;
+    
+err:
+    while (!hetero_qm_pop(q, &bus))
+        hetero_buf_free(hetero_bus_to_buf(bus), size);
+    return -ENOMEM;
+}
+EXPORT_SYMBOL_GPL(hetero_qm_pool_create);
 
-static struct hetero_device *hdev;
+/* 调用前所有缓冲区都应已归还到队列 */
+void hetero_qm_pool_destroy(int q)
+{
+    struct hetero_qm_queue *queue;
+    int freed = 0;
+    u32 bus;
+    
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES)
+        return;
+    queue = &hdev->qm[q];
+    
+    while (!hetero_qm_pop(q, &bus)) {
+        hetero_buf_free(hetero_bus_to_buf(bus), queue->buf_size);
+        freed++;
+    }
+    
+    if (freed != queue->buf_count)
+        pr_warn("%s: 队列%d缓冲池销毁时有%d个缓冲区未归还\n",
+                DRIVER_NAME, q, queue->buf_count - freed);
+    
+    queue->buf_size = 0;
+    queue->buf_count = 0;
+}
+EXPORT_SYMBOL_GPL(hetero_qm_pool_destroy);
 
-/* 模拟IO核(Core 0)的响应 */
-static void core0_response_work(struct work_struct *work)
+void *hetero_qm_buf_get(int q, u32 *bus_addr)
 {
-    struct hetero_device *dev = container_of(work, struct hetero_device, core0_work);
-    u32 cmd, data;
+    u32 bus;
     
-    /* 读取邮箱命令 */
-    cmd = dev->regs->mbox_main_to_core0_cmd;
-    data = dev->regs->mbox_main_to_core0_data;
+    if (hetero_qm_pop(q, &bus))
+        return NULL;
     
-    if (cmd != 0) {
-        pr_info("%s: [IO Core] 收到命令: cmd=0x%04x, data=0x%08x\n", 
-                DRIVER_NAME, cmd, data);
-        
-        /* 模拟处理延迟 */
-        msleep(1);
-        
-        /* 发送响应 */
-        switch (cmd) {
-        case 0x0001:  /* PING命令 */
-            dev->regs->mbox_core0_to_main_resp = 0x8001;  /* PONG响应 */
-            break;
-        case 0x0010:  /* 读取状态 */
-            dev->regs->mbox_core0_to_main_resp = 0x8010 | (jiffies & 0xFF);
-            break;
-        default:
-            dev->regs->mbox_core0_to_main_resp = 0xFFFF;  /* 未知命令 */
-        }
-        
-        /* 清除命令，表示已处理 */
-        dev->regs->mbox_main_to_core0_cmd = 0;
+    if (bus_addr)
+        *bus_addr = bus;
+    return hetero_bus_to_buf(bus);
+}
+EXPORT_SYMBOL_GPL(hetero_qm_buf_get);
+
+int hetero_qm_buf_put(int q, void *buf)
+{
+    return hetero_qm_push(q, hetero_buf_to_bus(buf));
+}
+EXPORT_SYMBOL_GPL(hetero_qm_buf_put);
+
+/* 对注册了消费者的队列, 取出所有句柄交给消费者 */
+static void hetero_qm_work(struct work_struct *work)
+{
+    struct hetero_device *dev = container_of(work, struct hetero_device, qm_work);
+    hetero_qm_consumer_t fn;
+    unsigned long flags;
+    void *priv;
+    u32 handle;
+    int q;
+    
+    for (q = 0; q < HETERO_QM_NUM_QUEUES; q++) {
+        spin_lock_irqsave(&dev->qm_lock, flags);
+        fn = dev->qm[q].fn;
+        priv = dev->qm[q].priv;
+        spin_unlock_irqrestore(&dev->qm_lock, flags);
         
-        /* 设置状态位，通知主核 */
-        dev->regs->mbox_core0_to_main_status = 1;
+        if (!fn)
+            continue;
         
-        pr_info("%s: [IO Core] 发送响应: 0x%04x\n", 
-                DRIVER_NAME, dev->regs->mbox_core0_to_main_resp);
+        while (!hetero_qm_pop(q, &handle))
+            fn(q, handle, priv);
+    }
+}
+
+int hetero_qm_register_consumer(int q, hetero_qm_consumer_t fn, void *priv)
+{
+    unsigned long flags;
+    int ret = 0;
+    
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES || !fn)
+        return -EINVAL;
+    if (bypass)
+        return -EBUSY;
+    
+    spin_lock_irqsave(&hdev->qm_lock, flags);
+    if (hdev->qm[q].fn || hdev->qm[q].buf_count) {
+        ret = -EBUSY;
+    } else {
+        hdev->qm[q].priv = priv;
+        hdev->qm[q].fn = fn;
     }
+    spin_unlock_irqrestore(&hdev->qm_lock, flags);
     
-    /* 清除IPI */
-    dev->regs->ipi_status &= ~0x01;
+    if (ret)
+        return ret;
+    
+    /* 队列由空变为非空时通知主核, 已有的句柄马上处理 */
+    hetero_qm_config(q, 1, HETERO_IPI_MAIN_MASK);
+    schedule_work(&hdev->qm_work);
+    return 0;
 }
+EXPORT_SYMBOL_GPL(hetero_qm_register_consumer);
 
-/* 模拟RT核(Core 1)的响应 */
-static void core1_response_work(struct work_struct *work)
+void hetero_qm_unregister_consumer(int q)
 {
-    struct hetero_device *dev = container_of(work, struct hetero_device, core1_work);
+    unsigned long flags;
     
-    pr_info("%s: [RT Core] 收到IPI中断\n", DRIVER_NAME);
+    if (q < 0 || q >= HETERO_QM_NUM_QUEUES)
+        return;
     
-    /* RT核的快速响应 */
-    dev->regs->mbox_core1_to_main_resp = 0x5200 | (jiffies & 0xFF);
-    dev->regs->mbox_core1_to_main_status = 1;
+    hetero_qm_config(q, 0, 0);
     
-    /* 清除IPI */
-    dev->regs->ipi_status &= ~0x02;
+    spin_lock_irqsave(&hdev->qm_lock, flags);
+    hdev->qm[q].fn = NULL;
+    hdev->qm[q].priv = NULL;
+    spin_unlock_irqrestore(&hdev->qm_lock, flags);
+    
+    flush_work(&hdev->qm_work);
 }
+EXPORT_SYMBOL_GPL(hetero_qm_unregister_consumer);
 
 /* mmap实现 */
 static int hetero_mmap(struct file *file, struct vm_area_struct *vma)
@@ -174,17 +2205,28 @@ static int hetero_mmap(struct file *file, struct vm_area_struct *vma)
     pr_info("%s: mmap called, size=%lu, offset=%lu\n", 
             DRIVER_NAME, size, vma->vm_pgoff << PAGE_SHIFT);
     
-    /* 检查大小 */
-    if (size > TOTAL_SIZE) {
+    /* 检查大小: 偏移0为寄存器页, 偏移REG_SPACE_SIZE为共享内存 */
+    if ((vma->vm_pgoff << PAGE_SHIFT) + size > TOTAL_SIZE) {
         pr_err("%s: mmap size too large\n", DRIVER_NAME);
         return -EINVAL;
     }
     
-    /* 获取物理页帧号 */
-    pfn = virt_to_phys(dev->mem_base) >> PAGE_SHIFT;
+    /* 获取物理页帧号; 一致性模式下共享内存在保留区, 与寄存器页不连续 */
+    if (shm_coherent && (vma->vm_pgoff << PAGE_SHIFT) >= REG_SPACE_SIZE) {
+        pfn = (dev->shm_phys >> PAGE_SHIFT) + vma->vm_pgoff - (REG_SPACE_SIZE >> PAGE_SHIFT);
+    } else if (shm_coherent && (vma->vm_pgoff << PAGE_SHIFT) + size > REG_SPACE_SIZE) {
+        pr_err("%s: coherent shared memory must be mapped separately\n", DRIVER_NAME);
+        return -EINVAL;
+    } else {
+        pfn = (virt_to_phys(dev->mem_base) >> PAGE_SHIFT) + vma->vm_pgoff;
+    }
     
-    /* 设置不可缓存（重要！硬件寄存器必须这样） */
-    vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+    /*
+     * 设置不可缓存（重要！硬件寄存器必须这样）;
+     * 一致性共享内存只映射共享内存部分时保持可缓存
+     */
+    if (!shm_coherent || (vma->vm_pgoff << PAGE_SHIFT) < REG_SPACE_SIZE)
+        vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
     
     /* 映射 */
     ret = remap_pfn_range(vma, vma->vm_start, pfn, size, vma->vm_page_prot);
@@ -199,12 +2241,67 @@ static int hetero_mmap(struct file *file, struct vm_area_struct *vma)
     return 0;
 }
 
+/* 检查共享内存字是否满足等待条件 */
+static bool hetero_value_match(struct hetero_device *dev, struct hetero_wait_value *wv)
+{
+    u32 val;
+    
+    val = READ_ONCE(*(u32 *)(dev->shared_mem + wv->offset));
+    wv->cur_value = val;
+    val &= wv->mask;
+    
+    switch (wv->op) {
+    case HETERO_WAIT_EQ:
+        return val == wv->value;
+    case HETERO_WAIT_NE:
+        return val != wv->value;
+    case HETERO_WAIT_GE:
+        return val >= wv->value;
+    case HETERO_WAIT_LT:
+        return val < wv->value;
+    }
+    
+    return true;
+}
+
+static int hetero_wait_value(struct hetero_device *dev, struct hetero_wait_value *wv)
+{
+    long ret;
+    
+    if (wv->offset % 4 || wv->offset >= SHARED_MEM_SIZE || wv->op > HETERO_WAIT_LT)
+        return -EINVAL;
+    
+    if (wv->timeout_ms < 0) {
+        ret = wait_event_interruptible(dev->value_wq, hetero_value_match(dev, wv));
+    } else {
+        ret = wait_event_interruptible_timeout(dev->value_wq, hetero_value_match(dev, wv),
+                                               msecs_to_jiffies(wv->timeout_ms));
+        if (ret > 0)
+            ret = 0;
+        else if (ret == 0)
+            ret = -ETIMEDOUT;
+    }
+    
+    return ret;
+}
+
 /* ioctl实现 */
 static long hetero_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
     struct hetero_device *dev = file->private_data;
     struct hetero_info info;
-    int core_id;
+    struct hetero_upcall uc;
+    struct hetero_wait_value wv;
+    struct hetero_timed_msg tm;
+    struct hetero_time_sync sync;
+    struct hetero_rt_config rtc;
+    struct hetero_pwm_batch pb;
+    struct hetero_pwm_frame *frames;
+    struct eventfd_ctx *ctx, *old;
+    unsigned long flags;
+    int core_id, efd;
+    u32 ipi_mask;
+    u64 cycles;
     int ret = 0;
     
     switch (cmd) {
@@ -225,17 +2322,128 @@ static long hetero_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             
         pr_info("%s: 发送IPI到核心%d\n", DRIVER_NAME, core_id);
         
-        /* 设置IPI触发寄存器 */
-        dev->regs->ipi_trigger = (1 << core_id);
-        dev->regs->ipi_status |= (1 << core_id);
-        atomic_inc(&dev->ipi_count);
+        ret = hetero_send_ipi(dev, core_id);
+        break;
+        
+    case HETERO_IOC_SET_EVENTFD:
+        if (!bypass)
+            return -EINVAL;
+        if (copy_from_user(&efd, (void __user *)arg, sizeof(int)))
+            return -EFAULT;
+        
+        ctx = NULL;
+        if (efd >= 0) {
+            ctx = eventfd_ctx_fdget(efd);
+            if (IS_ERR(ctx))
+                return PTR_ERR(ctx);
+        }
+        
+        spin_lock_irqsave(&dev->bypass_lock, flags);
+        old = dev->bypass_eventfd;
+        dev->bypass_eventfd = ctx;
+        spin_unlock_irqrestore(&dev->bypass_lock, flags);
+        
+        if (old)
+            eventfd_ctx_put(old);
+        break;
+        
+    case HETERO_IOC_SEND_IPI_MASK:
+        if (copy_from_user(&ipi_mask, (void __user *)arg, sizeof(ipi_mask)))
+            return -EFAULT;
+        
+        ret = hetero_send_ipi_mask(dev, ipi_mask);
+        break;
+        
+    case HETERO_IOC_SUBMIT_AT:
+        if (copy_from_user(&tm, (void __user *)arg, sizeof(tm)))
+            return -EFAULT;
+        
+        ret = hetero_submit_at(tm.core_id, &tm.msg, tm.when);
+        if (ret < 0)
+            break;
+        
+        tm.slot = ret;
+        ret = 0;
+        if (copy_to_user((void __user *)arg, &tm, sizeof(tm)))
+            return -EFAULT;
+        break;
+        
+    case HETERO_IOC_RT_CONFIG:
+        if (copy_from_user(&rtc, (void __user *)arg, sizeof(rtc)))
+            return -EFAULT;
+        
+        ret = hetero_rt_config(rtc.cmd, rtc.arg0, rtc.arg1);
+        break;
+        
+    case HETERO_IOC_PWM_SUBMIT:
+        if (copy_from_user(&pb, (void __user *)arg, sizeof(pb)))
+            return -EFAULT;
+        if (!pb.count || pb.count > HETERO_PWM_QUEUE_LEN)
+            return -EINVAL;
+        
+        frames = memdup_user(u64_to_user_ptr(pb.frames), pb.count * sizeof(*frames));
+        if (IS_ERR(frames))
+            return PTR_ERR(frames);
+        ret = hetero_pwm_submit(frames, pb.count, pb.flags);
+        kfree(frames);
+        break;
+        
+    case HETERO_IOC_GET_CYCLES:
+        cycles = hetero_read_cycles();
+        if (copy_to_user((void __user *)arg, &cycles, sizeof(cycles)))
+            return -EFAULT;
+        break;
+        
+    case HETERO_IOC_TIME_SYNC:
+        hetero_time_sync(&sync);
+        if (copy_to_user((void __user *)arg, &sync, sizeof(sync)))
+            return -EFAULT;
+        break;
+        
+    case HETERO_IOC_WAIT_VALUE:
+        if (copy_from_user(&wv, (void __user *)arg, sizeof(wv)))
+            return -EFAULT;
+        
+        ret = hetero_wait_value(dev, &wv);
+        
+        /* 超时/被信号打断时也带回当前值 */
+        if (copy_to_user((void __user *)arg, &wv, sizeof(wv)))
+            return -EFAULT;
+        break;
+        
+    case HETERO_IOC_UPCALL_GET:
+        if (bypass)
+            return -EBUSY;
         
-        /* 调度工作队列模拟小核响应 */
-        if (core_id == 0) {
-            schedule_work(&dev->core0_work);
-        } else if (core_id == 1) {
-            schedule_work(&dev->core1_work);
+        /* 等待交给用户态的上调用请求 */
+        while (!kfifo_out_spinlocked(&dev->user_upcalls, &uc, 1,
+                                     &dev->user_upcall_lock)) {
+            if (file->f_flags & O_NONBLOCK)
+                return -EAGAIN;
+            if (wait_event_interruptible(dev->upcall_wq,
+                                         !kfifo_is_empty(&dev->user_upcalls)))
+                return -ERESTARTSYS;
         }
+        
+        if (copy_to_user((void __user *)arg, &uc, sizeof(uc)))
+            return -EFAULT;
+        break;
+        
+    case HETERO_IOC_UPCALL_REPLY:
+        if (bypass)
+            return -EBUSY;
+        if (copy_from_user(&uc, (void __user *)arg, sizeof(uc)))
+            return -EFAULT;
+        if (uc.core_id < 0 || uc.core_id >= HETERO_NUM_SMALL_CORES)
+            return -EINVAL;
+        
+        if (!uc.msg.seq)
+            break;
+        
+        uc.msg.cmd |= HETERO_MSG_RESP;
+        ret = hetero_upcall_reply(dev, uc.core_id, &uc.msg);
+        if (!ret)
+            ret = hetero_send_ipi(dev, uc.core_id);
         break;
         
     case HETERO_IOC_RESET:
@@ -260,6 +2468,82 @@ static int hetero_open(struct inode *inode, struct file *file)
     return 0;
 }
 
+/* 旁路模式: 读出上次read()之后的主核IPI次数 (u32), 没有中断时阻塞 */
+static ssize_t hetero_read(struct file *file, char __user *buf,
+                           size_t count, loff_t *ppos)
+{
+    struct hetero_device *dev = file->private_data;
+    u32 events;
+    
+    if (!bypass)
+        return -EINVAL;
+    if (count != sizeof(u32))
+        return -EINVAL;
+    
+    while (!(events = atomic_xchg(&dev->bypass_events, 0))) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->bypass_wq,
+                                     atomic_read(&dev->bypass_events)))
+            return -ERESTARTSYS;
+    }
+    
+    if (copy_to_user(buf, &events, sizeof(events)))
+        return -EFAULT;
+    
+    return sizeof(events);
+}
+
+/*
+ * 旁路模式: 写u32控制主核IPI, 1 = 重新使能 (用户态应先清除IPI状态), 0 = 屏蔽
+ */
+static ssize_t hetero_write(struct file *file, const char __user *buf,
+                            size_t count, loff_t *ppos)
+{
+    struct hetero_device *dev = file->private_data;
+    unsigned long flags;
+    u32 on;
+    
+    if (!bypass)
+        return -EINVAL;
+    if (count != sizeof(u32))
+        return -EINVAL;
+    if (copy_from_user(&on, buf, sizeof(on)))
+        return -EFAULT;
+    
+    local_irq_save(flags);
+    if (on) {
+        dev->regs->ipi_enable |= HETERO_IPI_MAIN_MASK;
+        /* 电平中断: 状态位仍置位时立即再次触发 */
+        hetero_main_ipi_irq(0, dev);
+    } else {
+        dev->regs->ipi_enable &= ~HETERO_IPI_MAIN_MASK;
+    }
+    local_irq_restore(flags);
+    
+    return sizeof(on);
+}
+
+/* 有等待用户态处理的上调用(旁路模式: 有未读的中断)时可读 */
+static __poll_t hetero_poll(struct file *file, poll_table *wait)
+{
+    struct hetero_device *dev = file->private_data;
+    __poll_t mask = 0;
+    
+    if (bypass) {
+        poll_wait(file, &dev->bypass_wq, wait);
+        if (atomic_read(&dev->bypass_events))
+            mask |= EPOLLIN | EPOLLRDNORM;
+        return mask;
+    }
+    
+    poll_wait(file, &dev->upcall_wq, wait);
+    if (!kfifo_is_empty(&dev->user_upcalls))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    
+    return mask;
+}
+
 static int hetero_release(struct inode *inode, struct file *file)
 {
     pr_info("%s: device closed\n", DRIVER_NAME);
@@ -270,13 +2554,47 @@ static struct file_operations hetero_fops = {
     .owner = THIS_MODULE,
     .open = hetero_open,
     .release = hetero_release,
+    .read = hetero_read,
+    .write = hetero_write,
     .mmap = hetero_mmap,
     .unlocked_ioctl = hetero_ioctl,
+    .poll = hetero_poll,
 };
 
+/* 一致性模式: 映射设备树reserved-memory里的"hetero-shm", 代替模拟的共享内存 */
+static int hetero_map_coherent_shm(struct hetero_device *dev)
+{
+    struct reserved_mem *rmem;
+    struct device_node *np;
+    
+    np = of_find_node_by_name(NULL, "hetero-shm");
+    if (!np) {
+        pr_err("%s: shm_coherent需要reserved-memory节点hetero-shm\n", DRIVER_NAME);
+        return -ENODEV;
+    }
+    rmem = of_reserved_mem_lookup(np);
+    of_node_put(np);
+    if (!rmem || rmem->size < SHARED_MEM_SIZE) {
+        pr_err("%s: 保留区hetero-shm无效\n", DRIVER_NAME);
+        return -EINVAL;
+    }
+    
+    /* 保留区是no-map的主存, 经一致性DMA口与小核共享, 按可缓存方式映射 */
+    dev->shared_mem = memremap(rmem->base, SHARED_MEM_SIZE, MEMREMAP_WB);
+    if (!dev->shared_mem)
+        return -ENOMEM;
+    dev->shm_phys = rmem->base;
+    memset(dev->shared_mem, 0, SHARED_MEM_SIZE);
+    
+    pr_info("%s: 一致性共享内存 phys=%pa\n", DRIVER_NAME, &dev->shm_phys);
+    return 0;
+}
+
 static int __init hetero_init(void)
 {
+    struct hetero_timed_slot *ts;
     int ret;
+    int i;
     
     pr_info("%s: Loading driver with hardware register simulation\n", DRIVER_NAME);
     
@@ -296,13 +2614,25 @@ static int __init hetero_init(void)
     /* 设置指针 */
     hdev->regs = (struct hetero_hw_regs *)hdev->mem_base;
     hdev->shared_mem = hdev->mem_base + REG_SPACE_SIZE;
+    hdev->shm_phys = virt_to_phys(hdev->shared_mem);
     
     /* 初始化内存 */
     memset(hdev->mem_base, 0, TOTAL_SIZE);
     
+    if (shm_coherent) {
+        ret = hetero_map_coherent_shm(hdev);
+        if (ret) {
+            kfree(hdev->mem_base);
+            kfree(hdev);
+            return ret;
+        }
+    }
+    
     /* 初始化寄存器默认值 */
-    hdev->regs->ipi_enable = 0x03;  /* 启用Core0和Core1的IPI */
+    hdev->regs->ipi_enable = HETERO_IPI_ALL_MASK;  /* 启用小核和所有Linux hart的IPI */
     hdev->regs->hw_mutex_status = 0xFFFF;  /* 所有锁都可用 */
+    hdev->regs->bus_qos_ctrl = 1;
+    hdev->regs->l2_ctrl = L2_CTRL_PARTITION;
 
     pr_info("%s: Debug - After init:\n", DRIVER_NAME);
     pr_info("  hw_mutex_status value: 0x%04x\n", hdev->regs->hw_mutex_status);
@@ -316,9 +2646,74 @@ static int __init hetero_init(void)
     INIT_WORK(&hdev->core0_work, core0_response_work);
     INIT_WORK(&hdev->core1_work, core1_response_work);
     
+    /* 初始化消息环锁 */
+    spin_lock_init(&hdev->tx_lock[0]);
+    spin_lock_init(&hdev->tx_lock[1]);
+    spin_lock_init(&hdev->rx_lock);
+    
+    /* 初始化上调用 */
+    INIT_WORK(&hdev->upcall_work, hetero_upcall_work);
+    spin_lock_init(&hdev->upcall_lock);
+    spin_lock_init(&hdev->reply_lock[0]);
+    spin_lock_init(&hdev->reply_lock[1]);
+    spin_lock_init(&hdev->user_upcall_lock);
+    INIT_KFIFO(hdev->user_upcalls);
+    init_waitqueue_head(&hdev->upcall_wq);
+    
+    /* 共享内存缓冲池, 64字节粒度 */
+    hdev->buf_pool = gen_pool_create(6, -1);
+    if (!hdev->buf_pool) {
+        ret = -ENOMEM;
+        goto err_shm;
+    }
+    ret = gen_pool_add_virt(hdev->buf_pool,
+                            (unsigned long)(hdev->shared_mem + HETERO_SHM_POOL_OFFSET),
+                            hdev->shm_phys + HETERO_SHM_POOL_OFFSET,
+                            HETERO_SHM_POOL_SIZE, -1);
+    if (ret)
+        goto err_pool;
+    
     /* 初始化计数器 */
     atomic_set(&hdev->ipi_count, 0);
     atomic_set(&hdev->msg_count, 0);
+    atomic_set(&hdev->msg_dropped, 0);
+    atomic_set(&hdev->upcall_count, 0);
+    
+    /* 旁路模式 */
+    spin_lock_init(&hdev->bypass_lock);
+    init_waitqueue_head(&hdev->bypass_wq);
+    init_waitqueue_head(&hdev->value_wq);
+    spin_lock_init(&hdev->sync_lock);
+    atomic_set(&hdev->sync_main_pending, 0);
+    init_irq_work(&hdev->sync_work, hetero_sync_work);
+    spin_lock_init(&hdev->qm_lock);
+    INIT_WORK(&hdev->qm_work, hetero_qm_work);
+    spin_lock_init(&hdev->tmbox_lock);
+    spin_lock_init(&hdev->route_lock);
+    mutex_init(&hdev->rt_cfg_lock);
+    hetero_call_init(&hdev->rt_call, HETERO_CORE_RT);
+    for (i = 0; i < HETERO_NUM_SMALL_CORES * HETERO_TMBOX_SLOTS; i++) {
+        ts = &hdev->tmbox[i / HETERO_TMBOX_SLOTS][i % HETERO_TMBOX_SLOTS];
+        ts->core = i / HETERO_TMBOX_SLOTS;
+        hrtimer_init(&ts->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        ts->timer.function = hetero_tmbox_fire;
+    }
+    atomic_set(&hdev->bypass_events, 0);
+    INIT_DELAYED_WORK(&hdev->doorbell_work, hetero_sim_doorbell_work);
+    
+    if (bypass) {
+        pr_info("%s: 旁路模式, 消息环和上调用由用户态处理\n", DRIVER_NAME);
+        schedule_delayed_work(&hdev->doorbell_work, 1);
+    } else {
+        /* 注册内置上调用 */
+        hetero_register_upcall(HETERO_UPCALL_BUF_ALLOC, hetero_upcall_builtin, NULL);
+        hetero_register_upcall(HETERO_UPCALL_BUF_FREE, hetero_upcall_builtin, NULL);
+        hetero_register_upcall(HETERO_UPCALL_LOG, hetero_upcall_builtin, NULL);
+        hetero_register_upcall(HETERO_UPCALL_RT_OVERRUN, hetero_upcall_builtin, NULL);
+        for (i = HETERO_MSG_RT_POLICY; i <= HETERO_MSG_RT_PWM_BATCH; i++)
+            hetero_register_handler(HETERO_CORE_RT, i | HETERO_MSG_RESP,
+                                    hetero_call_handler, &hdev->rt_call);
+    }
     
     pr_info("%s: Memory layout:\n", DRIVER_NAME);
     pr_info("  Registers: %p (0x000-0xFFF)\n", hdev->regs);
@@ -328,7 +2723,7 @@ static int __init hetero_init(void)
     ret = alloc_chrdev_region(&hdev->devno, 0, 1, DEVICE_NAME);
     if (ret < 0) {
         pr_err("%s: alloc_chrdev_region failed\n", DRIVER_NAME);
-        goto err_free;
+        goto err_pool;
     }
     
     cdev_init(&hdev->cdev, &hetero_fops);
@@ -353,6 +2748,12 @@ static int __init hetero_init(void)
         goto err_class;
     }
     
+    /* 全局时基作为clocksource, 注册失败不影响其他功能 */
+    if (clocksource_register_hz(&hetero_clocksource, HETERO_TIMEBASE_HZ))
+        pr_warn("%s: clocksource注册失败\n", DRIVER_NAME);
+    else
+        hdev->cs_registered = true;
+    
     pr_info("%s: Driver loaded successfully! Device at /dev/%s\n", 
             DRIVER_NAME, DEVICE_NAME);
     
@@ -364,7 +2765,11 @@ err_cdev:
     cdev_del(&hdev->cdev);
 err_unreg:
     unregister_chrdev_region(hdev->devno, 1);
-err_free:
+err_pool:
+    gen_pool_destroy(hdev->buf_pool);
+err_shm:
+    if (shm_coherent)
+        memunmap(hdev->shared_mem);
     kfree(hdev->mem_base);
     kfree(hdev);
     return ret;
@@ -372,11 +2777,24 @@ err_free:
 
 static void __exit hetero_exit(void)
 {
+    int i;
+    
     pr_info("%s: Unloading driver\n", DRIVER_NAME);
     
+    if (hdev->cs_registered)
+        clocksource_unregister(&hetero_clocksource);
+    
+    /* 先停门铃轮询和定时邮箱, 它们会调度小核工作队列 */
+    cancel_delayed_work_sync(&hdev->doorbell_work);
+    for (i = 0; i < HETERO_NUM_SMALL_CORES * HETERO_TMBOX_SLOTS; i++)
+        hrtimer_cancel(&hdev->tmbox[i / HETERO_TMBOX_SLOTS][i % HETERO_TMBOX_SLOTS].timer);
+    
     /* 取消工作队列 */
     cancel_work_sync(&hdev->core0_work);
     cancel_work_sync(&hdev->core1_work);
+    cancel_work_sync(&hdev->upcall_work);
+    irq_work_sync(&hdev->sync_work);
+    cancel_work_sync(&hdev->qm_work);
     
     device_destroy(hdev->class, hdev->devno);
     class_destroy(hdev->class);
@@ -387,7 +2805,27 @@ static void __exit hetero_exit(void)
     pr_info("%s: Statistics:\n", DRIVER_NAME);
     pr_info("  IPI count: %d\n", atomic_read(&hdev->ipi_count));
     pr_info("  Message count: %d\n", atomic_read(&hdev->msg_count));
+    pr_info("  Dropped messages: %d\n", atomic_read(&hdev->msg_dropped));
+    pr_info("  Upcall count: %d\n", atomic_read(&hdev->upcall_count));
+    
+    if (hdev->bypass_eventfd)
+        eventfd_ctx_put(hdev->bypass_eventfd);
+    
+    /* 小核没有释放的缓冲区, 否则gen_pool_destroy会BUG */
+    for (i = 0; i < HETERO_UPCALL_BUFS; i++) {
+        if (hdev->upcall_bufs[i].size)
+            hetero_buf_free(hetero_bus_to_buf(hdev->upcall_bufs[i].bus),
+                            hdev->upcall_bufs[i].size);
+    }
     
+    /* 应答超时留下的缓冲区还在池里时gen_pool_destroy会BUG, 只能连池一起泄漏 */
+    if (gen_pool_avail(hdev->buf_pool) == gen_pool_size(hdev->buf_pool))
+        gen_pool_destroy(hdev->buf_pool);
+    else
+        pr_warn("%s: 缓冲池还有%zu字节未释放\n", DRIVER_NAME,
+                gen_pool_size(hdev->buf_pool) - gen_pool_avail(hdev->buf_pool));
+    if (shm_coherent)
+        memunmap(hdev->shared_mem);
     kfree(hdev->mem_base);
     kfree(hdev);
 }
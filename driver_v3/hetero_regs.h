@@ -0,0 +1,615 @@
+/* hetero_regs.h - hetero_regs 模块导出给其他内核驱动的接口 */
+
+#ifndef _HETERO_REGS_H
+#define _HETERO_REGS_H
+
+#include <linux/types.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+/* 小核编号 */
+#define HETERO_CORE_IO          0
+#define HETERO_CORE_RT          1
+#define HETERO_NUM_SMALL_CORES  2
+
+/*
+ * IPI位分配 (ipi_trigger一次写可同时触发多个核):
+ *   bit0 -> IO核, bit1 -> RT核, bit2-5 -> Linux hart0-3
+ * 小核通知Linux默认用hart0的位 (HETERO_IPI_MAIN_BIT)
+ */
+#define HETERO_IPI_CORE_BIT(n)  (n)
+#define HETERO_IPI_HART_BIT(h)  (2 + (h))
+#define HETERO_NUM_HARTS        4
+#define HETERO_IPI_MAIN_BIT     HETERO_IPI_HART_BIT(0)
+#define HETERO_IPI_SMALL_MASK   0x03
+#define HETERO_IPI_MAIN_MASK    0x3C     /* 全部Linux hart */
+#define HETERO_IPI_ALL_MASK     (HETERO_IPI_SMALL_MASK | HETERO_IPI_MAIN_MASK)
+
+/* 寄存器偏移量（基于你的真实硬件设计） */
+#define IPI_STATUS_OFFSET    0x00   /* @ 0xf0002000 */
+#define IPI_TRIGGER_OFFSET   0x04   /* @ 0xf0002004 */
+#define IPI_CLEAR_OFFSET     0x08   /* @ 0xf0002008 */
+#define IPI_ENABLE_OFFSET    0x0C   /* @ 0xf000200c */
+
+#define MBOX_MAIN_TO_CORE0_CMD_OFFSET   0x10  /* @ 0xf0002010 */
+#define MBOX_MAIN_TO_CORE0_DATA_OFFSET  0x14  /* @ 0xf0002014 */
+#define MBOX_CORE0_TO_MAIN_STATUS_OFFSET 0x18 /* @ 0xf0002018 */
+#define MBOX_CORE0_TO_MAIN_RESP_OFFSET  0x1C  /* @ 0xf000201c */
+
+#define MBOX_MAIN_TO_CORE1_CMD_OFFSET   0x20  /* @ 0xf0002020 */
+#define MBOX_MAIN_TO_CORE1_DATA_OFFSET  0x24  /* @ 0xf0002024 */
+#define MBOX_CORE1_TO_MAIN_STATUS_OFFSET 0x28 /* @ 0xf0002028 */
+#define MBOX_CORE1_TO_MAIN_RESP_OFFSET  0x2C  /* @ 0xf000202c */
+
+#define HW_MUTEX_REQUEST_OFFSET  0x30  /* @ 0xf0002040 */
+#define HW_MUTEX_STATUS_OFFSET   0x34  /* @ 0xf0002044 */
+#define HW_MUTEX_RELEASE_OFFSET  0x38  /* @ 0xf0002048 */
+
+#define SMALL_CORE_RESET_OFFSET  0x3C  /* @ 0xf000204c */
+
+/* 全局时基 (64位, 高字在前), 按 高-低-高 读取 */
+#define GLOBAL_TIME_HI_OFFSET    0x40
+#define GLOBAL_TIME_LO_OFFSET    0x44
+
+/*
+ * 邮箱时间戳 (时基低32位), 每个小核0x10:
+ *   SEND 主核写入命令, TAKE 小核取走命令, RESP 小核写入响应, ACK 主核确认响应
+ */
+#define MBOX_TS_SEND_OFFSET(n)   (0x48 + (n) * 0x10)
+#define MBOX_TS_TAKE_OFFSET(n)   (0x4C + (n) * 0x10)
+#define MBOX_TS_RESP_OFFSET(n)   (0x50 + (n) * 0x10)
+#define MBOX_TS_ACK_OFFSET(n)    (0x54 + (n) * 0x10)
+
+/*
+ * 小核总线统计 (自由运行, 取两次读数之差): WAIT 等待ack的周期数, XFER 完成的传输数,
+ * ibus和dbus合计. BUS_QOS_CTRL bit0 = RT核主设备固定最高优先级 (make.py --bus-qos rt)
+ */
+#define BUS_WAIT_OFFSET(n)       (0x68 + (n) * 8)
+#define BUS_XFER_OFFSET(n)       (0x6C + (n) * 8)
+#define BUS_QOS_CTRL_OFFSET      0x78
+
+/*
+ * L2分区 (有l2_size的板卡): L2_CTRL bit0 = RT核独占最后一路 (make.py --l2-partition rt),
+ * bit1/2/3 = IO核/RT核/Linux旁路, 未命中不分配 (make.py --l2-bypass).
+ * 命中/未命中计数自由运行, n = 0 IO核, 1 RT核, 2 Linux (含其余DMA主设备)
+ */
+#define L2_CTRL_OFFSET           0x7C
+#define L2_HIT_OFFSET(n)         (0x80 + (n) * 8)
+#define L2_MISS_OFFSET(n)        (0x84 + (n) * 8)
+#define L2_NUM_SOURCES           3
+
+#define L2_CTRL_PARTITION        (1 << 0)
+#define L2_CTRL_BYPASS(n)        (1 << (1 + (n)))
+
+/*
+ * 中断路由矩阵 (见soc_linux.py IrqRouter), 源号为构建生成的常量IRQ_ROUTE_<名字>
+ * (timer0, switch0...). 源n按POLARITY的边沿锁存: RT位内的锁存到RT_PENDING,
+ * 直接接RT核 externalInterruptArray[1+n]; MAIN位内的锁存到MAIN_PENDING并置位
+ * hart0的IPI. 两个挂起寄存器写1清除, STAMP为最近一次锁存时的时基低32位
+ */
+#define IRQ_ROUTE_RAW_OFFSET          0x98
+#define IRQ_ROUTE_POLARITY_OFFSET     0x9C   /* 1 = 下降沿 */
+#define IRQ_ROUTE_RT_OFFSET           0xA0
+#define IRQ_ROUTE_RT_PENDING_OFFSET   0xA4
+#define IRQ_ROUTE_RT_CLEAR_OFFSET     0xA8
+#define IRQ_ROUTE_MAIN_OFFSET         0xAC
+#define IRQ_ROUTE_MAIN_PENDING_OFFSET 0xB0
+#define IRQ_ROUTE_MAIN_CLEAR_OFFSET   0xB4
+#define IRQ_ROUTE_STAMP_OFFSET        0xB8
+#define IRQ_ROUTE_NUM_SOURCES         16
+
+/* 邮箱响应确认 (mbox_core{n}_to_main_ctrl): 写bit0清除STATUS中的响应挂起 */
+#define MBOX_CORE0_TO_MAIN_CTRL_OFFSET 0xBC
+#define MBOX_CORE1_TO_MAIN_CTRL_OFFSET 0xC0
+#define MBOX_CTRL_ACK                  (1 << 0)
+
+/* 邮箱寄存器按小核编号索引 (每个小核0x10) */
+#define MBOX_MAIN_TO_CORE_CMD_OFFSET(n)    (MBOX_MAIN_TO_CORE0_CMD_OFFSET + (n) * 0x10)
+#define MBOX_MAIN_TO_CORE_DATA_OFFSET(n)   (MBOX_MAIN_TO_CORE0_DATA_OFFSET + (n) * 0x10)
+#define MBOX_CORE_TO_MAIN_STATUS_OFFSET(n) (MBOX_CORE0_TO_MAIN_STATUS_OFFSET + (n) * 0x10)
+#define MBOX_CORE_TO_MAIN_RESP_OFFSET(n)   (MBOX_CORE0_TO_MAIN_RESP_OFFSET + (n) * 0x10)
+#define MBOX_CORE_TO_MAIN_CTRL_OFFSET(n)   (MBOX_CORE0_TO_MAIN_CTRL_OFFSET + (n) * 4)
+
+/*
+ * 共享内存 (32KB @ 0x80100000, 小核看到的总线地址)
+ * 一致性模式下实际位于主存保留区 "hetero-shm" (常量SHARED_MEM_PHYS), 地址不变
+ */
+#define HETERO_SHM_BUS_BASE     0x80100000
+#define HETERO_SHM_SIZE         (32*1024)
+
+/* 共享内存布局 */
+#define HETERO_SHM_INFO_OFFSET  0x0000   /* 系统标识字符串 */
+#define HETERO_SHM_RING_OFFSET  0x0100   /* 消息环 */
+#define HETERO_SHM_RING_SIZE    0x0B00
+#define HETERO_SHM_RT_OFFSET    0x0C00   /* RT执行器统计 (struct hetero_rt_stats) */
+#define HETERO_SHM_RT_SIZE      0x0400
+#define HETERO_SHM_POOL_OFFSET  0x1000   /* hetero_buf_alloc 缓冲池 */
+#define HETERO_SHM_POOL_SIZE    0x3000
+#define HETERO_SHM_VRING_OFFSET 0x4000   /* 高16KB: remoteproc vring */
+#define HETERO_SHM_VRING_SIZE   0x4000
+
+/* 原子操作窗口 (共享内存基址之后, 见soc_linux.py SharedSRAMAtomic)
+ * 别名地址 = 窗口 + ctx * HETERO_AMO_CTX_STRIDE + 偏移, 只覆盖共享内存低16KB */
+#define HETERO_AMO_CTX_OFFSET   0x08000  /* + ctx*8: operand, +4: compare */
+#define HETERO_AMO_ADD_OFFSET   0x10000
+#define HETERO_AMO_SWAP_OFFSET  0x20000
+#define HETERO_AMO_CAS_OFFSET   0x30000
+#define HETERO_AMO_CTX_STRIDE   0x4000
+#define HETERO_AMO_SIZE         0x4000
+#define HETERO_AMO_CTX_LINUX    0        /* Linux各hart共用, 1 IO核, 2 RT核 */
+
+/* 硬件同步块 (计数信号量 + 事件标志组, 见soc_linux.py HardwareSync) */
+#define HETERO_SYNC_BUS_BASE    0x80140000
+#define HETERO_SYNC_NUM_SEMS    64
+#define HETERO_SYNC_NUM_GROUPS  16
+#define HETERO_SYNC_SEM_TAKE_OFFSET(n)  (0x000 + (n) * 4)
+#define HETERO_SYNC_SEM_GIVE_OFFSET(n)  (0x400 + (n) * 4)
+#define HETERO_SYNC_EVT_SET_OFFSET(g)   (0x800 + (g) * 16)
+#define HETERO_SYNC_EVT_CLR_OFFSET(g)   (0x804 + (g) * 16)
+#define HETERO_SYNC_EVT_MASK_OFFSET(g)  (0x808 + (g) * 16)
+#define HETERO_SYNC_EVT_CFG_OFFSET(g)   (0x80C + (g) * 16)
+#define HETERO_EVT_ALL          0x100    /* EVT_CFG: 掩码内全部置位才触发 */
+
+/* 硬件句柄队列 (见soc_linux.py QueueManager) */
+#define HETERO_QM_BUS_BASE      0x80141000
+#define HETERO_QM_NUM_QUEUES    8
+#define HETERO_QM_DEPTH         64
+#define HETERO_QM_EMPTY         0xFFFFFFFF   /* 出队时队列为空 */
+#define HETERO_QM_DATA_OFFSET(q)    ((q) * 16)
+#define HETERO_QM_COUNT_OFFSET(q)   ((q) * 16 + 4)
+#define HETERO_QM_THRESH_OFFSET(q)  ((q) * 16 + 8)
+#define HETERO_QM_CFG_OFFSET(q)     ((q) * 16 + 12)
+#define HETERO_QM_CFG_OVERFLOW  0x100
+
+/* 小核定时器和定时投递邮箱 (见soc_linux.py CoreTimer/TimedMailbox) */
+#define HETERO_TIMEBASE_HZ      100000000    /* mtime频率 = sys_clk_freq */
+#define HETERO_TIMER_BUS_BASE   0x80142000
+#define HETERO_TMBOX_BUS_BASE   0x80143000
+#define HETERO_TMBOX_SLOTS      4            /* 每个小核 */
+#define HETERO_TMBOX_SLOT_OFFSET(core, s)  (((core) * HETERO_TMBOX_SLOTS + (s)) * 0x20)
+#define HETERO_TMBOX_TIME_LO    0x10         /* 槽内偏移, 0x00-0x0C为struct hetero_msg */
+#define HETERO_TMBOX_TIME_HI    0x14
+#define HETERO_TMBOX_CTRL       0x18
+#define HETERO_TMBOX_FIRED      0x1C
+#define HETERO_TMBOX_CTRL_ARM   0x1
+#define HETERO_TMBOX_CTRL_FREE  0x2
+
+/* 小核私有内存 small_core_N_mem (1MB, 复位向量即基址) */
+#define HETERO_CORE_MEM_BASE(core)  (0x80200000 + (core) * 0x100000)
+#define HETERO_CORE_MEM_SIZE        0x100000
+
+/*
+ * 消息环 (共享内存中, 每个小核两对)
+ *   TX环:    主核 -> 小核请求, 主核写head, 小核写tail
+ *   RX环:    小核 -> 主核响应
+ *   UP环:    小核 -> 主核的上调用请求
+ *   REPLY环: 主核 -> 小核的上调用应答
+ * 小核处理完一批消息后通过主核IPI通知, 主核写完应答后发IPI给小核
+ */
+#define HETERO_RING_SLOTS       16
+#define HETERO_MSG_RESP         0x8000   /* 响应cmd = 请求cmd | HETERO_MSG_RESP */
+#define HETERO_MSG_ERR          0x4000   /* 出错应答, arg0为正的errno */
+
+/* 广播给小核的配置更新: arg0=配置数据总线地址, arg1=配置代数 */
+#define HETERO_MSG_CFG_UPDATE   0x00C0
+
+struct hetero_msg {
+    u32 cmd;
+    u32 seq;
+    u32 arg0;
+    u32 arg1;
+};
+
+struct hetero_ring {
+    u32 head;
+    u32 tail;
+    u32 reserved[2];
+    struct hetero_msg slot[HETERO_RING_SLOTS];
+};
+
+/* 第n个小核的TX/RX环在共享内存中的偏移 */
+#define HETERO_RING_TX_OFFSET(n) \
+    (HETERO_SHM_RING_OFFSET + (n) * 2 * sizeof(struct hetero_ring))
+#define HETERO_RING_RX_OFFSET(n) \
+    (HETERO_RING_TX_OFFSET(n) + sizeof(struct hetero_ring))
+#define HETERO_RING_UP_OFFSET(n) \
+    (HETERO_RING_TX_OFFSET(HETERO_NUM_SMALL_CORES) + (n) * 2 * sizeof(struct hetero_ring))
+#define HETERO_RING_REPLY_OFFSET(n) \
+    (HETERO_RING_UP_OFFSET(n) + sizeof(struct hetero_ring))
+
+/* 内置上调用命令 (由hetero_regs自己处理) */
+#define HETERO_UPCALL_BUF_ALLOC 0x0101   /* arg0=大小, 应答arg0=总线地址 */
+#define HETERO_UPCALL_BUF_FREE  0x0102   /* arg0=总线地址, arg1=大小, 须与BUF_ALLOC一致 */
+#define HETERO_UPCALL_LOG       0x0103   /* arg0=字符串总线地址, arg1=长度 */
+#define HETERO_UPCALL_RT_OVERRUN 0x0104  /* arg0=任务号, arg1=响应时间(周期, 0=错过释放) */
+
+/* seq为0的上调用只是通知, 主核不回应答 */
+
+/*
+ * RT核执行器配置 (firmware/rt_core/rt_exec.h), 经hetero_rt_config发送
+ * 截止期等于周期; 作业之间不抢占
+ */
+#define HETERO_MSG_RT_POLICY    0x00D0   /* arg0 = HETERO_RT_POLICY_* */
+#define HETERO_MSG_RT_TASK_SET  0x00D1   /* arg0 = 任务号 | 优先级<<8 | 函数号<<16, arg1 = 周期(us) */
+#define HETERO_MSG_RT_TASK_ARG  0x00D2   /* arg0 = 任务号, arg1 = 任务函数参数 */
+#define HETERO_MSG_RT_START     0x00D3   /* arg0 = 任务位图 */
+#define HETERO_MSG_RT_STOP      0x00D4   /* arg0 = 任务位图 */
+#define HETERO_MSG_RT_BENCH     0x00D5   /* arg0 = struct hetero_rt_bench总线地址(0=停止), arg1 = 桶宽log2 */
+#define HETERO_MSG_RT_IRQ_BIND  0x00D6   /* arg0 = 中断源 | 任务号<<8, arg1 = 1绑定/0解绑; 任务须已停止 */
+#define HETERO_MSG_RT_LAST      HETERO_MSG_RT_IRQ_BIND   /* hetero_rt_config接受的最后一条 */
+#define HETERO_MSG_RT_PWM_BATCH 0x00D7   /* 经hetero_pwm_submit发送, 见下面的RT核PWM */
+
+#define HETERO_RT_POLICY_RM     0        /* 固定优先级, 数值小的优先 */
+#define HETERO_RT_POLICY_EDF    1
+#define HETERO_RT_FN_NOP        0
+#define HETERO_RT_FN_CONTROL    1
+#define HETERO_RT_FN_LOAD       2        /* 忙等arg微秒 */
+#define HETERO_RT_MAX_TASKS     16
+#define HETERO_RT_STATS_MAGIC   0x52544558   /* "RTEX" */
+
+/* RT执行器写在共享内存中的统计, 时间单位为时基周期 */
+struct hetero_rt_task_stats {
+    u32 cfg;                /* 任务号 | 优先级<<8 | 函数号<<16 | 运行中<<24 | 中断释放<<25 */
+    u32 period;
+    u32 releases;
+    u32 overruns;           /* 超过截止期完成 + 错过的释放 */
+    u32 wcrt;               /* 最坏响应时间 */
+    u32 last_response;
+    u32 min_latency;        /* 释放到开始执行, 抖动 = max - min */
+    u32 max_latency;
+};
+
+struct hetero_rt_stats {
+    u32 magic;
+    u32 policy;
+    u32 active;
+    u32 reserved[5];
+    struct hetero_rt_task_stats task[HETERO_RT_MAX_TASKS];
+};
+
+/*
+ * 共享内存访问
+ * hetero_shared_mem() 返回内核虚拟地址, hetero_shared_phys() 返回CPU物理地址
+ */
+void *hetero_shared_mem(void);
+phys_addr_t hetero_shared_phys(void);
+
+/* 寄存器读写, offset为上面的 *_OFFSET */
+u32 hetero_reg_read(u32 offset);
+void hetero_reg_write(u32 offset, u32 val);
+
+/* 向小核发送IPI (可在原子上下文调用) */
+int hetero_kick_core(int core_id);
+
+/* 一次写ipi_trigger触发多个核, ipi_mask见上面的IPI位分配 */
+int hetero_kick_mask(u32 ipi_mask);
+
+/* 小核复位控制: assert=true 保持复位, false 释放运行 */
+int hetero_core_set_reset(int core_id, bool assert);
+
+/*
+ * 主核IPI通知链
+ * 小核置位主核IPI时在中断上下文调用, action为触发时的ipi_status
+ */
+int hetero_register_notifier(struct notifier_block *nb);
+int hetero_unregister_notifier(struct notifier_block *nb);
+
+/* ---------------- 内核IPC接口 (均可在原子上下文调用) ---------------- */
+
+/* hetero_submit flags */
+#define HETERO_SUBMIT_NOKICK    0x1   /* 只入队不发IPI, 批量提交时最后一条再kick */
+
+/*
+ * 提交一条消息到小核的TX环, 填写msg->seq
+ * 环满返回-ENOSPC, 旁路模式下返回-EBUSY, 不会睡眠
+ */
+int hetero_submit(int core_id, struct hetero_msg *msg, unsigned int flags);
+
+/*
+ * 把同一条消息放进core_mask(bit0 IO核, bit1 RT核)中每个小核的TX环,
+ * 然后一次写ipi_trigger同时唤醒; 有小核环满时返回-ENOSPC, 其余照常发送;
+ * 旁路模式下返回-EBUSY
+ */
+int hetero_broadcast(u32 core_mask, const struct hetero_msg *msg);
+
+/*
+ * 全局时基当前值, 与小核定时器的mtime和GLOBAL_TIME CSR同一计数器;
+ * 同时注册为clocksource "hetero_gtime", 换算到CLOCK_MONOTONIC见HETERO_IOC_TIME_SYNC
+ */
+u64 hetero_read_cycles(void);
+
+/*
+ * 定时投递: 消息在时基时刻when才出现在小核的定时邮箱槽里并触发IPI,
+ * 生效时刻与Linux调度延迟无关. 小核的响应照常进入RX环.
+ * 返回槽号; 该小核的槽都在使用或处于旁路模式返回-EBUSY, when已过返回-ETIME
+ */
+int hetero_submit_at(int core_id, struct hetero_msg *msg, u64 when);
+
+/* 取消尚未投递的定时消息, 已投递返回-EALREADY */
+int hetero_cancel_at(int core_id, int slot);
+
+/*
+ * 小核RX环消息处理函数, 在主核IPI中断上下文中调用, 不能睡眠,
+ * 也不能在处理函数里注册/注销处理函数.
+ * cmd带HETERO_MSG_ERR的出错应答也交给同一个处理函数
+ */
+typedef void (*hetero_handler_t)(int core_id, const struct hetero_msg *msg,
+                                 void *priv);
+
+int hetero_register_handler(int core_id, u32 cmd, hetero_handler_t fn, void *priv);
+int hetero_unregister_handler(int core_id, u32 cmd);
+
+/*
+ * 同步调用: 提交一条消息并睡眠等待小核应答, 应答按seq匹配.
+ * 以hetero_call_handler和&call注册应答cmd的处理函数; 每个hetero_call同一时间
+ * 只有一条在途, 由调用者串行化. 超时后IO/RT核仍可能访问buf (不为NULL时),
+ * 它记在stale里, 迟到的应答到达时才释放; stale已满时只能泄漏
+ */
+#define HETERO_CALL_STALE       4
+
+struct hetero_call {
+    int core_id;
+    spinlock_t lock;
+    struct hetero_msg resp;
+    wait_queue_head_t wq;
+    struct {
+        void *buf;
+        size_t size;
+        u32 seq;
+    } stale[HETERO_CALL_STALE];
+};
+
+void hetero_call_init(struct hetero_call *call, int core_id);
+void hetero_call_handler(int core_id, const struct hetero_msg *msg, void *priv);
+
+/* 出错应答返回负的errno, 超时返回-ETIMEDOUT */
+int hetero_call(struct hetero_call *call, struct hetero_msg *msg, struct hetero_msg *resp,
+                void *buf, size_t size, unsigned long timeout);
+
+/* 还在等迟到应答的缓冲区数; 注销处理函数之后它们不会再释放 */
+int hetero_call_stale(struct hetero_call *call);
+
+/*
+ * RT核延迟测量块 (firmware/rt_core/rt_bench.h), 从缓冲池分配, 由hetero_bench.ko使用.
+ * 主核发IPI前写ipi_stamp再递增ipi_seq, RT核醒来后把差值计入ipi直方图;
+ * jitter为执行器作业开始执行距名义释放时刻的周期数
+ */
+#define HETERO_RT_BENCH_MAGIC   0x52544248   /* "RTBH" */
+#define HETERO_RT_BENCH_BINS    64
+
+struct hetero_rt_bench_hist {
+    u32 count;
+    u32 min;
+    u32 max;
+    u32 overflow;
+    u32 sum_lo;
+    u32 sum_hi;
+    u32 reserved[2];
+    u32 bin[HETERO_RT_BENCH_BINS];
+};
+
+struct hetero_rt_bench {
+    u32 magic;
+    u32 bin_shift;
+    u32 ipi_seq;
+    u32 ipi_stamp;
+    u32 ipi_seen;
+    u32 reserved[3];
+    struct hetero_rt_bench_hist ipi;
+    struct hetero_rt_bench_hist jitter;
+};
+
+/*
+ * IO核I2C主机 (make.py --i2c-offload, firmware/io_core/io_i2c.c), 由hetero_i2c.ko使用.
+ * 一次XFER即一次i2c_transfer: 消息之间重复起始, 最后一条之后停止;
+ * 地址无应答返回ENXIO, 数据无应答EIO, 时钟延展超时ETIMEDOUT
+ */
+#define HETERO_MSG_I2C_XFER     0x00E0   /* arg0 = struct hetero_i2c_msg数组总线地址, arg1 = 消息数; 应答arg0 = 完成的消息数 */
+#define HETERO_MSG_I2C_CONFIG   0x00E1   /* arg0 = SCL频率(Hz) */
+
+#define HETERO_I2C_MAX_MSGS     8
+#define HETERO_I2C_F_RD         0x0001   /* 与I2C_M_RD相同 */
+
+struct hetero_i2c_msg {
+    u16 addr;               /* 7位地址 */
+    u16 flags;
+    u16 len;
+    u16 reserved;
+    u32 buf;                /* 数据总线地址 */
+};
+
+/*
+ * IO核SPI主机 (make.py --spi-offload, firmware/io_core/io_spi.c), 由hetero_spi.ko使用.
+ * 一次XFER即一个spi_message: 片选在整个消息期间保持 (CS_CHANGE的传输之后短暂释放),
+ * 各传输的字连续移位; 数据缓冲区都在共享内存里
+ */
+#define HETERO_MSG_SPI_XFER     0x00E8   /* arg0 = struct hetero_spi_xfer数组总线地址, arg1 = 传输数 | 片选<<16; 应答arg0 = 传输的字节数 */
+
+#define HETERO_SPI_MAX_XFERS    16
+#define HETERO_SPI_F_CS_CHANGE  0x0001
+
+struct hetero_spi_xfer {
+    u32 tx;                 /* 发送数据总线地址, 0 = 发送0 */
+    u32 rx;                 /* 接收数据总线地址, 0 = 丢弃 */
+    u16 len;
+    u16 div;                /* SCLK = sys_clk / div, 0 = 沿用 */
+    u16 delay_us;           /* 本传输之后的延时 */
+    u16 flags;
+};
+
+/*
+ * IO核以太网接收预处理 (make.py --eth-offload, firmware/io_core/io_eth.c), 由hetero_eth.ko使用.
+ * 接收环和帧缓冲区都在共享内存里: IO核按目的MAC和分类掩码过滤收到的帧, 把留下的帧
+ * 连同分类, 流哈希和MAC锁存的时间戳拷进环; 环里有新帧且notify为1时清notify并
+ * 发一条HETERO_MSG_ETH_RX (没有应答), 主核一次poll取走一批帧.
+ * 发送: 帧放在共享内存里用HETERO_MSG_ETH_XMIT提交, IO核拷进MAC发送槽后应答
+ */
+#define HETERO_MSG_ETH_START    0x00F0   /* arg0 = struct hetero_eth_ring总线地址, arg1 = 描述符数 */
+#define HETERO_MSG_ETH_STOP     0x00F1   /* 应答之后IO核不再访问接收环 */
+#define HETERO_MSG_ETH_XMIT     0x00F2   /* arg0 = 帧总线地址, arg1 = 长度 | 发送缓冲区号<<16 */
+#define HETERO_MSG_ETH_RX       0x00F3   /* IO核发起: arg0 = 环的head */
+
+#define HETERO_ETH_MAX_DESC     16       /* 描述符数为2的幂, 2-16 */
+#define HETERO_ETH_BUF_SIZE     1536     /* 每个描述符的帧缓冲区, 更长的帧丢弃 */
+#define HETERO_ETH_F_PROMISC    0x0001   /* 不按目的MAC过滤 */
+#define HETERO_ETH_F_ALLMULTI   0x0002   /* 接收所有组播 */
+
+/* 组播地址在mc_hash中的位: (addr[3] ^ addr[4] ^ addr[5]) & 63 */
+#define HETERO_ETH_MC_BIT(addr) (((addr)[3] ^ (addr)[4] ^ (addr)[5]) & 63)
+
+/* 分类 (描述符info[23:16]), 值n对应class_mask的位n */
+#define HETERO_ETH_CLASS_OTHER  0
+#define HETERO_ETH_CLASS_ARP    1
+#define HETERO_ETH_CLASS_IPV4   2        /* 分片, 带长选项或其他协议 */
+#define HETERO_ETH_CLASS_TCP4   3
+#define HETERO_ETH_CLASS_UDP4   4
+#define HETERO_ETH_CLASS_ICMP4  5
+#define HETERO_ETH_CLASS_IPV6   6
+#define HETERO_ETH_CLASS_TCP6   7
+#define HETERO_ETH_CLASS_UDP6   8
+#define HETERO_ETH_CLASS_ALL    0x1FF
+#define HETERO_ETH_CLASS_VLAN   0x80     /* 带一层802.1Q标签, 与上面的值相或 */
+
+struct hetero_eth_desc {
+    u32 buf;                /* 帧缓冲区总线地址, 主核在START之前填写 */
+    u32 info;               /* [15:0]长度 [23:16]分类 */
+    u32 stamp;              /* 第一个字到达MAC的时刻 (时基低32位) */
+    u32 hash;               /* TCP/UDP按地址和端口, 其他IP按地址, 0 = 没有 */
+};
+
+struct hetero_eth_ring {
+    u32 head;               /* IO核写: 已填写的描述符数, 自由增长 */
+    u32 tail;               /* 主核写: 已取走的描述符数 */
+    u32 notify;             /* 主核写1请求下一次HETERO_MSG_ETH_RX, IO核发出前清0 */
+    u32 flags;              /* HETERO_ETH_F_*, 主核随时可改 */
+    u32 class_mask;         /* 交给主核的分类, 其余丢弃 */
+    u8  mac[6];             /* 本机MAC */
+    u16 reserved;
+    u32 mc_hash[2];         /* 接收的组播 (HETERO_ETH_MC_BIT) */
+    /* IO核写的统计 */
+    u32 rx_frames;          /* 放进环的帧 */
+    u32 rx_filtered;        /* 按MAC/分类丢弃 */
+    u32 rx_full;            /* 环满丢弃 */
+    u32 rx_errors;          /* MAC出错或超长 (硬件计数) */
+    u32 rx_missed;          /* MAC没有空闲接收槽 (硬件计数) */
+    u32 reserved2[2];
+    struct hetero_eth_desc desc[];
+};
+
+/*
+ * 配置RT核执行器: 发送一条HETERO_MSG_RT_*消息并等待应答, 可以睡眠
+ * 返回RT核给出的错误码, 超时返回-ETIMEDOUT
+ */
+int hetero_rt_config(u32 cmd, u32 arg0, u32 arg1);
+
+/* RT执行器统计 (共享内存, 只读) */
+const struct hetero_rt_stats *hetero_rt_stats(void);
+
+/*
+ * 中断路由: flags为HETERO_IRQ_ROUTE_*的组合, 0 = 不再路由.
+ * 绑定到RT任务用 hetero_rt_config(HETERO_MSG_RT_IRQ_BIND, ...), 源锁存后RT核
+ * 立即释放该任务的一个作业 (不再按周期释放, 周期即相对截止期)
+ */
+#define HETERO_IRQ_ROUTE_RT       0x1    /* 送RT核 */
+#define HETERO_IRQ_ROUTE_MAIN     0x2    /* 转发给Linux, 交给hetero_irq_route_register的处理函数 */
+#define HETERO_IRQ_ROUTE_FALLING  0x4    /* 下降沿, 默认上升沿 */
+
+int hetero_irq_route(int src, unsigned int flags);
+
+/* 转发到Linux的源的处理函数, 在主核IPI中断上下文中调用; stamp为锁存时的时基低32位 */
+typedef void (*hetero_irq_route_fn)(int src, u32 stamp, void *priv);
+
+int hetero_irq_route_register(int src, hetero_irq_route_fn fn, void *priv);
+void hetero_irq_route_unregister(int src);
+
+/*
+ * RT核PWM (make.py --pwm-offload, firmware/rt_core/rt_pwm.c): 各通道共用周期计数器.
+ * 一批设定值是若干帧, RT核拷进自己的队列后应答 (arg0 = 帧数组总线地址,
+ * arg1 = 帧数 | 标志<<16; 应答arg1 = 队列中的帧数). 每帧在上一帧保持hold个
+ * PWM周期后于周期边界整体生效, 生效时刻由硬件计数决定; 队列放完后保持最后一帧
+ */
+#define HETERO_PWM_MAX_CHANNELS 4
+#define HETERO_PWM_QUEUE_LEN    64
+#define HETERO_PWM_F_FLUSH      0x1      /* 先丢弃队列中尚未装填的帧 */
+
+struct hetero_pwm_frame {
+    u32 period;             /* PWM周期, 时基周期数, 0 = 停止 */
+    u32 enable;             /* 通道使能位图 */
+    u32 hold;               /* 保持的PWM周期数, 0按1计 */
+    u32 width[HETERO_PWM_MAX_CHANNELS];  /* 高电平时基周期数 */
+};
+
+/* 提交一批设定值, 可以睡眠; 返回RT核队列中的帧数, 队列放不下返回-ENOSPC */
+int hetero_pwm_submit(const struct hetero_pwm_frame *frames, int n, unsigned int flags);
+
+/*
+ * 共享内存缓冲区分配, bus_addr返回小核看到的地址 (可直接放入消息参数)
+ */
+void *hetero_buf_alloc(size_t size, u32 *bus_addr);
+void hetero_buf_free(void *buf, size_t size);
+size_t hetero_buf_avail(void);
+u32 hetero_buf_to_bus(const void *buf);
+void *hetero_bus_to_buf(u32 bus_addr);
+
+/*
+ * 共享内存原子操作, offset为共享内存内偏移(4字节对齐), 返回旧值
+ * 硬件上经SRAM控制器的原子窗口完成, 对小核也是原子的; 可在原子上下文调用
+ */
+u32 hetero_atomic_fetch_add(u32 offset, u32 val);
+u32 hetero_atomic_xchg(u32 offset, u32 val);
+u32 hetero_atomic_cmpxchg(u32 offset, u32 old, u32 new);
+
+/*
+ * 硬件同步块, 每个操作对应一次总线访问, 可在原子上下文调用
+ * hetero_sem_take: 计数非零则减一并返回true
+ * hetero_evt_config: cfg = 目标IPI位 [| HETERO_EVT_ALL], 条件由不满足变为满足时触发
+ */
+int hetero_sem_init(int sem, u32 count);
+bool hetero_sem_take(int sem);
+int hetero_sem_give(int sem, u32 count);
+u32 hetero_evt_get(int group);
+int hetero_evt_set(int group, u32 bits);
+int hetero_evt_clear(int group, u32 bits);
+int hetero_evt_config(int group, u32 mask, u32 cfg);
+
+/*
+ * 硬件句柄队列, 句柄一般是共享内存缓冲区的总线地址
+ * hetero_qm_push: 队列满返回-ENOSPC; hetero_qm_pop: 队列空返回-ENODATA
+ * hetero_qm_config: 句柄数达到thresh时向ipi_bits指定的核发IPI, thresh=0关闭
+ */
+int hetero_qm_push(int q, u32 handle);
+int hetero_qm_pop(int q, u32 *handle);
+int hetero_qm_count(int q);
+int hetero_qm_config(int q, u32 thresh, u32 ipi_bits);
+
+/*
+ * 句柄队列作为分配器: 把count个size字节的共享内存缓冲区放进队列q,
+ * 之后主核和小核都从q取/还缓冲区, 不需要互斥锁
+ */
+int hetero_qm_pool_create(int q, size_t size, int count);
+void hetero_qm_pool_destroy(int q);
+void *hetero_qm_buf_get(int q, u32 *bus_addr);
+int hetero_qm_buf_put(int q, void *buf);
+
+/*
+ * 句柄队列作为工作队列: 小核入队后, 在工作队列(进程上下文)里对每个句柄调用fn
+ */
+typedef void (*hetero_qm_consumer_t)(int q, u32 handle, void *priv);
+
+int hetero_qm_register_consumer(int q, hetero_qm_consumer_t fn, void *priv);
+void hetero_qm_unregister_consumer(int q);
+
+/*
+ * 上调用处理函数, 在工作队列(进程上下文)中调用, 可以睡眠
+ * reply的cmd/seq已填好, 处理函数填写arg0/arg1;
+ * 返回负的errno时应答带HETERO_MSG_ERR
+ * 没有内核处理函数的上调用交给用户态 (HETERO_IOC_UPCALL_GET/REPLY)
+ */
+typedef int (*hetero_upcall_fn)(int core_id, const struct hetero_msg *req,
+                                struct hetero_msg *reply, void *priv);
+
+int hetero_register_upcall(u32 cmd, hetero_upcall_fn fn, void *priv);
+int hetero_unregister_upcall(u32 cmd);
+
+#endif /* _HETERO_REGS_H */
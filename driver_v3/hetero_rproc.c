@@ -0,0 +1,312 @@
+/* hetero_rproc.c - IO核/RT核的remoteproc驱动
+ *
+ * 每个小核注册一个remoteproc实例:
+ *   - ELF固件加载到 small_core_N_mem (复位向量即内存基址)
+ *   - vring放在共享SRAM高16KB, 每个小核两条 (vdev0vring0/1)
+ *   - rpmsg缓冲区放在小核内存末尾256KB
+ *   - kick: 主核->小核使用IPI bit N, 小核->主核使用IPI主核位
+ *
+ * 固件需要提供 .resource_table 段, 见 firmware/common/rsc_table.c
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/remoteproc.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+
+#include "hetero_regs.h"
+
+#define DRIVER_NAME "hetero_rproc"
+
+/* 每个小核的vring区域: 共享内存高16KB平分 */
+#define VRING_REGION_SIZE    (HETERO_SHM_VRING_SIZE / HETERO_NUM_SMALL_CORES)
+#define VRING_SIZE           0x1000   /* 每条vring一页 */
+#define NUM_VRINGS           2
+
+/* rpmsg缓冲区: 小核内存末尾256KB */
+#define VDEV_BUF_OFFSET      0xC0000
+#define VDEV_BUF_SIZE        0x40000
+
+static const char * const hetero_rproc_fw[HETERO_NUM_SMALL_CORES] = {
+    "hetero_io_core.elf",
+    "hetero_rt_core.elf",
+};
+
+struct hetero_rproc {
+    struct rproc *rproc;
+    int core_id;
+
+    /* small_core_N_mem 映射 */
+    void *mem_va;
+    dma_addr_t mem_dma;
+
+    /* 小核->主核kick处理 */
+    struct notifier_block nb;
+    struct work_struct vq_work;
+};
+
+static struct platform_device *hetero_rproc_pdev[HETERO_NUM_SMALL_CORES];
+
+/* vring在共享内存中的偏移 */
+static u32 hetero_rproc_vring_offset(struct hetero_rproc *hrp, int vring)
+{
+    return HETERO_SHM_VRING_OFFSET + hrp->core_id * VRING_REGION_SIZE +
+           vring * VRING_SIZE;
+}
+
+/* 小核地址 -> 内核虚拟地址 */
+static void *hetero_rproc_da_to_va(struct rproc *rproc, u64 da, int len)
+{
+    struct hetero_rproc *hrp = rproc->priv;
+    u64 mem_base = HETERO_CORE_MEM_BASE(hrp->core_id);
+
+    if (len <= 0)
+        return NULL;
+
+    /* 小核私有内存 */
+    if (da >= mem_base && da + len <= mem_base + HETERO_CORE_MEM_SIZE)
+        return hrp->mem_va + (da - mem_base);
+
+    /* 共享SRAM */
+    if (da >= HETERO_SHM_BUS_BASE &&
+        da + len <= HETERO_SHM_BUS_BASE + HETERO_SHM_SIZE)
+        return hetero_shared_mem() + (da - HETERO_SHM_BUS_BASE);
+
+    return NULL;
+}
+
+/* 注册vring和rpmsg缓冲区carveout, 再解析资源表 */
+static int hetero_rproc_parse_fw(struct rproc *rproc, const struct firmware *fw)
+{
+    struct hetero_rproc *hrp = rproc->priv;
+    struct rproc_mem_entry *mem;
+    u32 offset;
+    int i;
+
+    for (i = 0; i < NUM_VRINGS; i++) {
+        offset = hetero_rproc_vring_offset(hrp, i);
+        mem = rproc_mem_entry_init(&rproc->dev,
+                                   hetero_shared_mem() + offset,
+                                   hetero_shared_phys() + offset,
+                                   VRING_SIZE,
+                                   HETERO_SHM_BUS_BASE + offset,
+                                   NULL, NULL, "vdev0vring%d", i);
+        if (!mem)
+            return -ENOMEM;
+        rproc_add_carveout(rproc, mem);
+    }
+
+    mem = rproc_mem_entry_init(&rproc->dev,
+                               hrp->mem_va + VDEV_BUF_OFFSET,
+                               hrp->mem_dma + VDEV_BUF_OFFSET,
+                               VDEV_BUF_SIZE,
+                               HETERO_CORE_MEM_BASE(hrp->core_id) + VDEV_BUF_OFFSET,
+                               NULL, NULL, "vdev0buffer");
+    if (!mem)
+        return -ENOMEM;
+    rproc_add_carveout(rproc, mem);
+
+    return rproc_elf_load_rsc_table(rproc, fw);
+}
+
+static int hetero_rproc_start(struct rproc *rproc)
+{
+    struct hetero_rproc *hrp = rproc->priv;
+
+    /* 复位向量由硬件固定为小核内存基址 */
+    if (rproc->bootaddr != HETERO_CORE_MEM_BASE(hrp->core_id)) {
+        dev_err(&rproc->dev, "固件入口0x%08x与复位向量0x%08x不一致\n",
+                rproc->bootaddr, HETERO_CORE_MEM_BASE(hrp->core_id));
+        return -EINVAL;
+    }
+
+    return hetero_core_set_reset(hrp->core_id, false);
+}
+
+static int hetero_rproc_stop(struct rproc *rproc)
+{
+    struct hetero_rproc *hrp = rproc->priv;
+
+    return hetero_core_set_reset(hrp->core_id, true);
+}
+
+/* 主核->小核: 小核收到IPI后检查所有vring */
+static void hetero_rproc_kick(struct rproc *rproc, int vqid)
+{
+    struct hetero_rproc *hrp = rproc->priv;
+
+    hetero_kick_core(hrp->core_id);
+}
+
+static const struct rproc_ops hetero_rproc_ops = {
+    .start                 = hetero_rproc_start,
+    .stop                  = hetero_rproc_stop,
+    .kick                  = hetero_rproc_kick,
+    .da_to_va              = hetero_rproc_da_to_va,
+    .parse_fw              = hetero_rproc_parse_fw,
+    .load                  = rproc_elf_load_segments,
+    .find_loaded_rsc_table = rproc_elf_find_loaded_rsc_table,
+    .sanity_check          = rproc_elf_sanity_check,
+    .get_boot_addr         = rproc_elf_get_boot_addr,
+};
+
+/* 小核->主核: rpmsg回调可能睡眠, 放到工作队列里处理 */
+static void hetero_rproc_vq_work(struct work_struct *work)
+{
+    struct hetero_rproc *hrp = container_of(work, struct hetero_rproc, vq_work);
+    int i;
+
+    for (i = 0; i < NUM_VRINGS; i++)
+        rproc_vq_interrupt(hrp->rproc, i);
+}
+
+/* 主核IPI通知: 无法区分来源核, 每个实例都检查自己的vring */
+static int hetero_rproc_notify(struct notifier_block *nb,
+                               unsigned long status, void *data)
+{
+    struct hetero_rproc *hrp = container_of(nb, struct hetero_rproc, nb);
+
+    if (hrp->rproc->state == RPROC_RUNNING)
+        schedule_work(&hrp->vq_work);
+
+    return NOTIFY_OK;
+}
+
+static int hetero_rproc_probe(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;
+    struct hetero_rproc *hrp;
+    struct rproc *rproc;
+    int core_id = pdev->id;
+    int ret;
+
+    if (core_id < 0 || core_id >= HETERO_NUM_SMALL_CORES)
+        return -ENODEV;
+
+    ret = dma_coerce_mask_and_coherent(dev, DMA_BIT_MASK(32));
+    if (ret)
+        return ret;
+
+    rproc = rproc_alloc(dev, dev_name(dev), &hetero_rproc_ops,
+                        hetero_rproc_fw[core_id], sizeof(*hrp));
+    if (!rproc)
+        return -ENOMEM;
+
+    hrp = rproc->priv;
+    hrp->rproc = rproc;
+    hrp->core_id = core_id;
+
+    /*
+     * 模拟 small_core_N_mem: 真实硬件上这里应ioremap 0x80200000/0x80300000,
+     * 与hetero_regs一样用内核内存代替
+     */
+    hrp->mem_va = dma_alloc_coherent(dev, HETERO_CORE_MEM_SIZE,
+                                     &hrp->mem_dma, GFP_KERNEL);
+    if (!hrp->mem_va) {
+        dev_err(dev, "无法分配小核%d内存\n", core_id);
+        ret = -ENOMEM;
+        goto err_free;
+    }
+
+    INIT_WORK(&hrp->vq_work, hetero_rproc_vq_work);
+    hrp->nb.notifier_call = hetero_rproc_notify;
+
+    /* 加载固件前保持小核复位 */
+    hetero_core_set_reset(core_id, true);
+
+    ret = hetero_register_notifier(&hrp->nb);
+    if (ret)
+        goto err_mem;
+
+    platform_set_drvdata(pdev, rproc);
+
+    ret = rproc_add(rproc);
+    if (ret) {
+        dev_err(dev, "rproc_add失败: %d\n", ret);
+        goto err_nb;
+    }
+
+    dev_info(dev, "小核%d remoteproc已注册, 固件: %s\n",
+             core_id, hetero_rproc_fw[core_id]);
+    return 0;
+
+err_nb:
+    hetero_unregister_notifier(&hrp->nb);
+err_mem:
+    dma_free_coherent(dev, HETERO_CORE_MEM_SIZE, hrp->mem_va, hrp->mem_dma);
+err_free:
+    rproc_free(rproc);
+    return ret;
+}
+
+static int hetero_rproc_remove(struct platform_device *pdev)
+{
+    struct rproc *rproc = platform_get_drvdata(pdev);
+    struct hetero_rproc *hrp = rproc->priv;
+
+    rproc_del(rproc);
+    hetero_unregister_notifier(&hrp->nb);
+    cancel_work_sync(&hrp->vq_work);
+    dma_free_coherent(&pdev->dev, HETERO_CORE_MEM_SIZE,
+                      hrp->mem_va, hrp->mem_dma);
+    rproc_free(rproc);
+
+    return 0;
+}
+
+static struct platform_driver hetero_rproc_driver = {
+    .probe  = hetero_rproc_probe,
+    .remove = hetero_rproc_remove,
+    .driver = {
+        .name = DRIVER_NAME,
+    },
+};
+
+static int __init hetero_rproc_init(void)
+{
+    int ret;
+    int i;
+
+    ret = platform_driver_register(&hetero_rproc_driver);
+    if (ret)
+        return ret;
+
+    /* 每个小核一个设备实例, id即核号 */
+    for (i = 0; i < HETERO_NUM_SMALL_CORES; i++) {
+        hetero_rproc_pdev[i] = platform_device_register_simple(DRIVER_NAME,
+                                                              i, NULL, 0);
+        if (IS_ERR(hetero_rproc_pdev[i])) {
+            ret = PTR_ERR(hetero_rproc_pdev[i]);
+            goto err_unreg;
+        }
+    }
+
+    return 0;
+
+err_unreg:
+    while (--i >= 0)
+        platform_device_unregister(hetero_rproc_pdev[i]);
+    platform_driver_unregister(&hetero_rproc_driver);
+    return ret;
+}
+
+static void __exit hetero_rproc_exit(void)
+{
+    int i;
+
+    for (i = 0; i < HETERO_NUM_SMALL_CORES; i++)
+        platform_device_unregister(hetero_rproc_pdev[i]);
+    platform_driver_unregister(&hetero_rproc_driver);
+}
+
+module_init(hetero_rproc_init);
+module_exit(hetero_rproc_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - remoteproc for IO/RT cores");
+MODULE_VERSION("0.1");
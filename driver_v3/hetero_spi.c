@@ -0,0 +1,261 @@
+/* hetero_spi.c - 经IO核完成传输的SPI控制器
+ *
+ * 配合 make.py --spi-offload 和IO核固件 firmware/io_core/io_spi.c:
+ * 一个spi_message的所有传输描述和收发缓冲区放进共享内存, 用一条
+ * HETERO_MSG_SPI_XFER提交; IO核保持片选, 经收发FIFO连续移位完所有传输后
+ * 只应答一次, 读数据再拷回. 只支持模式0和8位字.
+ *
+ * 设备树节点 compatible = "litex,hetero-spi" (soc_linux.py生成, 标签hetero_spi),
+ * 从设备用overlay加在该节点下; 没有节点时 (模拟环境) 自己注册一个设备
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/spi/spi.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/of.h>
+
+#include "hetero_regs.h"
+
+#define DRIVER_NAME "hetero_spi"
+
+/* 一个消息的收发数据总量上限, 从共享内存缓冲池分配 */
+#define HETERO_SPI_MAX_DATA     4096
+
+struct hetero_spi {
+    struct spi_controller *ctlr;
+
+    /* IO核应答; 消息由SPI核心的队列串行化 */
+    struct hetero_call call;
+};
+
+static struct platform_device *hetero_spi_pdev;
+
+/*
+ * 共享内存布局: struct hetero_spi_xfer[n], 之后依次是各传输的发送/接收数据
+ */
+static int hetero_spi_transfer_one_message(struct spi_controller *ctlr,
+                                           struct spi_message *m)
+{
+    struct hetero_spi *hs = spi_controller_get_devdata(ctlr);
+    struct hetero_msg msg = { .cmd = HETERO_MSG_SPI_XFER };
+    struct hetero_msg resp;
+    struct hetero_spi_xfer *desc;
+    struct spi_transfer *t;
+    size_t size, off;
+    u32 div, max_div = 2;
+    u64 bits = 0;
+    int n = 0, i;
+    u32 bus;
+    u8 *buf;
+    int ret;
+
+    size = 0;
+    list_for_each_entry(t, &m->transfers, transfer_list) {
+        size += (t->tx_buf ? t->len : 0) + (t->rx_buf ? t->len : 0);
+        bits += (u64)t->len * 8;
+        n++;
+    }
+    if (!n || n > HETERO_SPI_MAX_XFERS || size > HETERO_SPI_MAX_DATA) {
+        ret = -EINVAL;
+        goto out;
+    }
+    size += n * sizeof(*desc);
+
+    buf = hetero_buf_alloc(size, &bus);
+    if (!buf) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    desc = (struct hetero_spi_xfer *)buf;
+    off = n * sizeof(*desc);
+    i = 0;
+    list_for_each_entry(t, &m->transfers, transfer_list) {
+        div = clamp_t(u32, DIV_ROUND_UP(HETERO_TIMEBASE_HZ, t->speed_hz), 2, 0xFFFF);
+        max_div = max(max_div, div);
+
+        desc[i].len = t->len;
+        desc[i].div = div;
+        desc[i].delay_us = t->delay_usecs;
+        desc[i].flags = t->cs_change ? HETERO_SPI_F_CS_CHANGE : 0;
+        desc[i].tx = 0;
+        desc[i].rx = 0;
+        if (t->tx_buf) {
+            memcpy(buf + off, t->tx_buf, t->len);
+            desc[i].tx = bus + off;
+            off += t->len;
+        }
+        if (t->rx_buf) {
+            desc[i].rx = bus + off;
+            off += t->len;
+        }
+        i++;
+    }
+
+    msg.arg0 = bus;
+    msg.arg1 = n | (m->spi->chip_select << 16);
+
+    /* 超时按最慢的时钟估算, 留一倍余量 */
+    ret = hetero_call(&hs->call, &msg, &resp, buf, size,
+                      msecs_to_jiffies(100 + div_u64(bits * max_div * 2,
+                                                     HETERO_TIMEBASE_HZ / 1000)));
+    if (ret == -ETIMEDOUT)
+        goto out;
+
+    if (!ret) {
+        off = n * sizeof(*desc);
+        list_for_each_entry(t, &m->transfers, transfer_list) {
+            if (t->tx_buf)
+                off += t->len;
+            if (t->rx_buf) {
+                memcpy(t->rx_buf, buf + off, t->len);
+                off += t->len;
+            }
+        }
+        m->actual_length = resp.arg0;
+    }
+    hetero_buf_free(buf, size);
+out:
+    /* 出错也已完成本消息, 错误码在m->status里 */
+    m->status = ret;
+    spi_finalize_current_message(ctlr);
+    return 0;
+}
+
+/*
+ * 缓冲池与hetero_eth等共用, 按当前剩余量估算: 扣掉传输描述, 收发都有时占两份.
+ * 只是上限的估计, 之后分配仍可能失败 (-ENOMEM)
+ */
+static size_t hetero_spi_max_size(struct spi_device *spi)
+{
+    size_t avail = hetero_buf_avail();
+    size_t desc = HETERO_SPI_MAX_XFERS * sizeof(struct hetero_spi_xfer);
+
+    if (avail <= desc)
+        return 0;
+    return min_t(size_t, HETERO_SPI_MAX_DATA, avail - desc) / 2;
+}
+
+static int hetero_spi_probe(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;
+    struct spi_controller *ctlr;
+    struct hetero_spi *hs;
+    u32 num_cs = 1;
+    int ret;
+
+    ctlr = spi_alloc_master(dev, sizeof(*hs));
+    if (!ctlr)
+        return -ENOMEM;
+
+    hs = spi_controller_get_devdata(ctlr);
+    hs->ctlr = ctlr;
+    hetero_call_init(&hs->call, HETERO_CORE_IO);
+
+    of_property_read_u32(dev->of_node, "num-cs", &num_cs);
+
+    ctlr->dev.of_node = dev->of_node;
+    ctlr->bus_num = -1;
+    ctlr->num_chipselect = num_cs;
+    ctlr->mode_bits = 0;
+    ctlr->bits_per_word_mask = SPI_BPW_MASK(8);
+    ctlr->min_speed_hz = HETERO_TIMEBASE_HZ / 0xFFFF;
+    ctlr->max_speed_hz = HETERO_TIMEBASE_HZ / 2;
+    ctlr->transfer_one_message = hetero_spi_transfer_one_message;
+    ctlr->max_transfer_size = hetero_spi_max_size;
+    ctlr->max_message_size = hetero_spi_max_size;
+
+    platform_set_drvdata(pdev, hs);
+
+    ret = hetero_register_handler(HETERO_CORE_IO, HETERO_MSG_SPI_XFER | HETERO_MSG_RESP,
+                                  hetero_call_handler, &hs->call);
+    if (ret)
+        goto err_put;
+
+    /* 注册成功后控制器的引用由devm在注销时释放 */
+    ret = devm_spi_register_controller(dev, ctlr);
+    if (ret) {
+        dev_err(dev, "SPI控制器注册失败: %d\n", ret);
+        hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_SPI_XFER | HETERO_MSG_RESP);
+        goto err_put;
+    }
+
+    dev_info(dev, "IO核SPI控制器已注册, %u个片选\n", num_cs);
+    return 0;
+
+err_put:
+    spi_master_put(ctlr);
+    return ret;
+}
+
+static int hetero_spi_remove(struct platform_device *pdev)
+{
+    struct hetero_spi *hs = platform_get_drvdata(pdev);
+
+    /* devm在本函数之后才注销控制器, 先停队列, 不再有新消息 */
+    spi_controller_suspend(hs->ctlr);
+    hetero_unregister_handler(HETERO_CORE_IO, HETERO_MSG_SPI_XFER | HETERO_MSG_RESP);
+
+    if (hetero_call_stale(&hs->call))
+        dev_warn(&pdev->dev, "%d次超时消息的缓冲区未释放\n", hetero_call_stale(&hs->call));
+    return 0;
+}
+
+static const struct of_device_id hetero_spi_of_match[] = {
+    { .compatible = "litex,hetero-spi" },
+    { }
+};
+MODULE_DEVICE_TABLE(of, hetero_spi_of_match);
+
+static struct platform_driver hetero_spi_driver = {
+    .probe  = hetero_spi_probe,
+    .remove = hetero_spi_remove,
+    .driver = {
+        .name = DRIVER_NAME,
+        .of_match_table = hetero_spi_of_match,
+    },
+};
+
+static int __init hetero_spi_init(void)
+{
+    struct device_node *np;
+    int ret;
+
+    ret = platform_driver_register(&hetero_spi_driver);
+    if (ret)
+        return ret;
+
+    /* 设备树里没有控制器节点时(模拟环境), 自己注册一个设备 */
+    np = of_find_matching_node(NULL, hetero_spi_of_match);
+    if (np) {
+        of_node_put(np);
+        return 0;
+    }
+
+    hetero_spi_pdev = platform_device_register_simple(DRIVER_NAME, -1, NULL, 0);
+    if (IS_ERR(hetero_spi_pdev)) {
+        platform_driver_unregister(&hetero_spi_driver);
+        return PTR_ERR(hetero_spi_pdev);
+    }
+
+    return 0;
+}
+
+static void __exit hetero_spi_exit(void)
+{
+    if (hetero_spi_pdev)
+        platform_device_unregister(hetero_spi_pdev);
+    platform_driver_unregister(&hetero_spi_driver);
+}
+
+module_init(hetero_spi_init);
+module_exit(hetero_spi_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("6-Core Heterogeneous System - SPI controller offloaded to the IO core");
+MODULE_VERSION("0.1");
@@ -7,6 +7,9 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/eventfd.h>
 #include <time.h>
 #include <stdint.h>
 
@@ -32,6 +35,89 @@
 #define HETERO_IOC_GET_INFO   _IOR(HETERO_IOC_MAGIC, 1, struct hetero_info)
 #define HETERO_IOC_SEND_IPI   _IOW(HETERO_IOC_MAGIC, 3, int)
 #define HETERO_IOC_RESET      _IO(HETERO_IOC_MAGIC, 4)
+#define HETERO_IOC_UPCALL_GET   _IOR(HETERO_IOC_MAGIC, 5, struct hetero_upcall)
+#define HETERO_IOC_UPCALL_REPLY _IOW(HETERO_IOC_MAGIC, 6, struct hetero_upcall)
+#define HETERO_IOC_SET_EVENTFD  _IOW(HETERO_IOC_MAGIC, 7, int)
+#define HETERO_IOC_WAIT_VALUE   _IOWR(HETERO_IOC_MAGIC, 8, struct hetero_wait_value)
+
+#define HETERO_WAIT_NE 1
+
+struct hetero_wait_value {
+    uint32_t offset;
+    uint32_t value;
+    uint32_t mask;
+    uint32_t op;
+    int32_t timeout_ms;
+    uint32_t cur_value;
+};
+
+#define HETERO_IOC_SEND_IPI_MASK _IOW(HETERO_IOC_MAGIC, 9, uint32_t)
+
+/* 定时投递: when为时基周期数 */
+#define HETERO_IOC_SUBMIT_AT  _IOWR(HETERO_IOC_MAGIC, 10, struct hetero_timed_msg)
+#define HETERO_IOC_GET_CYCLES _IOR(HETERO_IOC_MAGIC, 11, uint64_t)
+#define HETERO_IOC_TIME_SYNC  _IOR(HETERO_IOC_MAGIC, 12, struct hetero_time_sync)
+#define TIMEBASE_HZ 100000000
+
+/* 全局时基与CLOCK_MONOTONIC的对应点 */
+struct hetero_time_sync {
+    uint64_t cycles;
+    uint64_t mono_ns;
+    uint64_t freq_hz;
+};
+
+struct hetero_timed_msg {
+    int32_t core_id;
+    int32_t slot;
+    uint32_t cmd;
+    uint32_t seq;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint64_t when;
+};
+
+/* RT核执行器配置, 统计在共享内存0xC00 */
+struct hetero_rt_config {
+    uint32_t cmd;
+    uint32_t arg0;
+    uint32_t arg1;
+};
+
+#define HETERO_IOC_RT_CONFIG  _IOW(HETERO_IOC_MAGIC, 13, struct hetero_rt_config)
+#define HETERO_MSG_RT_POLICY  0x00D0
+#define HETERO_RT_POLICY_EDF  1
+#define RT_STATS_OFFSET       0x0C00
+#define RT_STATS_MAGIC        0x52544558
+
+/* RT核PWM设定值批量提交, 返回RT核队列中的帧数 */
+struct hetero_pwm_frame {
+    uint32_t period;
+    uint32_t enable;
+    uint32_t hold;
+    uint32_t width[4];
+};
+
+struct hetero_pwm_batch {
+    uint64_t frames;
+    uint32_t count;
+    uint32_t flags;
+};
+
+#define HETERO_IOC_PWM_SUBMIT _IOW(HETERO_IOC_MAGIC, 14, struct hetero_pwm_batch)
+#define HETERO_PWM_F_FLUSH    0x1
+
+/* IPI位: bit0 IO核, bit1 RT核, bit2-5 Linux hart0-3 */
+#define IPI_SMALL_MASK 0x03
+#define IPI_MAIN_MASK  0x3C
+
+/* 上调用 (小核 -> 主核请求) */
+struct hetero_upcall {
+    int core_id;
+    uint32_t cmd;
+    uint32_t seq;
+    uint32_t arg0;
+    uint32_t arg1;
+};
 
 struct hetero_info {
     int num_cores;
@@ -126,6 +212,15 @@ int main()
         printf("IPI_STATUS: 0x%08x\n", REG_READ32(reg_base, IPI_STATUS));
     }
     
+    /* 一次写同时唤醒两个小核 */
+    uint32_t ipi_mask = IPI_SMALL_MASK;
+    if (ioctl(fd, HETERO_IOC_SEND_IPI_MASK, &ipi_mask) < 0) {
+        perror("ioctl SEND_IPI_MASK");
+    } else {
+        printf("✓ 多播IPI发送成功 (mask=0x%02x)\n", ipi_mask);
+        usleep(10000);
+    }
+    
     /* 测试邮箱通信 */
     print_banner("测试3: 邮箱通信测试");
     printf("发送PING命令到IO核...\n");
@@ -197,6 +292,170 @@ int main()
     printf("耗时: %.4f秒\n", cpu_time);
     printf("速率: %.0f ops/秒\n", ops / cpu_time);
     
+    /* 旁路模式下SET_EVENTFD(-1)成功, 否则返回EINVAL */
+    int no_efd = -1;
+    int bypass = ioctl(fd, HETERO_IOC_SET_EVENTFD, &no_efd) == 0;
+    
+    /* 测试上调用 */
+    print_banner("测试7: 小核上调用");
+    if (bypass) {
+        printf("旁路模式, 跳过\n");
+        goto test_wait;
+    }
+    printf("让IO核发起上调用0x0200...\n");
+    REG_WRITE32(reg_base, MBOX_M2C0_DATA, 0x0200);
+    REG_WRITE32(reg_base, MBOX_M2C0_CMD, 0x0020);
+    ioctl(fd, HETERO_IOC_SEND_IPI, &core_id);
+    
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    struct hetero_upcall uc;
+    if (poll(&pfd, 1, 100) <= 0) {
+        printf("✗ 等待上调用超时!\n");
+    } else if (ioctl(fd, HETERO_IOC_UPCALL_GET, &uc) < 0) {
+        perror("ioctl UPCALL_GET");
+    } else {
+        printf("✓ 收到上调用: core=%d cmd=0x%04x seq=%u arg0=0x%08x\n",
+               uc.core_id, uc.cmd, uc.seq, uc.arg0);
+        uc.arg0 = uc.arg0 + 1;
+        uc.arg1 = 0;
+        if (ioctl(fd, HETERO_IOC_UPCALL_REPLY, &uc) < 0)
+            perror("ioctl UPCALL_REPLY");
+        else
+            printf("✓ 应答已发送 (arg0=0x%08x)\n", uc.arg0);
+    }
+    REG_WRITE32(reg_base, MBOX_C02M_STAT, 0);
+    
+test_wait:
+    /* 测试共享内存字等待: IO核把0xFC处的字加一 */
+    print_banner("测试8: 等待共享内存字");
+    struct hetero_wait_value wv = {
+        .offset = 0xFC,
+        .value = REG_READ32(shared_mem, 0xFC),
+        .mask = 0xFFFFFFFF,
+        .op = HETERO_WAIT_NE,
+        .timeout_ms = 100,
+    };
+    REG_WRITE32(reg_base, MBOX_M2C0_DATA, wv.offset);
+    REG_WRITE32(reg_base, MBOX_M2C0_CMD, 0x0030);
+    ioctl(fd, HETERO_IOC_SEND_IPI, &core_id);
+    
+    if (ioctl(fd, HETERO_IOC_WAIT_VALUE, &wv) < 0)
+        perror("ioctl WAIT_VALUE");
+    else
+        printf("✓ 共享内存字: 0x%08x -> 0x%08x\n", wv.value, wv.cur_value);
+    REG_WRITE32(reg_base, MBOX_C02M_STAT, 0);
+    
+    /* 测试定时投递: 1ms后投递给RT核, 过去的时刻应被拒绝 */
+    print_banner("测试9: 定时投递");
+    uint64_t now;
+    struct hetero_timed_msg tm = {
+        .core_id = 1,
+        .cmd = 0x0001,
+        .arg0 = 0x600D,
+    };
+    if (ioctl(fd, HETERO_IOC_GET_CYCLES, &now) < 0) {
+        perror("ioctl GET_CYCLES");
+    } else {
+        tm.when = now + TIMEBASE_HZ / 1000;
+        if (ioctl(fd, HETERO_IOC_SUBMIT_AT, &tm) < 0)
+            perror("ioctl SUBMIT_AT");
+        else
+            printf("✓ 已装填槽%d, 目标时刻%llu (seq=%u)\n",
+                   tm.slot, (unsigned long long)tm.when, tm.seq);
+        
+        tm.when = now;
+        if (ioctl(fd, HETERO_IOC_SUBMIT_AT, &tm) < 0 && errno == ETIME)
+            printf("✓ 过去的时刻被拒绝\n");
+        else
+            printf("✗ 过去的时刻未被拒绝!\n");
+        usleep(5000);
+    }
+    
+    /* 全局时基换算到CLOCK_MONOTONIC, 与clock_gettime比较 */
+    struct hetero_time_sync sync;
+    struct timespec ts;
+    if (ioctl(fd, HETERO_IOC_TIME_SYNC, &sync) < 0) {
+        perror("ioctl TIME_SYNC");
+    } else if (ioctl(fd, HETERO_IOC_GET_CYCLES, &now) == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t mono = sync.mono_ns + (now - sync.cycles) * 1000000000ULL / sync.freq_hz;
+        int64_t diff = (int64_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - mono);
+        printf("✓ 时基 %llu Hz, 换算误差 %lld ns\n",
+               (unsigned long long)sync.freq_hz, (long long)diff);
+    }
+    
+    /* 测试RT执行器配置: 切换到EDF, 模拟环境下RT核只回显应答 */
+    print_banner("测试10: RT执行器配置");
+    struct hetero_rt_config rtc = { HETERO_MSG_RT_POLICY, HETERO_RT_POLICY_EDF, 0 };
+    if (ioctl(fd, HETERO_IOC_RT_CONFIG, &rtc) < 0) {
+        perror("ioctl RT_CONFIG");
+    } else {
+        uint32_t magic = *(volatile uint32_t *)(shared_mem + RT_STATS_OFFSET);
+        printf("✓ 调度策略已设为EDF, 统计区%s\n",
+               magic == RT_STATS_MAGIC ? "有效" : "未初始化(模拟环境)");
+    }
+    
+    /* 测试RT核PWM: 三帧渐变, 每帧保持100个周期 (20kHz), 模拟环境下RT核只回显应答 */
+    print_banner("测试11: RT核PWM设定值");
+    struct hetero_pwm_frame pwm[3];
+    for (int i = 0; i < 3; i++) {
+        memset(&pwm[i], 0, sizeof(pwm[i]));
+        pwm[i].period = TIMEBASE_HZ / 20000;
+        pwm[i].enable = 0x7;
+        pwm[i].hold = 100;
+        pwm[i].width[0] = pwm[i].period * (i + 1) / 4;
+    }
+    struct hetero_pwm_batch pb = { (uintptr_t)pwm, 3, HETERO_PWM_F_FLUSH };
+    int queued = ioctl(fd, HETERO_IOC_PWM_SUBMIT, &pb);
+    if (queued < 0)
+        perror("ioctl PWM_SUBMIT");
+    else
+        printf("✓ 已提交3帧, RT核队列中%d帧\n", queued);
+    
+    /* 测试旁路模式 (insmod hetero_regs.ko bypass=1) */
+    print_banner("测试12: 旁路模式eventfd中断");
+    if (!bypass) {
+        printf("非旁路模式, 跳过\n");
+        goto done;
+    }
+    
+    int efd = eventfd(0, 0);
+    uint32_t one = 1;
+    uint64_t events;
+    if (efd < 0 || ioctl(fd, HETERO_IOC_SET_EVENTFD, &efd) < 0) {
+        perror("eventfd");
+        goto done;
+    }
+    
+    /* 清除遗留的主核IPI并使能 */
+    REG_WRITE32(reg_base, IPI_CLEAR, IPI_MAIN_MASK);
+    usleep(20000);
+    write(fd, &one, sizeof(one));
+    
+    /* 不经过ioctl: 直接写邮箱和IPI_TRIGGER */
+    REG_WRITE32(reg_base, MBOX_M2C0_DATA, 0);
+    REG_WRITE32(reg_base, MBOX_M2C0_CMD, 0x0001);
+    REG_WRITE32(reg_base, IPI_TRIGGER, 1 << 0);
+    
+    struct pollfd efd_pfd = { .fd = efd, .events = POLLIN };
+    if (poll(&efd_pfd, 1, 100) <= 0) {
+        printf("✗ 等待中断超时!\n");
+    } else {
+        read(efd, &events, sizeof(events));
+        printf("✓ 收到%llu次中断, 响应: 0x%04x\n",
+               (unsigned long long)events, REG_READ32(reg_base, MBOX_C02M_RESP));
+        
+        /* 清除状态后重新使能 */
+        REG_WRITE32(reg_base, MBOX_C02M_STAT, 0);
+        REG_WRITE32(reg_base, IPI_CLEAR, IPI_MAIN_MASK);
+        usleep(20000);
+        write(fd, &one, sizeof(one));
+    }
+    
+    ioctl(fd, HETERO_IOC_SET_EVENTFD, &no_efd);
+    close(efd);
+    
+done:
     /* 清理 */
     print_banner("测试完成");
     dump_registers(reg_base);
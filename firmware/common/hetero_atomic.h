@@ -0,0 +1,56 @@
+/* hetero_atomic.h - 共享SRAM原子操作 (soc_linux.py SharedSRAMAtomic)
+ *
+ * 先写本核上下文的operand/compare, 再读本核上下文的别名地址, 读-改-写在SRAM控制器里
+ * 完成, 对Linux和另一个小核都是原子的. 只能用于共享内存低16KB.
+ */
+
+#ifndef _HETERO_ATOMIC_H
+#define _HETERO_ATOMIC_H
+
+#include <stdint.h>
+
+#include "hetero_hw.h"
+
+#define AMO_CTX_BASE     (SHARED_MEM_BASE + 0x08000)
+#define AMO_ADD_BASE     (SHARED_MEM_BASE + 0x10000)
+#define AMO_SWAP_BASE    (SHARED_MEM_BASE + 0x20000)
+#define AMO_CAS_BASE     (SHARED_MEM_BASE + 0x30000)
+#define AMO_CTX_STRIDE   0x4000
+
+/* 上下文: 0 Linux, 1 IO核, 2 RT核; 总线上没有主设备号, 由地址区分 */
+#define AMO_CTX_SELF     (1 + CORE_ID)
+#define AMO_OPERAND      REG32(AMO_CTX_BASE + AMO_CTX_SELF * 8)
+#define AMO_COMPARE      REG32(AMO_CTX_BASE + AMO_CTX_SELF * 8 + 4)
+
+/* 共享内存地址 -> 本核上下文的别名地址 */
+#define AMO_ALIAS(base, p) \
+    REG32((base) + AMO_CTX_SELF * AMO_CTX_STRIDE + ((uintptr_t)(p) - SHARED_MEM_BASE))
+
+/* 上下文寄存器每核只有一组, 主循环和中断里都用时需关中断 */
+static inline uint32_t shm_fetch_add(volatile uint32_t *p, uint32_t val)
+{
+    AMO_OPERAND = val;
+    return AMO_ALIAS(AMO_ADD_BASE, p);
+}
+
+/* 只加不取旧值, 一次写操作 */
+static inline void shm_add(volatile uint32_t *p, uint32_t val)
+{
+    AMO_ALIAS(AMO_ADD_BASE, p) = val;
+}
+
+static inline uint32_t shm_swap(volatile uint32_t *p, uint32_t val)
+{
+    AMO_OPERAND = val;
+    return AMO_ALIAS(AMO_SWAP_BASE, p);
+}
+
+/* 返回旧值, 等于expected即表示交换成功 */
+static inline uint32_t shm_cmpxchg(volatile uint32_t *p, uint32_t expected, uint32_t val)
+{
+    AMO_COMPARE = expected;
+    AMO_OPERAND = val;
+    return AMO_ALIAS(AMO_CAS_BASE, p);
+}
+
+#endif /* _HETERO_ATOMIC_H */
@@ -0,0 +1,148 @@
+/* hetero_hw.h - 小核固件使用的硬件定义
+ *
+ * 寄存器布局与 driver_v3/hetero_regs.c 保持一致,
+ * 实际地址以构建生成的 build/<board>/csr.csv 为准
+ */
+
+#ifndef _HETERO_HW_H
+#define _HETERO_HW_H
+
+#include <stdint.h>
+
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+/* 核间通信寄存器 */
+#define HETERO_CSR_BASE          0xf0002000UL
+
+#define IPI_STATUS               REG32(HETERO_CSR_BASE + 0x00)
+#define IPI_TRIGGER              REG32(HETERO_CSR_BASE + 0x04)
+#define IPI_CLEAR                REG32(HETERO_CSR_BASE + 0x08)
+#define IPI_ENABLE               REG32(HETERO_CSR_BASE + 0x0C)
+
+#define MBOX_MAIN_TO_CORE_CMD(n)   REG32(HETERO_CSR_BASE + 0x10 + (n) * 0x10)
+#define MBOX_MAIN_TO_CORE_DATA(n)  REG32(HETERO_CSR_BASE + 0x14 + (n) * 0x10)
+#define MBOX_CORE_TO_MAIN_STAT(n)  REG32(HETERO_CSR_BASE + 0x18 + (n) * 0x10)
+#define MBOX_CORE_TO_MAIN_RESP(n)  REG32(HETERO_CSR_BASE + 0x1C + (n) * 0x10)
+
+#define HW_MUTEX_REQUEST         REG32(HETERO_CSR_BASE + 0x30)
+#define HW_MUTEX_STATUS          REG32(HETERO_CSR_BASE + 0x34)
+#define HW_MUTEX_RELEASE         REG32(HETERO_CSR_BASE + 0x38)
+
+#define SMALL_CORE_RESET         REG32(HETERO_CSR_BASE + 0x3C)
+
+/* 全局时基 (与mtime同一计数器) 和邮箱时间戳, 见 driver_v3/hetero_regs.h */
+#define GLOBAL_TIME_HI           REG32(HETERO_CSR_BASE + 0x40)
+#define GLOBAL_TIME_LO           REG32(HETERO_CSR_BASE + 0x44)
+#define MBOX_TS_SEND(n)          REG32(HETERO_CSR_BASE + 0x48 + (n) * 0x10)
+#define MBOX_TS_TAKE(n)          REG32(HETERO_CSR_BASE + 0x4C + (n) * 0x10)
+#define MBOX_TS_RESP(n)          REG32(HETERO_CSR_BASE + 0x50 + (n) * 0x10)
+#define MBOX_TS_ACK(n)           REG32(HETERO_CSR_BASE + 0x54 + (n) * 0x10)
+
+/* 小核总线等待周期/传输数 和 总线QoS开关 */
+#define BUS_WAIT(n)              REG32(HETERO_CSR_BASE + 0x68 + (n) * 8)
+#define BUS_XFER(n)              REG32(HETERO_CSR_BASE + 0x6C + (n) * 8)
+#define BUS_QOS_CTRL             REG32(HETERO_CSR_BASE + 0x78)
+
+/* L2分区/旁路控制和命中/未命中计数 (n = 0 IO核, 1 RT核, 2 Linux) */
+#define L2_CTRL                  REG32(HETERO_CSR_BASE + 0x7C)
+#define L2_HIT(n)                REG32(HETERO_CSR_BASE + 0x80 + (n) * 8)
+#define L2_MISS(n)               REG32(HETERO_CSR_BASE + 0x84 + (n) * 8)
+
+/*
+ * 中断路由矩阵: 源n锁存到RT_PENDING后拉高 externalInterruptArray[1+n],
+ * 写IRQ_ROUTE_RT_CLEAR清除; 源号见构建生成的常量IRQ_ROUTE_<名字>
+ */
+#define IRQ_ROUTE_RAW            REG32(HETERO_CSR_BASE + 0x98)
+#define IRQ_ROUTE_POLARITY       REG32(HETERO_CSR_BASE + 0x9C)
+#define IRQ_ROUTE_RT             REG32(HETERO_CSR_BASE + 0xA0)
+#define IRQ_ROUTE_RT_PENDING     REG32(HETERO_CSR_BASE + 0xA4)
+#define IRQ_ROUTE_RT_CLEAR       REG32(HETERO_CSR_BASE + 0xA8)
+#define IRQ_ROUTE_MAIN           REG32(HETERO_CSR_BASE + 0xAC)
+#define IRQ_ROUTE_MAIN_PENDING   REG32(HETERO_CSR_BASE + 0xB0)
+#define IRQ_ROUTE_MAIN_CLEAR     REG32(HETERO_CSR_BASE + 0xB4)
+#define IRQ_ROUTE_STAMP          REG32(HETERO_CSR_BASE + 0xB8)
+#define IRQ_ROUTE_NUM_SOURCES    16
+
+/* IPI位分配: bit0/bit1 -> 小核, bit2-5 -> Linux hart0-3 */
+#define HETERO_NUM_SMALL_CORES   2
+#define IPI_CORE_BIT(n)          (1u << (n))
+#define IPI_HART_BIT(h)          (1u << (2 + (h)))
+#define IPI_MAIN_BIT             IPI_HART_BIT(0)   /* 默认通知hart0 */
+#define IPI_SMALL_MASK           0x03u
+
+/* 共享内存 32KB */
+#define SHARED_MEM_BASE          0x80100000UL
+#define SHARED_MEM_SIZE          0x8000
+#define SHARED_VRING_OFFSET      0x4000   /* 高16KB: remoteproc vring */
+
+/* 小核私有内存 1MB, 复位向量即基址 */
+#define CORE_MEM_BASE(n)         (0x80200000UL + (n) * 0x100000UL)
+#define CORE_MEM_SIZE            0x100000
+#define CORE_VDEV_BUF_OFFSET     0xC0000  /* 末尾256KB: rpmsg缓冲区 */
+
+/* 主核给出的缓冲区 [addr, addr+len) 是否在共享内存内 */
+static inline int shm_range_ok(uint32_t addr, uint32_t len)
+{
+    return addr >= SHARED_MEM_BASE && len <= SHARED_MEM_SIZE &&
+           addr - SHARED_MEM_BASE <= SHARED_MEM_SIZE - len;
+}
+
+/* 内存屏障, RV32I即可使用 */
+static inline void mb(void)
+{
+    __asm__ volatile ("fence" ::: "memory");
+}
+
+/*
+ * RT核带数据缓存, 访问共享内存前需作废D-Cache
+ * (VexRiscv自定义指令, IO核没有D-Cache, 为空操作)
+ */
+static inline void dcache_invalidate(void)
+{
+#ifdef CORE_HAS_DCACHE
+    __asm__ volatile (".word 0x500F" ::: "memory");
+#endif
+}
+
+/* 打开外部中断等待, 只用来唤醒wfi, 不进入trap */
+static inline void irq_wait_setup(void)
+{
+    uint32_t mie_meie = 1u << 11;
+
+    __asm__ volatile ("csrw 0xBC0, %0" :: "r"(1u));       /* 外部中断0: IPI */
+    __asm__ volatile ("csrs mie, %0" :: "r"(mie_meie));
+}
+
+static inline void wfi(void)
+{
+    __asm__ volatile ("wfi");
+}
+
+/* 读全局时基: 高低字不是同一拍采样, 高字变化时重读 */
+static inline uint64_t global_time_read(void)
+{
+    uint32_t hi, lo;
+
+    do {
+        hi = GLOBAL_TIME_HI;
+        lo = GLOBAL_TIME_LO;
+    } while (hi != GLOBAL_TIME_HI);
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* 通知主核 */
+static inline void ipi_notify_main(void)
+{
+    mb();
+    IPI_TRIGGER = IPI_MAIN_BIT;
+}
+
+/* 写共享内存中的标志字并通知主核, 唤醒HETERO_IOC_WAIT_VALUE的等待者 */
+static inline void shm_store_notify(volatile uint32_t *word, uint32_t val)
+{
+    *word = val;
+    ipi_notify_main();
+}
+
+#endif /* _HETERO_HW_H */
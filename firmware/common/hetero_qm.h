@@ -0,0 +1,48 @@
+/* hetero_qm.h - 硬件句柄队列 (soc_linux.py QueueManager)
+ *
+ * 入队一次写, 出队一次读, 不需要互斥锁. 句柄一般是共享内存缓冲区的总线地址
+ */
+
+#ifndef _HETERO_QM_H
+#define _HETERO_QM_H
+
+#include <stdint.h>
+
+#include "hetero_hw.h"
+
+#define QUEUE_MGR_BASE          0x80141000UL
+#define QM_NUM_QUEUES           8
+#define QM_DEPTH                64
+#define QM_EMPTY                0xFFFFFFFFu
+
+#define QM_DATA(q)              REG32(QUEUE_MGR_BASE + (q) * 16)
+#define QM_COUNT(q)             REG32(QUEUE_MGR_BASE + (q) * 16 + 4)
+#define QM_THRESH(q)            REG32(QUEUE_MGR_BASE + (q) * 16 + 8)
+#define QM_CFG(q)               REG32(QUEUE_MGR_BASE + (q) * 16 + 12)
+
+#define QM_CFG_OVERFLOW         0x100
+
+/* 入队, 队列满时句柄被丢弃并置溢出位, 需要时先查QM_COUNT */
+static inline void qm_push(int q, uint32_t handle)
+{
+    mb();   /* 句柄指向的数据先写完 */
+    QM_DATA(q) = handle;
+}
+
+/* 出队, 队列空返回QM_EMPTY */
+static inline uint32_t qm_pop(int q)
+{
+    uint32_t handle = QM_DATA(q);
+
+    dcache_invalidate();
+    return handle;
+}
+
+/* 句柄数达到thresh时向ipi_bits指定的核发IPI, thresh=0关闭 */
+static inline void qm_config(int q, uint32_t thresh, uint32_t ipi_bits)
+{
+    QM_THRESH(q) = thresh;
+    QM_CFG(q) = ipi_bits & 0xFF;
+}
+
+#endif /* _HETERO_QM_H */
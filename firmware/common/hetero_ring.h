@@ -0,0 +1,85 @@
+/* hetero_ring.h - 共享内存消息环 (布局与 driver_v3/hetero_regs.h 一致)
+ *
+ *   TX环: 主核 -> 小核, 主核写head, 小核写tail
+ *   RX环: 小核 -> 主核, 小核写head, 主核写tail
+ *   UP环:    小核 -> 主核的上调用请求
+ *   REPLY环: 主核 -> 小核的上调用应答
+ */
+
+#ifndef _HETERO_RING_H
+#define _HETERO_RING_H
+
+#include <stdint.h>
+
+#include "hetero_hw.h"
+
+#define HETERO_RING_SLOTS       16
+#define HETERO_MSG_RESP         0x8000
+#define HETERO_MSG_ERR          0x4000
+
+/* 主核广播的配置更新: arg0=配置数据总线地址, arg1=配置代数 */
+#define HETERO_MSG_CFG_UPDATE   0x00C0
+
+#define SHARED_RING_OFFSET      0x0100
+
+struct hetero_msg {
+    uint32_t cmd;
+    uint32_t seq;
+    uint32_t arg0;
+    uint32_t arg1;
+};
+
+struct hetero_ring {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t reserved[2];
+    struct hetero_msg slot[HETERO_RING_SLOTS];
+};
+
+#define RING_TX(n) ((volatile struct hetero_ring *)(SHARED_MEM_BASE + SHARED_RING_OFFSET + \
+                    (n) * 2 * sizeof(struct hetero_ring)))
+#define RING_RX(n) ((volatile struct hetero_ring *)(SHARED_MEM_BASE + SHARED_RING_OFFSET + \
+                    ((n) * 2 + 1) * sizeof(struct hetero_ring)))
+#define RING_UP(n) RING_TX(HETERO_NUM_SMALL_CORES + (n))
+#define RING_REPLY(n) RING_RX(HETERO_NUM_SMALL_CORES + (n))
+
+/* 出队, 环空返回0 */
+static inline int ring_pop(volatile struct hetero_ring *ring, struct hetero_msg *msg)
+{
+    uint32_t tail;
+
+    dcache_invalidate();
+    tail = ring->tail;
+    if (tail == ring->head)
+        return 0;
+
+    mb();
+    msg->cmd  = ring->slot[tail % HETERO_RING_SLOTS].cmd;
+    msg->seq  = ring->slot[tail % HETERO_RING_SLOTS].seq;
+    msg->arg0 = ring->slot[tail % HETERO_RING_SLOTS].arg0;
+    msg->arg1 = ring->slot[tail % HETERO_RING_SLOTS].arg1;
+    mb();
+    ring->tail = tail + 1;
+    return 1;
+}
+
+/* 入队, 环满返回0 */
+static inline int ring_push(volatile struct hetero_ring *ring, const struct hetero_msg *msg)
+{
+    uint32_t head;
+
+    dcache_invalidate();
+    head = ring->head;
+    if (head - ring->tail >= HETERO_RING_SLOTS)
+        return 0;
+
+    ring->slot[head % HETERO_RING_SLOTS].cmd  = msg->cmd;
+    ring->slot[head % HETERO_RING_SLOTS].seq  = msg->seq;
+    ring->slot[head % HETERO_RING_SLOTS].arg0 = msg->arg0;
+    ring->slot[head % HETERO_RING_SLOTS].arg1 = msg->arg1;
+    mb();
+    ring->head = head + 1;
+    return 1;
+}
+
+#endif /* _HETERO_RING_H */
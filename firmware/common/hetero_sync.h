@@ -0,0 +1,71 @@
+/* hetero_sync.h - 硬件同步块: 计数信号量和事件标志组 (soc_linux.py HardwareSync)
+ *
+ * 每个操作都是一次总线访问, 不需要关中断
+ */
+
+#ifndef _HETERO_SYNC_H
+#define _HETERO_SYNC_H
+
+#include <stdint.h>
+
+#include "hetero_hw.h"
+
+#define HW_SYNC_BASE            0x80140000UL
+#define HW_SYNC_NUM_SEMS        64
+#define HW_SYNC_NUM_GROUPS      16
+
+#define SEM_TAKE(n)             REG32(HW_SYNC_BASE + 0x000 + (n) * 4)
+#define SEM_GIVE(n)             REG32(HW_SYNC_BASE + 0x400 + (n) * 4)
+#define EVT_SET(g)              REG32(HW_SYNC_BASE + 0x800 + (g) * 16)
+#define EVT_CLR(g)              REG32(HW_SYNC_BASE + 0x804 + (g) * 16)
+#define EVT_MASK(g)             REG32(HW_SYNC_BASE + 0x808 + (g) * 16)
+#define EVT_CFG(g)              REG32(HW_SYNC_BASE + 0x80C + (g) * 16)
+
+#define EVT_CFG_ALL             0x100    /* 掩码内全部置位才触发 */
+
+/* 计数非零则减一, 成功返回1 */
+static inline int sem_try_take(int n)
+{
+    return SEM_TAKE(n) != 0;
+}
+
+static inline void sem_give(int n, uint32_t count)
+{
+    SEM_GIVE(n) = count;
+}
+
+static inline uint32_t sem_count(int n)
+{
+    return SEM_GIVE(n);
+}
+
+/* 等待信号量 (信号量本身不产生中断, 需要睡眠等待时配合事件组使用) */
+static inline void sem_take(int n)
+{
+    while (!sem_try_take(n))
+        ;
+}
+
+static inline void evt_set(int g, uint32_t bits)
+{
+    EVT_SET(g) = bits;
+}
+
+static inline void evt_clear(int g, uint32_t bits)
+{
+    EVT_CLR(g) = bits;
+}
+
+static inline uint32_t evt_get(int g)
+{
+    return EVT_SET(g);
+}
+
+/* 条件满足时向 ipi_bits 指定的核发IPI; all=1 时要求掩码内全部置位 */
+static inline void evt_config(int g, uint32_t mask, uint32_t ipi_bits, int all)
+{
+    EVT_MASK(g) = mask;
+    EVT_CFG(g) = (ipi_bits & 0xFF) | (all ? EVT_CFG_ALL : 0);
+}
+
+#endif /* _HETERO_SYNC_H */
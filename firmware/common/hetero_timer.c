@@ -0,0 +1,74 @@
+/* hetero_timer.c - 周期任务释放 */
+
+#include "hetero_timer.h"
+
+static struct periodic_task *tasks[PERIODIC_MAX_TASKS];
+static int num_tasks;
+
+int periodic_add(struct periodic_task *task, uint32_t period, uint32_t offset)
+{
+    if (num_tasks >= PERIODIC_MAX_TASKS || !task->fn || !period)
+        return -1;
+
+    task->period = period;
+    task->next = offset;        /* periodic_start 时加上起始时刻 */
+    task->releases = 0;
+    task->overruns = 0;
+    tasks[num_tasks++] = task;
+
+    return 0;
+}
+
+static void periodic_arm(void)
+{
+    uint64_t earliest = TIMER_NEVER;
+    int i;
+
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i]->next < earliest)
+            earliest = tasks[i]->next;
+    }
+
+    mtimecmp_write(earliest);
+}
+
+void periodic_start(void)
+{
+    uint64_t now = mtime_read();
+    int i;
+
+    for (i = 0; i < num_tasks; i++)
+        tasks[i]->next += now;
+
+    periodic_arm();
+    timer_wait_setup();
+}
+
+int periodic_run(void)
+{
+    struct periodic_task *task;
+    uint64_t now = mtime_read();
+    int count = 0;
+    int i;
+
+    /* 按添加顺序执行, 先添加的优先 */
+    for (i = 0; i < num_tasks; i++) {
+        task = tasks[i];
+        if (now < task->next)
+            continue;
+
+        task->fn(task->arg);
+        task->releases++;
+        count++;
+
+        task->next += task->period;
+        now = mtime_read();
+        while (task->next <= now) {
+            task->next += task->period;
+            task->overruns++;
+        }
+    }
+
+    periodic_arm();
+    return count;
+}
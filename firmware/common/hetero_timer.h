@@ -0,0 +1,120 @@
+/* hetero_timer.h - 小核机器定时器和周期任务释放 (soc_linux.py CoreTimer)
+ *
+ * mtime每个系统时钟加一, 与Linux同一时基; mtime >= 本核mtimecmp时
+ * timerInterrupt置位, 与IPI一样只用来唤醒wfi, 不进入trap
+ */
+
+#ifndef _HETERO_TIMER_H
+#define _HETERO_TIMER_H
+
+#include <stdint.h>
+
+#include "hetero_hw.h"
+#include "hetero_ring.h"
+
+#define CORE_TIMER_BASE         0x80142000UL
+
+#define MTIME_LO                REG32(CORE_TIMER_BASE + 0x00)   /* 读LO同时锁存HI */
+#define MTIME_HI                REG32(CORE_TIMER_BASE + 0x04)
+#define MTIMECMP_LO(n)          REG32(CORE_TIMER_BASE + 0x08 + (n) * 8)
+#define MTIMECMP_HI(n)          REG32(CORE_TIMER_BASE + 0x0C + (n) * 8)
+
+/* 时基频率, 与板级sys_clk_freq一致 (Makefile SYS_CLK_FREQ) */
+#ifndef SYS_CLK_FREQ
+#define SYS_CLK_FREQ            100000000u
+#endif
+#define TIMER_TICKS_PER_US      (SYS_CLK_FREQ / 1000000u)
+
+#define TIMER_NEVER             0xFFFFFFFFFFFFFFFFULL
+
+static inline uint64_t mtime_read(void)
+{
+    uint32_t lo = MTIME_LO;
+
+    return ((uint64_t)MTIME_HI << 32) | lo;
+}
+
+/* 先把低32位写成全1, 避免更新过程中出现比新旧值都小的中间值 */
+static inline void mtimecmp_write(uint64_t t)
+{
+    MTIMECMP_LO(CORE_ID) = 0xFFFFFFFFu;
+    MTIMECMP_HI(CORE_ID) = (uint32_t)(t >> 32);
+    MTIMECMP_LO(CORE_ID) = (uint32_t)t;
+}
+
+/* 打开定时器中断等待 (mie.MTIE) */
+static inline void timer_wait_setup(void)
+{
+    __asm__ volatile ("csrs mie, %0" :: "r"(1u << 7));
+}
+
+/* mip.MTIP: 本核定时器已到期 */
+static inline int timer_pending(void)
+{
+    uint32_t mip;
+
+    __asm__ volatile ("csrr %0, mip" : "=r"(mip));
+    return (mip >> 7) & 1;
+}
+
+/*
+ * 定时投递邮箱 (soc_linux.py TimedMailbox): 主核预先装填消息和目标时刻,
+ * 到达该时刻时硬件才把槽标记为已投递并发IPI, 取走后写CTRL释放
+ */
+#define TIMED_MBOX_BASE         0x80143000UL
+#define TMBOX_SLOTS             4       /* 每个小核 */
+#define TMBOX_SLOT_BASE(n, s)   (TIMED_MBOX_BASE + ((n) * TMBOX_SLOTS + (s)) * 0x20)
+#define TMBOX_WORD(n, s, w)     REG32(TMBOX_SLOT_BASE(n, s) + (w) * 4)
+#define TMBOX_CTRL(n, s)        REG32(TMBOX_SLOT_BASE(n, s) + 0x18)
+#define TMBOX_FIRED             REG32(TIMED_MBOX_BASE + 0x1C)
+#define TMBOX_CTRL_FREE         0x2
+
+/* 取一条已投递的定时消息, 没有返回0 */
+static inline int tmbox_pop(struct hetero_msg *msg)
+{
+    uint32_t fired = TMBOX_FIRED >> (CORE_ID * TMBOX_SLOTS);
+    int s;
+
+    for (s = 0; s < TMBOX_SLOTS; s++) {
+        if (!(fired & (1u << s)))
+            continue;
+
+        msg->cmd = TMBOX_WORD(CORE_ID, s, 0);
+        msg->seq = TMBOX_WORD(CORE_ID, s, 1);
+        msg->arg0 = TMBOX_WORD(CORE_ID, s, 2);
+        msg->arg1 = TMBOX_WORD(CORE_ID, s, 3);
+        TMBOX_CTRL(CORE_ID, s) = TMBOX_CTRL_FREE;
+
+        /* 消息引用的共享内存数据在投递前已写好 */
+        dcache_invalidate();
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * 周期任务: 释放时刻按 起始时刻 + k*period 推进, 不累积误差;
+ * 执行晚于下一个释放时刻时跳过错过的释放并计入overruns
+ */
+struct periodic_task {
+    void (*fn)(void *arg);
+    void *arg;
+    uint32_t period;            /* 定时器周期数 */
+    uint64_t next;              /* 下次释放时刻 */
+    uint32_t releases;
+    uint32_t overruns;
+};
+
+#define PERIODIC_MAX_TASKS      8
+
+/* 添加任务, 首次释放在 periodic_start 之后offset个周期; 表满返回-1 */
+int periodic_add(struct periodic_task *task, uint32_t period, uint32_t offset);
+
+/* 以当前时刻为起点开始释放 */
+void periodic_start(void);
+
+/* 执行所有已到期的任务并重新设置mtimecmp, 返回执行的任务数 */
+int periodic_run(void);
+
+#endif /* _HETERO_TIMER_H */
@@ -0,0 +1,96 @@
+/* hetero_upcall.c - 小核向主核发起的同步上调用 */
+
+#include <string.h>
+
+#include "hetero_hw.h"
+#include "hetero_upcall.h"
+
+static uint32_t upcall_seq;
+
+int hetero_upcall(uint32_t cmd, uint32_t arg0, uint32_t arg1, struct hetero_msg *reply)
+{
+    struct hetero_msg msg;
+
+    msg.cmd = cmd;
+    /* seq=0 留给不等应答的通知 */
+    if (!++upcall_seq)
+        upcall_seq = 1;
+    msg.seq = upcall_seq;
+    msg.arg0 = arg0;
+    msg.arg1 = arg1;
+
+    while (!ring_push(RING_UP(CORE_ID), &msg))
+        ipi_notify_main();
+    ipi_notify_main();
+
+    /*
+     * 等待应答; 不清除自己的IPI位, 留给主循环处理TX环.
+     * IPI位已置位时wfi会立即返回, 相当于轮询REPLY环
+     */
+    for (;;) {
+        while (!ring_pop(RING_REPLY(CORE_ID), &msg))
+            wfi();
+
+        /* 丢弃seq不匹配的陈旧应答 */
+        if (msg.seq == upcall_seq)
+            break;
+    }
+
+    if (reply)
+        *reply = msg;
+
+    if (msg.cmd & HETERO_MSG_ERR)
+        return -(int)msg.arg0;
+    return 0;
+}
+
+int hetero_upcall_post(uint32_t cmd, uint32_t arg0, uint32_t arg1)
+{
+    struct hetero_msg msg;
+
+    msg.cmd = cmd;
+    msg.seq = 0;
+    msg.arg0 = arg0;
+    msg.arg1 = arg1;
+
+    if (!ring_push(RING_UP(CORE_ID), &msg))
+        return -1;
+
+    ipi_notify_main();
+    return 0;
+}
+
+uint32_t hetero_shm_alloc(uint32_t size)
+{
+    struct hetero_msg reply;
+
+    if (hetero_upcall(HETERO_UPCALL_BUF_ALLOC, size, 0, &reply))
+        return 0;
+    return reply.arg0;
+}
+
+void hetero_shm_free(uint32_t addr, uint32_t size)
+{
+    hetero_upcall(HETERO_UPCALL_BUF_FREE, addr, size, 0);
+}
+
+int hetero_log(const char *str)
+{
+    uint32_t len = strlen(str);
+    uint32_t addr;
+    int ret;
+
+    if (!len)
+        return 0;
+
+    addr = hetero_shm_alloc(len);
+    if (!addr)
+        return -12;  /* ENOMEM */
+
+    memcpy((void *)(uintptr_t)addr, str, len);
+    mb();
+    ret = hetero_upcall(HETERO_UPCALL_LOG, addr, len, 0);
+    hetero_shm_free(addr, len);
+
+    return ret;
+}
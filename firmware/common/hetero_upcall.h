@@ -0,0 +1,36 @@
+/* hetero_upcall.h - 小核向主核发起的同步上调用
+ *
+ * 请求放入UP环并置位主核IPI, 然后等待REPLY环中seq匹配的应答.
+ * 同一时刻只有一个未完成的上调用, 不能在中断里调用.
+ */
+
+#ifndef _HETERO_UPCALL_H
+#define _HETERO_UPCALL_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+/* 内置上调用命令 (与 driver_v3/hetero_regs.h 一致) */
+#define HETERO_UPCALL_BUF_ALLOC 0x0101   /* arg0=大小, 应答arg0=总线地址 */
+#define HETERO_UPCALL_BUF_FREE  0x0102   /* arg0=总线地址, arg1=大小 */
+#define HETERO_UPCALL_LOG       0x0103   /* arg0=字符串总线地址, arg1=长度 */
+#define HETERO_UPCALL_RT_OVERRUN 0x0104  /* arg0=任务号, arg1=响应时间(周期, 0=错过释放) */
+
+/* 发起上调用, 成功返回0并填写reply(可为NULL), 主核出错返回负的errno */
+int hetero_upcall(uint32_t cmd, uint32_t arg0, uint32_t arg1, struct hetero_msg *reply);
+
+/*
+ * 只通知不等应答 (seq=0, 主核不回应答), 可以在实时路径里调用;
+ * UP环满时直接丢弃, 返回-1
+ */
+int hetero_upcall_post(uint32_t cmd, uint32_t arg0, uint32_t arg1);
+
+/* 从主核的共享内存缓冲池分配/释放, 失败返回0 */
+uint32_t hetero_shm_alloc(uint32_t size);
+void hetero_shm_free(uint32_t addr, uint32_t size);
+
+/* 通过主核内核日志打印字符串 */
+int hetero_log(const char *str);
+
+#endif /* _HETERO_UPCALL_H */
@@ -0,0 +1,167 @@
+/* rpmsg_lite.c - 小核侧的最小rpmsg实现 */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "hetero_hw.h"
+#include "rsc_table.h"
+#include "rpmsg_lite.h"
+
+struct vring_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+struct vring_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+};
+
+struct vring_used_elem {
+    uint32_t id;
+    uint32_t len;
+};
+
+struct vring_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct vring_used_elem ring[];
+};
+
+struct vring {
+    uint32_t num;
+    volatile struct vring_desc  *desc;
+    volatile struct vring_avail *avail;
+    volatile struct vring_used  *used;
+    uint16_t last_avail;
+};
+
+struct rpmsg_ns_msg {
+    char     name[RPMSG_NAME_SIZE];
+    uint32_t addr;
+    uint32_t flags;
+} __attribute__((packed));
+
+static struct vring rx_vring;   /* vring0: 发往Linux */
+static struct vring tx_vring;   /* vring1: 来自Linux */
+static uint32_t local_addr;
+static rpmsg_rx_cb_t rx_cb;
+
+/* 与Linux vring_init()相同的布局 */
+static void vring_setup(struct vring *vr, volatile struct fw_rsc_vdev_vring *rsc)
+{
+    uintptr_t base = rsc->da;
+    uintptr_t used;
+
+    vr->num   = rsc->num;
+    vr->desc  = (volatile struct vring_desc *)base;
+    vr->avail = (volatile struct vring_avail *)(base + vr->num * sizeof(struct vring_desc));
+    used = (uintptr_t)&vr->avail->ring[vr->num] + sizeof(uint16_t);
+    used = (used + rsc->align - 1) & ~((uintptr_t)rsc->align - 1);
+    vr->used  = (volatile struct vring_used *)used;
+    vr->last_avail = 0;
+}
+
+/* 取一个可用描述符, 没有时返回-1 */
+static int vring_get_avail(struct vring *vr)
+{
+    int head;
+
+    dcache_invalidate();
+    if (vr->avail->idx == vr->last_avail)
+        return -1;
+
+    mb();
+    head = vr->avail->ring[vr->last_avail % vr->num];
+    vr->last_avail++;
+    return head;
+}
+
+static void vring_add_used(struct vring *vr, int head, uint32_t len)
+{
+    uint16_t idx = vr->used->idx;
+
+    vr->used->ring[idx % vr->num].id  = head;
+    vr->used->ring[idx % vr->num].len = len;
+    mb();
+    vr->used->idx = idx + 1;
+}
+
+int rpmsg_lite_send(uint32_t dst, const void *data, uint32_t len)
+{
+    volatile struct vring_desc *desc;
+    struct rpmsg_hdr *hdr;
+    int head;
+
+    if (len > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr))
+        return -1;
+
+    head = vring_get_avail(&rx_vring);
+    if (head < 0)
+        return -1;
+
+    desc = &rx_vring.desc[head];
+    hdr = (struct rpmsg_hdr *)(uintptr_t)desc->addr;
+    hdr->src = local_addr;
+    hdr->dst = dst;
+    hdr->reserved = 0;
+    hdr->len = len;
+    hdr->flags = 0;
+    memcpy(hdr->data, data, len);
+
+    vring_add_used(&rx_vring, head, sizeof(struct rpmsg_hdr) + len);
+    ipi_notify_main();
+    return 0;
+}
+
+int rpmsg_lite_poll(void)
+{
+    volatile struct vring_desc *desc;
+    struct rpmsg_hdr *hdr;
+    int count = 0;
+    int head;
+
+    while ((head = vring_get_avail(&tx_vring)) >= 0) {
+        desc = &tx_vring.desc[head];
+        hdr = (struct rpmsg_hdr *)(uintptr_t)desc->addr;
+
+        if (hdr->dst == local_addr && rx_cb)
+            rx_cb(hdr->src, hdr->data, hdr->len);
+
+        vring_add_used(&tx_vring, head, desc->len);
+        count++;
+    }
+
+    /* 归还缓冲区, Linux侧可以继续发送 */
+    if (count)
+        ipi_notify_main();
+
+    return count;
+}
+
+void rpmsg_lite_init(const char *name, uint32_t addr, rpmsg_rx_cb_t cb)
+{
+    struct rpmsg_ns_msg ns;
+
+    /* Linux的virtio_rpmsg_bus准备好vring后置位DRIVER_OK */
+    do {
+        wfi();
+        dcache_invalidate();
+    } while (!(resource_table.vdev.status & VIRTIO_CONFIG_S_DRIVER_OK));
+
+    vring_setup(&rx_vring, &resource_table.vdev.vring[0]);
+    vring_setup(&tx_vring, &resource_table.vdev.vring[1]);
+    local_addr = addr;
+    rx_cb = cb;
+
+    /* 名字服务通告, Linux据此创建rpmsg通道 */
+    memset(&ns, 0, sizeof(ns));
+    strncpy(ns.name, name, RPMSG_NAME_SIZE - 1);
+    ns.addr = addr;
+    ns.flags = 0;   /* RPMSG_NS_CREATE */
+    while (rpmsg_lite_send(RPMSG_NS_ADDR, &ns, sizeof(ns)) < 0)
+        wfi();
+}
@@ -0,0 +1,36 @@
+/* rpmsg_lite.h - 小核侧的最小rpmsg实现 (virtio设备端)
+ *
+ * vring0: Linux接收 (小核从avail取空缓冲区, 填好后放入used)
+ * vring1: Linux发送 (小核从avail取消息, 处理后放回used)
+ */
+
+#ifndef _RPMSG_LITE_H
+#define _RPMSG_LITE_H
+
+#include <stdint.h>
+
+#define RPMSG_NS_ADDR        53
+#define RPMSG_NAME_SIZE      32
+
+struct rpmsg_hdr {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t reserved;
+    uint16_t len;
+    uint16_t flags;
+    uint8_t  data[];
+} __attribute__((packed));
+
+/* 收到消息的回调: src为Linux端点地址 */
+typedef void (*rpmsg_rx_cb_t)(uint32_t src, void *data, uint32_t len);
+
+/* 等待Linux完成virtio初始化, 然后通告名字服务 */
+void rpmsg_lite_init(const char *name, uint32_t addr, rpmsg_rx_cb_t cb);
+
+/* 处理vring1上Linux发来的所有消息, 返回处理条数 */
+int rpmsg_lite_poll(void);
+
+/* 发送一条消息到Linux端点dst, 没有空缓冲区时返回-1 */
+int rpmsg_lite_send(uint32_t dst, const void *data, uint32_t len);
+
+#endif /* _RPMSG_LITE_H */
@@ -0,0 +1,34 @@
+/* rsc_table.c - 小核固件资源表, 放在.resource_table段供remoteproc解析 */
+
+#include <stddef.h>
+
+#include "hetero_hw.h"
+#include "rsc_table.h"
+
+#ifndef CORE_ID
+#error "CORE_ID must be defined"
+#endif
+
+/* 与hetero_rproc.c一致: 每个小核8KB vring区域, 每条vring一页 */
+#define VRING_DA(n) \
+    (SHARED_MEM_BASE + SHARED_VRING_OFFSET + CORE_ID * 0x2000 + (n) * 0x1000)
+
+__attribute__((section(".resource_table"), used))
+volatile struct hetero_rsc_table resource_table = {
+    .ver    = 1,
+    .num    = 1,
+    .offset = { offsetof(struct hetero_rsc_table, vdev_type) },
+
+    .vdev_type = RSC_VDEV,
+    .vdev = {
+        .id            = VIRTIO_ID_RPMSG,
+        .notifyid      = 0,
+        .dfeatures     = 1 << VIRTIO_RPMSG_F_NS,
+        .config_len    = 0,
+        .num_of_vrings = 2,
+        .vring = {
+            { VRING_DA(0), RPMSG_VRING_ALIGN, RPMSG_VRING_NUM, 0, 0 },
+            { VRING_DA(1), RPMSG_VRING_ALIGN, RPMSG_VRING_NUM, 1, 0 },
+        },
+    },
+};
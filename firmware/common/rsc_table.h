@@ -0,0 +1,50 @@
+/* rsc_table.h - remoteproc资源表 (布局与linux/remoteproc.h一致) */
+
+#ifndef _RSC_TABLE_H
+#define _RSC_TABLE_H
+
+#include <stdint.h>
+
+#define RSC_VDEV                 3
+#define VIRTIO_ID_RPMSG          7
+#define VIRTIO_RPMSG_F_NS        0
+#define VIRTIO_CONFIG_S_DRIVER_OK 4
+
+#define RPMSG_VRING_NUM          16
+#define RPMSG_VRING_ALIGN        16
+#define RPMSG_BUF_SIZE           512
+
+struct fw_rsc_vdev_vring {
+    uint32_t da;
+    uint32_t align;
+    uint32_t num;
+    uint32_t notifyid;
+    uint32_t pa;
+};
+
+struct fw_rsc_vdev {
+    uint32_t id;
+    uint32_t notifyid;
+    uint32_t dfeatures;
+    uint32_t gfeatures;
+    uint32_t config_len;
+    uint8_t  status;
+    uint8_t  num_of_vrings;
+    uint8_t  reserved[2];
+    struct fw_rsc_vdev_vring vring[2];
+};
+
+struct hetero_rsc_table {
+    uint32_t ver;
+    uint32_t num;
+    uint32_t reserved[2];
+    uint32_t offset[1];
+
+    uint32_t vdev_type;
+    struct fw_rsc_vdev vdev;
+};
+
+/* 由Linux在加载时填写vdev状态 */
+extern volatile struct hetero_rsc_table resource_table;
+
+#endif /* _RSC_TABLE_H */
@@ -0,0 +1,332 @@
+/* io_eth.c - IO核以太网接收预处理, 帧从MAC接收槽过滤/分类后拷进主核的接收环 */
+
+#include "hetero_hw.h"
+#include "io_eth.h"
+
+#ifdef IO_ETH_BASE
+
+#define ETH_RX_LEVEL            REG32(IO_ETH_BASE + 0x00)
+#define ETH_RX_FRAME            REG32(IO_ETH_BASE + 0x04)
+#define ETH_RX_STAMP            REG32(IO_ETH_BASE + 0x08)
+#define ETH_RX_DONE             REG32(IO_ETH_BASE + 0x0C)
+#define ETH_RX_MISSED           REG32(IO_ETH_BASE + 0x10)
+#define ETH_RX_ERRORS           REG32(IO_ETH_BASE + 0x14)
+#define ETH_TX_START            REG32(IO_ETH_BASE + 0x18)
+#define ETH_TX_LEVEL            REG32(IO_ETH_BASE + 0x1C)
+#define ETH_INFO                REG32(IO_ETH_BASE + 0x20)
+#define ETH_SLOT_SIZE           2048
+#define ETH_TX_SLOT(n)          ((volatile uint32_t *)(IO_ETH_BASE + 0x4000 + (n) * ETH_SLOT_SIZE))
+#define ETH_RX_SLOT(n)          ((volatile const uint32_t *)(IO_ETH_BASE + 0x8000 + (n) * ETH_SLOT_SIZE))
+
+/* 分类只看前64字节: 以太网头, 一层VLAN, IPv4 (选项不超过8字节) 或IPv6头, 端口 */
+#define ETH_HDR_WORDS           16
+
+/* 主核的接收环, NULL = 未启动, 收到的帧直接丢弃 */
+static volatile struct eth_ring *ring;
+static uint32_t ring_mask;
+static uint32_t bufs[ETH_MAX_DESC];     /* START时检查过的帧缓冲区地址 */
+
+/* 发送槽按顺序使用, 重新START也不复位 */
+static uint32_t tx_slots, tx_next;
+
+void io_eth_init(void)
+{
+    /* 外部中断1: MAC接收完成FIFO非空, 只用来唤醒wfi */
+    __asm__ volatile ("csrs 0xBC0, %0" :: "r"(1u << 1));
+}
+
+static uint32_t get16(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+/* 按内存顺序取4字节, 只用于哈希 */
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* RV32I没有乘法, 用移位加混合; 0留给"没有哈希" */
+static uint32_t hash_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h += h << 3;
+    h ^= h >> 11;
+    h += h << 15;
+    return h ? h : 1;
+}
+
+/* 目的MAC是否要收: 本机, 广播, ALLMULTI或哈希命中的组播 */
+static int eth_dst_ok(const uint8_t *p, uint32_t flags)
+{
+    uint32_t bit;
+    int i;
+
+    if (flags & ETH_F_PROMISC)
+        return 1;
+
+    if (p[0] & 1) {
+        if ((p[0] & p[1] & p[2] & p[3] & p[4] & p[5]) == 0xFF)
+            return 1;
+        if (flags & ETH_F_ALLMULTI)
+            return 1;
+        bit = (p[3] ^ p[4] ^ p[5]) & 63;
+        return (ring->mc_hash[bit >> 5] >> (bit & 31)) & 1;
+    }
+
+    for (i = 0; i < 6; i++)
+        if (p[i] != ring->mac[i])
+            return 0;
+    return 1;
+}
+
+/* 分类并计算流哈希; p只有前ETH_HDR_WORDS个字, len为帧长 */
+static uint32_t eth_classify(const uint8_t *p, uint32_t len, uint32_t *hash)
+{
+    uint32_t off = 12, cls = 0;
+    uint32_t type, ihl, l4, h;
+    int i;
+
+    *hash = 0;
+    if (len > ETH_HDR_WORDS * 4)
+        len = ETH_HDR_WORDS * 4;
+
+    type = get16(p + off);
+    if (type == 0x8100 && off + 6 <= len) {
+        cls = ETH_CLASS_VLAN;
+        off += 4;
+        type = get16(p + off);
+    }
+    off += 2;
+
+    switch (type) {
+    case 0x0806:
+        return cls | ETH_CLASS_ARP;
+
+    case 0x0800:
+        if (off + 20 > len || (p[off] >> 4) != 4)
+            break;
+        ihl = (p[off] & 0xF) * 4;
+        l4 = off + ihl;
+        h = get32(p + off + 12) ^ get32(p + off + 16);
+        *hash = hash_mix(h);
+        /* 分片 (MF或偏移非零) 和看不到端口的只按地址 */
+        if (ihl < 20 || (get16(p + off + 6) & 0x3FFF) || l4 + 4 > len)
+            return cls | ETH_CLASS_IPV4;
+        switch (p[off + 9]) {
+        case 6:
+            *hash = hash_mix(h ^ get32(p + l4));
+            return cls | ETH_CLASS_TCP4;
+        case 17:
+            *hash = hash_mix(h ^ get32(p + l4));
+            return cls | ETH_CLASS_UDP4;
+        case 1:
+            return cls | ETH_CLASS_ICMP4;
+        }
+        return cls | ETH_CLASS_IPV4;
+
+    case 0x86DD:
+        if (off + 40 > len)
+            break;
+        h = 0;
+        for (i = 8; i < 40; i += 4)
+            h ^= get32(p + off + i);
+        *hash = hash_mix(h);
+        /* 只认不带扩展头的TCP/UDP */
+        l4 = off + 40;
+        if (l4 + 4 <= len && p[off + 6] == 6) {
+            *hash = hash_mix(h ^ get32(p + l4));
+            return cls | ETH_CLASS_TCP6;
+        }
+        if (l4 + 4 <= len && p[off + 6] == 17) {
+            *hash = hash_mix(h ^ get32(p + l4));
+            return cls | ETH_CLASS_UDP6;
+        }
+        return cls | ETH_CLASS_IPV6;
+    }
+
+    return cls | ETH_CLASS_OTHER;
+}
+
+/* 处理MAC完成FIFO队首的一帧, 放进了接收环返回1 */
+static int eth_rx_frame(void)
+{
+    uint32_t frame = ETH_RX_FRAME;
+    uint32_t len = frame & 0xFFF;
+    volatile const uint32_t *src = ETH_RX_SLOT((frame >> 16) & 0xF);
+    volatile struct eth_desc *d;
+    volatile uint32_t *dst;
+    uint32_t hdr[ETH_HDR_WORDS];
+    uint32_t cls, hash, head, words, i;
+    int ret = 0;
+
+    if (!ring)
+        goto done;
+
+    if (len < 14 || len > ETH_BUF_SIZE) {
+        ring->rx_filtered++;
+        goto done;
+    }
+
+    words = (len + 3) / 4;
+    for (i = 0; i < ETH_HDR_WORDS && i < words; i++)
+        hdr[i] = src[i];
+
+    cls = eth_classify((const uint8_t *)hdr, len, &hash);
+    if (!eth_dst_ok((const uint8_t *)hdr, ring->flags) ||
+        !((ring->class_mask >> (cls & ~ETH_CLASS_VLAN)) & 1)) {
+        ring->rx_filtered++;
+        goto done;
+    }
+
+    head = ring->head;
+    if (head - ring->tail > ring_mask) {
+        ring->rx_full++;
+        goto done;
+    }
+
+    /* 头部已读到本地, 其余从接收槽直接拷 */
+    dst = (volatile uint32_t *)bufs[head & ring_mask];
+    for (i = 0; i < ETH_HDR_WORDS && i < words; i++)
+        dst[i] = hdr[i];
+    for (; i < words; i++)
+        dst[i] = src[i];
+
+    d = &ring->desc[head & ring_mask];
+    d->info = len | (cls << 16);
+    d->stamp = ETH_RX_STAMP;
+    d->hash = hash;
+    mb();
+    ring->head = head + 1;
+    ring->rx_frames++;
+    ret = 1;
+done:
+    ETH_RX_DONE = 1;
+    return ret;
+}
+
+void io_eth_service(void)
+{
+    struct hetero_msg msg;
+    int count = 0;
+
+    if (!io_eth_pending())
+        return;
+
+    /* 未启动时也要取走, 否则中断一直挂起 */
+    while (ETH_RX_LEVEL)
+        count += eth_rx_frame();
+
+    if (!ring)
+        return;
+
+    ring->rx_errors = ETH_RX_ERRORS;
+    ring->rx_missed = ETH_RX_MISSED;
+
+    /*
+     * 一批帧只通知一次. 先写head再读notify, 主核先写notify再读head,
+     * 两边都有屏障, 总有一边看到对方, 不会漏帧
+     */
+    mb();
+    if (count && ring->notify) {
+        ring->notify = 0;
+        msg.cmd = HETERO_MSG_ETH_RX;
+        msg.seq = 0;
+        msg.arg0 = ring->head;
+        msg.arg1 = 0;
+        while (!ring_push(RING_RX(CORE_ID), &msg))
+            ipi_notify_main();
+        ipi_notify_main();
+    }
+}
+
+static int eth_start(struct hetero_msg *msg)
+{
+    volatile struct eth_ring *r = (volatile struct eth_ring *)msg->arg0;
+    uint32_t n = msg->arg1;
+    uint32_t i;
+
+    ring = 0;
+    if (n < 2 || n > ETH_MAX_DESC || (n & (n - 1)) || (msg->arg0 & 3) ||
+        !shm_range_ok(msg->arg0, sizeof(struct eth_ring) + n * sizeof(struct eth_desc)))
+        return -22;     /* EINVAL */
+
+    for (i = 0; i < n; i++) {
+        bufs[i] = r->desc[i].buf;
+        if ((bufs[i] & 3) || !shm_range_ok(bufs[i], ETH_BUF_SIZE))
+            return -22;
+    }
+
+    tx_slots = (ETH_INFO >> 8) & 0xFF;
+    ring_mask = n - 1;
+    ring = r;
+    return 0;
+}
+
+static int eth_xmit(struct hetero_msg *msg)
+{
+    volatile const uint32_t *src = (volatile const uint32_t *)msg->arg0;
+    volatile uint32_t *dst;
+    uint32_t len = msg->arg1 & 0xFFFF;
+    uint32_t i;
+
+    if (!ring)
+        return -100;    /* ENETDOWN */
+    if (len < 14 || len > ETH_BUF_SIZE || (msg->arg0 & 3) ||
+        !shm_range_ok(msg->arg0, (len + 3) & ~3u))
+        return -22;
+
+    /* 排队数小于槽数时下一个槽已发完; 等待期间照常处理接收 */
+    while (ETH_TX_LEVEL >= tx_slots)
+        io_eth_service();
+
+    dst = ETH_TX_SLOT(tx_next);
+    for (i = 0; i < (len + 3) / 4; i++)
+        dst[i] = src[i];
+    ETH_TX_START = len | (tx_next << 16);
+    if (++tx_next == tx_slots)
+        tx_next = 0;
+
+    return 0;
+}
+
+int io_eth_command(struct hetero_msg *msg)
+{
+    switch (msg->cmd) {
+    case HETERO_MSG_ETH_START:
+        return eth_start(msg);
+    case HETERO_MSG_ETH_STOP:
+        ring = 0;
+        return 0;
+    case HETERO_MSG_ETH_XMIT:
+        return eth_xmit(msg);
+    }
+
+    return 1;
+}
+
+#else /* !IO_ETH_BASE */
+
+/* 门电路没有IOCoreEthernet: 0x80150000处没有从设备, 不能访问 */
+void io_eth_init(void)
+{
+}
+
+void io_eth_service(void)
+{
+}
+
+int io_eth_command(struct hetero_msg *msg)
+{
+    switch (msg->cmd) {
+    case HETERO_MSG_ETH_START:
+    case HETERO_MSG_ETH_XMIT:
+        return -19;     /* ENODEV */
+    case HETERO_MSG_ETH_STOP:
+        return 0;
+    }
+
+    return 1;
+}
+
+#endif /* IO_ETH_BASE */
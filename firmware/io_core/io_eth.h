@@ -0,0 +1,85 @@
+/* io_eth.h - IO核以太网接收预处理
+ *
+ * MAC接在 soc_linux.py IOCoreEthernet 上 (make.py --eth-offload), 帧先进MAC的
+ * 接收槽, 本核按目的MAC和分类掩码过滤, 把留下的帧连同分类, 流哈希和MAC锁存的
+ * 时间戳拷进主核 (driver_v3/hetero_eth.c) 在共享内存里给出的接收环.
+ * 一轮处理完所有已到的帧后, 主核请求了通知才发一条HETERO_MSG_ETH_RX, 主核
+ * 一次poll取走这一批. 布局与 driver_v3/hetero_regs.h 一致
+ */
+
+#ifndef _IO_ETH_H
+#define _IO_ETH_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+/*
+ * IO_ETH_BASE (0x80150000) 取自SoC生成的常量 (见Makefile的SOC_H), 只有
+ * make.py --eth-offload 的门电路才有; 未定义时START/XMIT返回-ENODEV
+ */
+
+#define HETERO_MSG_ETH_START    0x00F0   /* arg0 = 接收环总线地址, arg1 = 描述符数 */
+#define HETERO_MSG_ETH_STOP     0x00F1   /* 应答之后不再访问接收环 */
+#define HETERO_MSG_ETH_XMIT     0x00F2   /* arg0 = 帧总线地址, arg1[15:0] = 长度 */
+#define HETERO_MSG_ETH_RX       0x00F3   /* 本核发起: arg0 = 环的head */
+
+#define ETH_MAX_DESC            16
+#define ETH_BUF_SIZE            1536
+#define ETH_F_PROMISC           0x0001
+#define ETH_F_ALLMULTI          0x0002
+
+#define ETH_CLASS_OTHER         0
+#define ETH_CLASS_ARP           1
+#define ETH_CLASS_IPV4          2
+#define ETH_CLASS_TCP4          3
+#define ETH_CLASS_UDP4          4
+#define ETH_CLASS_ICMP4         5
+#define ETH_CLASS_IPV6          6
+#define ETH_CLASS_TCP6          7
+#define ETH_CLASS_UDP6          8
+#define ETH_CLASS_VLAN          0x80
+
+struct eth_desc {
+    uint32_t buf;
+    uint32_t info;              /* [15:0]长度 [23:16]分类 */
+    uint32_t stamp;
+    uint32_t hash;
+};
+
+struct eth_ring {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t notify;
+    uint32_t flags;
+    uint32_t class_mask;
+    uint8_t  mac[6];
+    uint16_t reserved;
+    uint32_t mc_hash[2];
+    uint32_t rx_frames;
+    uint32_t rx_filtered;
+    uint32_t rx_full;
+    uint32_t rx_errors;
+    uint32_t rx_missed;
+    uint32_t reserved2[2];
+    struct eth_desc desc[];
+};
+
+void io_eth_init(void);
+
+/* 处理以太网命令, 成功返回0, 其他命令返回1, 出错返回负的errno */
+int io_eth_command(struct hetero_msg *msg);
+
+/* MAC有已收完的帧; 读中断挂起CSR, 没有MAC时也不访问总线 */
+static inline int io_eth_pending(void)
+{
+    uint32_t pending;
+
+    __asm__ volatile ("csrr %0, 0xFC0" : "=r"(pending));
+    return (pending >> 1) & 1;
+}
+
+/* 处理所有已收完的帧, 需要时通知主核 */
+void io_eth_service(void);
+
+#endif /* _IO_ETH_H */
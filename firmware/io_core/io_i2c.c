@@ -0,0 +1,211 @@
+/* io_i2c.c - IO核I2C主机, 位时序由本核按时基忙等产生 */
+
+#include "hetero_hw.h"
+#include "hetero_timer.h"
+#include "io_i2c.h"
+
+#define I2C_OUT                 REG32(IO_I2C_BASE + 0x00)
+#define I2C_IN                  REG32(IO_I2C_BASE + 0x04)
+#define I2C_SCL                 0x1u
+#define I2C_SDA                 0x2u
+
+/* 从设备时钟延展最长10ms */
+#define I2C_STRETCH_TICKS       (10000u * TIMER_TICKS_PER_US)
+
+/* 半个SCL周期的时基周期数, 默认100kHz */
+static uint32_t half_ticks = SYS_CLK_FREQ / (2 * 100000u);
+static uint32_t out = I2C_SCL | I2C_SDA;
+
+static void i2c_delay(void)
+{
+    uint32_t t0 = MTIME_LO;
+
+    while (MTIME_LO - t0 < half_ticks)
+        ;
+}
+
+/* 开漏: 1释放, 0拉低 */
+static void i2c_set(uint32_t line, int high)
+{
+    out = high ? (out | line) : (out & ~line);
+    I2C_OUT = out;
+}
+
+/* 释放SCL并等从设备放开时钟 */
+static int i2c_scl_high(void)
+{
+    uint32_t t0 = MTIME_LO;
+
+    i2c_set(I2C_SCL, 1);
+    while (!(I2C_IN & I2C_SCL)) {
+        if (MTIME_LO - t0 > I2C_STRETCH_TICKS)
+            return -110;    /* ETIMEDOUT */
+    }
+    return 0;
+}
+
+/* 起始或重复起始, 返回时SCL为低 */
+static int i2c_start(void)
+{
+    i2c_set(I2C_SDA, 1);
+    i2c_delay();
+    if (i2c_scl_high())
+        return -110;
+    i2c_delay();
+    i2c_set(I2C_SDA, 0);
+    i2c_delay();
+    i2c_set(I2C_SCL, 0);
+    return 0;
+}
+
+static int i2c_stop(void)
+{
+    int ret;
+
+    i2c_set(I2C_SDA, 0);
+    i2c_delay();
+    ret = i2c_scl_high();
+    i2c_delay();
+    i2c_set(I2C_SDA, 1);
+    i2c_delay();
+    return ret;
+}
+
+static int i2c_write_bit(int bit)
+{
+    i2c_set(I2C_SDA, bit);
+    i2c_delay();
+    if (i2c_scl_high())
+        return -110;
+    i2c_delay();
+    i2c_set(I2C_SCL, 0);
+    return 0;
+}
+
+/* 在SCL高电平末尾采样 */
+static int i2c_read_bit(void)
+{
+    int bit;
+
+    i2c_set(I2C_SDA, 1);
+    i2c_delay();
+    if (i2c_scl_high())
+        return -110;
+    i2c_delay();
+    bit = !!(I2C_IN & I2C_SDA);
+    i2c_set(I2C_SCL, 0);
+    return bit;
+}
+
+/* 返回0 = 从设备应答, 1 = 无应答, 负数 = 超时 */
+static int i2c_write_byte(uint8_t byte)
+{
+    int i, ret;
+
+    for (i = 7; i >= 0; i--) {
+        ret = i2c_write_bit((byte >> i) & 1);
+        if (ret)
+            return ret;
+    }
+    return i2c_read_bit();
+}
+
+/* ack为0时回NACK (最后一个字节) */
+static int i2c_read_byte(int ack)
+{
+    int i, bit, ret;
+    int byte = 0;
+
+    for (i = 0; i < 8; i++) {
+        bit = i2c_read_bit();
+        if (bit < 0)
+            return bit;
+        byte = (byte << 1) | bit;
+    }
+
+    ret = i2c_write_bit(!ack);
+    return ret ? ret : byte;
+}
+
+/* 执行一条消息: 起始, 地址, 数据; 返回0或负的errno */
+static int i2c_msg(volatile struct i2c_xfer_msg *m)
+{
+    volatile uint8_t *buf = (volatile uint8_t *)m->buf;
+    int rd = m->flags & I2C_F_RD;
+    uint32_t k;
+    int ret;
+
+    ret = i2c_start();
+    if (ret)
+        return ret;
+
+    ret = i2c_write_byte((m->addr << 1) | rd);
+    if (ret)
+        return ret > 0 ? -6 : ret;      /* ENXIO: 地址无应答 */
+
+    for (k = 0; k < m->len; k++) {
+        if (rd) {
+            ret = i2c_read_byte(k + 1 < m->len);
+            if (ret < 0)
+                return ret;
+            buf[k] = ret;
+        } else {
+            ret = i2c_write_byte(buf[k]);
+            if (ret)
+                return ret > 0 ? -5 : ret;  /* EIO: 数据无应答 */
+        }
+    }
+    return 0;
+}
+
+static int i2c_xfer(struct hetero_msg *msg)
+{
+    volatile struct i2c_xfer_msg *d = (volatile struct i2c_xfer_msg *)msg->arg0;
+    uint32_t n = msg->arg1;
+    uint32_t i;
+    int ret = 0;
+
+    if (!n || n > I2C_MAX_MSGS || (msg->arg0 & 3) ||
+        !shm_range_ok(msg->arg0, n * sizeof(*d)))
+        return -22;     /* EINVAL */
+    for (i = 0; i < n; i++) {
+        if (d[i].addr > 0x7F || (d[i].flags & ~I2C_F_RD) ||
+            !shm_range_ok(d[i].buf, d[i].len))
+            return -22;
+    }
+
+    for (i = 0; i < n; i++) {
+        ret = i2c_msg(&d[i]);
+        if (ret)
+            break;
+    }
+
+    /* 出错也发停止, 释放总线 */
+    if (i2c_stop() && !ret)
+        ret = -110;
+    if (ret)
+        return ret;
+
+    msg->arg0 = n;
+    return 0;
+}
+
+int io_i2c_command(struct hetero_msg *msg)
+{
+    uint32_t freq = msg->arg0;
+
+    switch (msg->cmd) {
+    case HETERO_MSG_I2C_XFER:
+        return i2c_xfer(msg);
+
+    case HETERO_MSG_I2C_CONFIG:
+        if (!freq || freq > 1000000u)
+            return -22;
+        half_ticks = SYS_CLK_FREQ / (2 * freq);
+        if (!half_ticks)
+            half_ticks = 1;
+        return 0;
+    }
+
+    return 1;
+}
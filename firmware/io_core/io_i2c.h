@@ -0,0 +1,34 @@
+/* io_i2c.h - IO核I2C主机
+ *
+ * I2C引脚接在 soc_linux.py IOCoreI2C 上 (make.py --i2c-offload), 本核按
+ * 主核 (driver_v3/hetero_i2c.c) 提交的消息数组产生整个传输的位时序,
+ * 消息之间重复起始, 最后一条之后停止. 布局与 driver_v3/hetero_regs.h 一致
+ */
+
+#ifndef _IO_I2C_H
+#define _IO_I2C_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+#define IO_I2C_BASE             0x80144000UL
+
+#define HETERO_MSG_I2C_XFER     0x00E0   /* arg0 = 消息数组总线地址, arg1 = 消息数; 应答arg0 = 完成的消息数 */
+#define HETERO_MSG_I2C_CONFIG   0x00E1   /* arg0 = SCL频率(Hz) */
+
+#define I2C_MAX_MSGS            8
+#define I2C_F_RD                0x0001
+
+struct i2c_xfer_msg {
+    uint16_t addr;
+    uint16_t flags;
+    uint16_t len;
+    uint16_t reserved;
+    uint32_t buf;
+};
+
+/* 处理I2C命令, 成功返回0 (XFER在arg0填完成的消息数), 其他命令返回1, 出错返回负的errno */
+int io_i2c_command(struct hetero_msg *msg);
+
+#endif /* _IO_I2C_H */
@@ -0,0 +1,95 @@
+/* io_spi.c - IO核SPI主机, 经IOCoreSPI的收发FIFO连续移位 */
+
+#include "hetero_hw.h"
+#include "hetero_timer.h"
+#include "io_spi.h"
+
+#define SPI_DATA                REG32(IO_SPI_BASE + 0x00)
+#define SPI_STATUS              REG32(IO_SPI_BASE + 0x04)
+#define SPI_CS                  REG32(IO_SPI_BASE + 0x08)
+#define SPI_DIV                 REG32(IO_SPI_BASE + 0x0C)
+#define SPI_FIFO_DEPTH          64
+
+static void spi_delay_us(uint32_t us)
+{
+    uint32_t t0 = MTIME_LO;
+
+    while (MTIME_LO - t0 < us * TIMER_TICKS_PER_US)
+        ;
+}
+
+/*
+ * 发送和接收交替进行: 先取走已收到的字, 再把TX FIFO补到
+ * 在途字数 = FIFO深度, RX FIFO不会溢出, 移位器也不会空转
+ */
+static void spi_run(volatile const uint8_t *tx, volatile uint8_t *rx, uint32_t len)
+{
+    uint32_t sent = 0, recv = 0;
+    uint32_t level;
+    uint8_t byte;
+
+    while (recv < len) {
+        level = (SPI_STATUS >> 8) & 0xFF;
+        while (level--) {
+            byte = SPI_DATA;
+            if (rx)
+                rx[recv] = byte;
+            recv++;
+        }
+
+        while (sent < len && sent - recv < SPI_FIFO_DEPTH) {
+            SPI_DATA = tx ? tx[sent] : 0;
+            sent++;
+        }
+    }
+}
+
+static int spi_xfer(struct hetero_msg *msg)
+{
+    volatile struct spi_xfer_desc *d = (volatile struct spi_xfer_desc *)msg->arg0;
+    uint32_t n = msg->arg1 & 0xFFFF;
+    uint32_t cs = 1u << ((msg->arg1 >> 16) & 0x1F);
+    uint32_t total = 0;
+    uint32_t i;
+
+    if (!n || n > SPI_MAX_XFERS || (msg->arg0 & 3) ||
+        !shm_range_ok(msg->arg0, n * sizeof(*d)))
+        return -22;     /* EINVAL */
+    for (i = 0; i < n; i++) {
+        if ((d[i].tx && !shm_range_ok(d[i].tx, d[i].len)) ||
+            (d[i].rx && !shm_range_ok(d[i].rx, d[i].len)))
+            return -22;
+    }
+
+    SPI_CS = cs;
+    for (i = 0; i < n; i++) {
+        if (d[i].div)
+            SPI_DIV = d[i].div;
+
+        spi_run((volatile const uint8_t *)d[i].tx, (volatile uint8_t *)d[i].rx, d[i].len);
+        total += d[i].len;
+
+        if (d[i].delay_us)
+            spi_delay_us(d[i].delay_us);
+
+        /* 中间的CS_CHANGE: 释放片选再重新选中; 最后一条的CS_CHANGE: 保持选中 */
+        if ((d[i].flags & SPI_F_CS_CHANGE) && i + 1 < n) {
+            SPI_CS = 0;
+            spi_delay_us(1);
+            SPI_CS = cs;
+        }
+    }
+    if (!(d[n - 1].flags & SPI_F_CS_CHANGE))
+        SPI_CS = 0;
+
+    msg->arg0 = total;
+    return 0;
+}
+
+int io_spi_command(struct hetero_msg *msg)
+{
+    if (msg->cmd != HETERO_MSG_SPI_XFER)
+        return 1;
+
+    return spi_xfer(msg);
+}
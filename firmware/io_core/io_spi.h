@@ -0,0 +1,34 @@
+/* io_spi.h - IO核SPI主机
+ *
+ * SPI引脚接在 soc_linux.py IOCoreSPI 上 (make.py --spi-offload), 本核按
+ * 主核 (driver_v3/hetero_spi.c) 提交的传输数组执行一个spi_message,
+ * 收发FIFO保持满载, 字与字之间不停顿. 布局与 driver_v3/hetero_regs.h 一致
+ */
+
+#ifndef _IO_SPI_H
+#define _IO_SPI_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+#define IO_SPI_BASE             0x80145000UL
+
+#define HETERO_MSG_SPI_XFER     0x00E8   /* arg0 = 传输数组总线地址, arg1 = 传输数 | 片选<<16; 应答arg0 = 字节数 */
+
+#define SPI_MAX_XFERS           16
+#define SPI_F_CS_CHANGE         0x0001
+
+struct spi_xfer_desc {
+    uint32_t tx;
+    uint32_t rx;
+    uint16_t len;
+    uint16_t div;
+    uint16_t delay_us;
+    uint16_t flags;
+};
+
+/* 处理SPI命令, 成功返回0 (arg0填字节数), 其他命令返回1, 出错返回负的errno */
+int io_spi_command(struct hetero_msg *msg);
+
+#endif /* _IO_SPI_H */
@@ -0,0 +1,93 @@
+/* main.c - IO核固件 */
+
+#include "hetero_hw.h"
+#include "rpmsg_lite.h"
+#include "hetero_ring.h"
+#include "hetero_upcall.h"
+#include "hetero_timer.h"
+#include "io_i2c.h"
+#include "io_spi.h"
+#include "io_eth.h"
+
+#define CORE_ID_SELF     0
+#define RPMSG_EPT_ADDR   0x400
+
+/* rpmsg回显端点 */
+static void rpmsg_rx(uint32_t src, void *data, uint32_t len)
+{
+    rpmsg_lite_send(src, data, len);
+}
+
+/* 最近一次配置更新 */
+static uint32_t cfg_addr;
+static uint32_t cfg_generation;
+
+/* 处理一条主核请求并回一条响应, 参数原样返回 */
+static void handle_msg(struct hetero_msg *msg)
+{
+    int ret = io_i2c_command(msg);
+
+    if (ret == 1)
+        ret = io_spi_command(msg);
+    if (ret == 1)
+        ret = io_eth_command(msg);
+
+    if (ret < 0) {
+        /* I2C/SPI传输或以太网命令出错: 应答带错误码 */
+        msg->cmd |= HETERO_MSG_ERR;
+        msg->arg0 = -ret;
+    } else if (msg->cmd == HETERO_MSG_CFG_UPDATE) {
+        /* ring_pop已作废D-Cache, 之后读配置即为新数据 */
+        cfg_addr = msg->arg0;
+        cfg_generation = msg->arg1;
+    }
+
+    msg->cmd |= HETERO_MSG_RESP;
+    while (!ring_push(RING_RX(CORE_ID_SELF), msg))
+        ipi_notify_main();
+}
+
+/* 先处理到期的定时消息, 再处理主核TX环 */
+static void ring_service(void)
+{
+    struct hetero_msg msg;
+    int count = 0;
+
+    while (tmbox_pop(&msg)) {
+        handle_msg(&msg);
+        count++;
+    }
+
+    while (ring_pop(RING_TX(CORE_ID_SELF), &msg)) {
+        handle_msg(&msg);
+        count++;
+    }
+
+    if (count)
+        ipi_notify_main();
+}
+
+int main(void)
+{
+    irq_wait_setup();
+    io_eth_init();
+
+    rpmsg_lite_init("rpmsg-hetero-io", RPMSG_EPT_ADDR, rpmsg_rx);
+    hetero_log("IO core firmware started");
+
+    for (;;) {
+        /* 等待主核IPI或以太网接收 */
+        while (!(IPI_STATUS & IPI_CORE_BIT(CORE_ID_SELF)) && !io_eth_pending())
+            wfi();
+
+        if (IPI_STATUS & IPI_CORE_BIT(CORE_ID_SELF)) {
+            IPI_CLEAR = IPI_CORE_BIT(CORE_ID_SELF);
+            ring_service();
+            rpmsg_lite_poll();
+        }
+
+        io_eth_service();
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/* main.c - RT核固件 */
+
+#include "hetero_hw.h"
+#include "rpmsg_lite.h"
+#include "hetero_ring.h"
+#include "hetero_upcall.h"
+#include "hetero_timer.h"
+#include "rt_exec.h"
+#include "rt_bench.h"
+#include "rt_irq.h"
+#include "rt_pwm.h"
+
+#define CORE_ID_SELF     1
+#define RPMSG_EPT_ADDR   0x400
+
+/* rpmsg回显端点 */
+static void rpmsg_rx(uint32_t src, void *data, uint32_t len)
+{
+    rpmsg_lite_send(src, data, len);
+}
+
+/* 最近一次配置更新 */
+static uint32_t cfg_addr;
+static uint32_t cfg_generation;
+
+/* 处理一条主核请求并回一条响应, 参数原样返回 */
+static void handle_msg(struct hetero_msg *msg)
+{
+    int ret = rt_exec_command(msg);
+
+    if (ret == 1)
+        ret = rt_bench_command(msg);
+    if (ret == 1)
+        ret = rt_irq_command(msg);
+    if (ret == 1)
+        ret = rt_pwm_command(msg);
+
+    if (ret < 0) {
+        /* 执行器配置出错: 应答带错误码 */
+        msg->cmd |= HETERO_MSG_ERR;
+        msg->arg0 = -ret;
+    } else if (msg->cmd == HETERO_MSG_CFG_UPDATE) {
+        /* ring_pop已作废D-Cache, 之后读配置即为新数据 */
+        cfg_addr = msg->arg0;
+        cfg_generation = msg->arg1;
+    }
+
+    msg->cmd |= HETERO_MSG_RESP;
+    while (!ring_push(RING_RX(CORE_ID_SELF), msg))
+        ipi_notify_main();
+}
+
+/* 先处理到期的定时消息, 再处理主核TX环 */
+static void ring_service(void)
+{
+    struct hetero_msg msg;
+    int count = 0;
+
+    while (tmbox_pop(&msg)) {
+        handle_msg(&msg);
+        count++;
+    }
+
+    while (ring_pop(RING_TX(CORE_ID_SELF), &msg)) {
+        handle_msg(&msg);
+        count++;
+    }
+
+    if (count)
+        ipi_notify_main();
+}
+
+int main(void)
+{
+    irq_wait_setup();
+
+    rt_exec_init();
+    rt_irq_init();
+    rt_pwm_init();
+
+    rpmsg_lite_init("rpmsg-hetero-rt", RPMSG_EPT_ADDR, rpmsg_rx);
+    hetero_log("RT core firmware started");
+
+    for (;;) {
+        /* 作业之间处理主核消息 */
+        if (IPI_STATUS & IPI_CORE_BIT(CORE_ID_SELF)) {
+            rt_bench_ipi(MTIME_LO);
+            IPI_CLEAR = IPI_CORE_BIT(CORE_ID_SELF);
+            ring_service();
+            rpmsg_lite_poll();
+        }
+
+        /* 路由中断释放的作业和到期作业一起参与调度 */
+        rt_irq_service();
+        rt_pwm_service();
+        if (rt_exec_run())
+            continue;
+
+        /* 没有就绪作业: 等待主核IPI, 路由中断, PWM生效或下一次释放 */
+        while (!(IPI_STATUS & IPI_CORE_BIT(CORE_ID_SELF)) && !timer_pending() &&
+               !rt_irq_pending() && !rt_pwm_pending())
+            wfi();
+    }
+
+    return 0;
+}
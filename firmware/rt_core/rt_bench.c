@@ -0,0 +1,75 @@
+/* rt_bench.c - RT核中断延迟/释放抖动测量 */
+
+#include "hetero_hw.h"
+#include "rt_bench.h"
+
+static volatile struct rt_bench *bench;
+
+static void rt_bench_record(volatile struct rt_bench_hist *h, uint32_t cycles)
+{
+    uint32_t bin = cycles >> bench->bin_shift;
+    uint32_t sum = h->sum_lo + cycles;
+
+    if (sum < cycles)
+        h->sum_hi++;
+    h->sum_lo = sum;
+
+    if (!h->count || cycles < h->min)
+        h->min = cycles;
+    if (cycles > h->max)
+        h->max = cycles;
+    h->count++;
+
+    if (bin < RT_BENCH_BINS)
+        h->bin[bin]++;
+    else
+        h->overflow++;
+}
+
+int rt_bench_command(const struct hetero_msg *msg)
+{
+    uint32_t addr = msg->arg0;
+
+    if (msg->cmd != HETERO_MSG_RT_BENCH)
+        return 1;
+
+    if (!addr) {
+        bench = 0;
+        return 0;
+    }
+
+    if (addr < SHARED_MEM_BASE || (addr & 3) || msg->arg1 >= 32 ||
+        addr + sizeof(struct rt_bench) > SHARED_MEM_BASE + SHARED_MEM_SIZE)
+        return -22;     /* EINVAL */
+
+    /* 直方图由主核清零, 这里只接管 */
+    dcache_invalidate();
+    bench = (volatile struct rt_bench *)addr;
+    bench->bin_shift = msg->arg1;
+    bench->ipi_seen = bench->ipi_seq;
+    bench->magic = RT_BENCH_MAGIC;
+    return 0;
+}
+
+void rt_bench_ipi(uint32_t now)
+{
+    uint32_t seq;
+
+    if (!bench)
+        return;
+
+    /* 主核先写时间戳再递增seq, 其他来源的IPI不计 */
+    dcache_invalidate();
+    seq = bench->ipi_seq;
+    if (seq == bench->ipi_seen)
+        return;
+
+    rt_bench_record(&bench->ipi, now - bench->ipi_stamp);
+    bench->ipi_seen = seq;
+}
+
+void rt_bench_release(uint32_t latency)
+{
+    if (bench)
+        rt_bench_record(&bench->jitter, latency);
+}
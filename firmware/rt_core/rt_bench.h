@@ -0,0 +1,54 @@
+/* rt_bench.h - RT核中断延迟/释放抖动测量
+ *
+ * 主核 (driver_v3/hetero_bench.c) 从共享内存缓冲池分配测量块并发送
+ * HETERO_MSG_RT_BENCH, 之后:
+ *   - IPI延迟: 主核写入ipi_stamp(全局时基低32位)并递增ipi_seq, 再发IPI;
+ *     本核醒来后立即读时基, 差值计入ipi直方图
+ *   - 释放抖动: 执行器每个作业的 开始执行 - 名义释放时刻 计入jitter直方图
+ * 布局与 driver_v3/hetero_regs.h 一致, 时间单位为时基周期
+ */
+
+#ifndef _RT_BENCH_H
+#define _RT_BENCH_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+#define HETERO_MSG_RT_BENCH     0x00D5   /* arg0 = 测量块总线地址(0=停止), arg1 = 桶宽log2(周期) */
+
+#define RT_BENCH_MAGIC          0x52544248   /* "RTBH" */
+#define RT_BENCH_BINS           64
+
+struct rt_bench_hist {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t overflow;          /* 超出最后一个桶 */
+    uint32_t sum_lo;
+    uint32_t sum_hi;
+    uint32_t reserved[2];
+    uint32_t bin[RT_BENCH_BINS];
+};
+
+struct rt_bench {
+    uint32_t magic;             /* 本核开始测量后写入 */
+    uint32_t bin_shift;
+    uint32_t ipi_seq;           /* 主核: 发IPI前递增 */
+    uint32_t ipi_stamp;         /* 主核: 发IPI时的时基低32位 */
+    uint32_t ipi_seen;          /* 本核: 已测量的ipi_seq */
+    uint32_t reserved[3];
+    struct rt_bench_hist ipi;
+    struct rt_bench_hist jitter;
+};
+
+/* 处理HETERO_MSG_RT_BENCH, 成功返回0, 其他命令返回1, 出错返回负的errno */
+int rt_bench_command(const struct hetero_msg *msg);
+
+/* 本核被IPI唤醒, now为醒来后第一时间读到的时基低32位 */
+void rt_bench_ipi(uint32_t now);
+
+/* 执行器开始执行一个作业, latency为距名义释放时刻的周期数 */
+void rt_bench_release(uint32_t latency);
+
+#endif /* _RT_BENCH_H */
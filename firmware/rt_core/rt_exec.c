@@ -0,0 +1,322 @@
+/* rt_exec.c - RT核周期任务执行器 */
+
+#include "hetero_hw.h"
+#include "hetero_timer.h"
+#include "hetero_upcall.h"
+#include "rt_exec.h"
+#include "rt_bench.h"
+
+typedef void (*rt_task_fn)(uint32_t arg);
+
+struct rt_task {
+    rt_task_fn fn;
+    uint32_t arg;
+    uint32_t period;            /* 周期数 */
+    uint8_t prio;
+    uint8_t fn_id;
+    uint8_t active;
+    uint8_t pending;            /* 已释放未执行 */
+    uint8_t irq;                /* 由路由中断释放, 不按周期释放 */
+    uint64_t release;           /* 当前作业的释放时刻 */
+    uint64_t deadline;          /* 当前作业的绝对截止期 */
+    uint64_t next;              /* 下次释放时刻 */
+};
+
+static struct rt_task tasks[RT_MAX_TASKS];
+static uint32_t policy;
+
+/* 任务函数 ---------------------------------------------------------------- */
+
+static uint32_t control_ticks;
+
+static void rt_fn_nop(uint32_t arg)
+{
+    (void)arg;
+}
+
+/* 控制环, 控制算法在此处调用 */
+static void rt_fn_control(uint32_t arg)
+{
+    (void)arg;
+    control_ticks++;
+}
+
+static void rt_fn_load(uint32_t us)
+{
+    uint64_t end = mtime_read() + (uint64_t)us * TIMER_TICKS_PER_US;
+
+    while (mtime_read() < end)
+        ;
+}
+
+static const rt_task_fn rt_fns[RT_NUM_FNS] = {
+    [RT_FN_NOP]     = rt_fn_nop,
+    [RT_FN_CONTROL] = rt_fn_control,
+    [RT_FN_LOAD]    = rt_fn_load,
+};
+
+/* 统计 -------------------------------------------------------------------- */
+
+static void rt_stats_cfg(int id)
+{
+    struct rt_task *t = &tasks[id];
+
+    RT_STATS->task[id].cfg = id | (t->prio << 8) | (t->fn_id << 16) | (t->active << 24) |
+                             (t->irq << 25);
+    RT_STATS->task[id].period = t->period;
+}
+
+static void rt_stats_reset(int id)
+{
+    volatile struct rt_task_stats *st = &RT_STATS->task[id];
+
+    st->releases = 0;
+    st->overruns = 0;
+    st->wcrt = 0;
+    st->last_response = 0;
+    st->min_latency = 0xFFFFFFFFu;
+    st->max_latency = 0;
+}
+
+/* 超过截止期: 计数并通知主核, UP环满时只计数 */
+static void rt_overrun(int id, uint32_t response)
+{
+    RT_STATS->task[id].overruns++;
+    hetero_upcall_post(HETERO_UPCALL_RT_OVERRUN, id, response);
+}
+
+static void rt_update_active(void)
+{
+    uint32_t active = 0;
+    int i;
+
+    for (i = 0; i < RT_MAX_TASKS; i++)
+        if (tasks[i].active)
+            active |= 1u << i;
+    RT_STATS->active = active;
+}
+
+void rt_exec_init(void)
+{
+    int i;
+
+    RT_STATS->magic = RT_STATS_MAGIC;
+    RT_STATS->policy = policy;
+    for (i = 0; i < RT_MAX_TASKS; i++) {
+        rt_stats_cfg(i);
+        rt_stats_reset(i);
+    }
+    rt_update_active();
+
+    mtimecmp_write(TIMER_NEVER);
+    timer_wait_setup();
+}
+
+/* 配置 -------------------------------------------------------------------- */
+
+static void rt_start(uint32_t mask)
+{
+    uint64_t now = mtime_read();
+    int i;
+
+    for (i = 0; i < RT_MAX_TASKS; i++) {
+        if (!(mask & (1u << i)) || !tasks[i].fn || tasks[i].active)
+            continue;
+
+        tasks[i].active = 1;
+        tasks[i].pending = 0;
+        tasks[i].next = tasks[i].irq ? TIMER_NEVER : now;
+        rt_stats_reset(i);
+        rt_stats_cfg(i);
+    }
+    rt_update_active();
+}
+
+static void rt_stop(uint32_t mask)
+{
+    int i;
+
+    for (i = 0; i < RT_MAX_TASKS; i++) {
+        if (!(mask & (1u << i)))
+            continue;
+
+        tasks[i].active = 0;
+        tasks[i].pending = 0;
+        rt_stats_cfg(i);
+    }
+    rt_update_active();
+}
+
+int rt_exec_command(const struct hetero_msg *msg)
+{
+    uint32_t id = msg->arg0 & 0xFF;
+    uint32_t fn = (msg->arg0 >> 16) & 0xFF;
+
+    switch (msg->cmd) {
+    case HETERO_MSG_RT_POLICY:
+        if (msg->arg0 > RT_POLICY_EDF)
+            return -22;     /* EINVAL */
+        policy = msg->arg0;
+        RT_STATS->policy = policy;
+        return 0;
+
+    case HETERO_MSG_RT_TASK_SET:
+        if (id >= RT_MAX_TASKS || fn >= RT_NUM_FNS || !msg->arg1)
+            return -22;
+        if (tasks[id].active)
+            return -16;     /* EBUSY: 先停止再修改 */
+        tasks[id].fn = rt_fns[fn];
+        tasks[id].fn_id = fn;
+        tasks[id].prio = (msg->arg0 >> 8) & 0xFF;
+        tasks[id].period = msg->arg1 * TIMER_TICKS_PER_US;
+        rt_stats_cfg(id);
+        return 0;
+
+    case HETERO_MSG_RT_TASK_ARG:
+        if (id >= RT_MAX_TASKS)
+            return -22;
+        tasks[id].arg = msg->arg1;
+        return 0;
+
+    case HETERO_MSG_RT_START:
+        rt_start(msg->arg0);
+        return 0;
+
+    case HETERO_MSG_RT_STOP:
+        rt_stop(msg->arg0);
+        return 0;
+    }
+
+    return 1;
+}
+
+int rt_exec_set_irq(int id, int on)
+{
+    if (id < 0 || id >= RT_MAX_TASKS)
+        return -22;
+    if (tasks[id].active)
+        return -16;
+    tasks[id].irq = !!on;
+    rt_stats_cfg(id);
+    return 0;
+}
+
+/* 调度 -------------------------------------------------------------------- */
+
+void rt_exec_trigger(int id, uint64_t release)
+{
+    struct rt_task *t = &tasks[id];
+
+    if (!t->active || !t->irq)
+        return;
+
+    if (t->pending) {
+        /* 上一个作业还没开始执行, 本次中断作废 */
+        rt_overrun(id, 0);
+        return;
+    }
+
+    t->pending = 1;
+    t->release = release;
+    t->deadline = release + t->period;
+    RT_STATS->task[id].releases++;
+}
+
+/* 释放所有到期的作业, 返回下一个释放时刻 */
+static uint64_t rt_release(uint64_t now)
+{
+    uint64_t earliest = TIMER_NEVER;
+    struct rt_task *t;
+    int i;
+
+    for (i = 0; i < RT_MAX_TASKS; i++) {
+        t = &tasks[i];
+        if (!t->active)
+            continue;
+
+        if (t->next <= now) {
+            if (t->pending) {
+                /* 上一个作业还没开始执行, 本次释放作废 */
+                rt_overrun(i, 0);
+            } else {
+                t->pending = 1;
+                t->release = t->next;
+                t->deadline = t->next + t->period;
+                RT_STATS->task[i].releases++;
+            }
+
+            /* 释放时刻按周期推进, 执行过晚时跳过错过的释放 */
+            t->next += t->period;
+            while (t->next <= now) {
+                t->next += t->period;
+                rt_overrun(i, 0);
+            }
+        }
+
+        if (t->next < earliest)
+            earliest = t->next;
+    }
+
+    return earliest;
+}
+
+/* 按策略选出就绪作业, 没有返回-1 */
+static int rt_pick(void)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < RT_MAX_TASKS; i++) {
+        if (!tasks[i].active || !tasks[i].pending)
+            continue;
+
+        if (best < 0)
+            best = i;
+        else if (policy == RT_POLICY_EDF ? tasks[i].deadline < tasks[best].deadline
+                                         : tasks[i].prio < tasks[best].prio)
+            best = i;
+    }
+
+    return best;
+}
+
+int rt_exec_run(void)
+{
+    volatile struct rt_task_stats *st;
+    uint64_t start, end;
+    uint32_t latency, response;
+    struct rt_task *t;
+    int id;
+
+    mtimecmp_write(rt_release(mtime_read()));
+
+    id = rt_pick();
+    if (id < 0)
+        return 0;
+
+    t = &tasks[id];
+    st = &RT_STATS->task[id];
+
+    start = mtime_read();
+    t->fn(t->arg);
+    end = mtime_read();
+    t->pending = 0;
+
+    latency = (uint32_t)(start - t->release);
+    response = (uint32_t)(end - t->release);
+
+    rt_bench_release(latency);
+
+    st->last_response = response;
+    if (response > st->wcrt)
+        st->wcrt = response;
+    if (latency < st->min_latency)
+        st->min_latency = latency;
+    if (latency > st->max_latency)
+        st->max_latency = latency;
+
+    if (end > t->deadline)
+        rt_overrun(id, response);
+
+    return 1;
+}
@@ -0,0 +1,78 @@
+/* rt_exec.h - RT核周期任务执行器
+ *
+ * 任务表由主核经TX环配置 (HETERO_MSG_RT_*), 由本核定时器按周期释放,
+ * 调度策略为固定优先级(RM)或最早截止期优先(EDF), 截止期等于周期.
+ * 作业之间不抢占: 选出的作业运行完才处理下一个作业或主核消息.
+ *
+ * 每个任务的释放次数/最坏响应时间/释放抖动写入共享内存 (布局与
+ * driver_v3/hetero_regs.h 一致), 超过截止期时经UP环通知主核
+ */
+
+#ifndef _RT_EXEC_H
+#define _RT_EXEC_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+#define RT_MAX_TASKS            16
+
+/* 主核 -> RT核配置消息 */
+#define HETERO_MSG_RT_POLICY    0x00D0   /* arg0 = RT_POLICY_* */
+#define HETERO_MSG_RT_TASK_SET  0x00D1   /* arg0 = 任务号 | 优先级<<8 | 函数号<<16, arg1 = 周期(us) */
+#define HETERO_MSG_RT_TASK_ARG  0x00D2   /* arg0 = 任务号, arg1 = 传给任务函数的参数 */
+#define HETERO_MSG_RT_START     0x00D3   /* arg0 = 任务位图, 从同一时刻开始释放 */
+#define HETERO_MSG_RT_STOP      0x00D4   /* arg0 = 任务位图 */
+
+#define RT_POLICY_RM            0        /* 固定优先级, 数值小的优先 */
+#define RT_POLICY_EDF           1
+
+/* 任务函数号 */
+#define RT_FN_NOP               0
+#define RT_FN_CONTROL           1        /* 控制环 */
+#define RT_FN_LOAD              2        /* 忙等arg微秒, 用于测试 */
+#define RT_NUM_FNS              3
+
+/* 共享内存中的统计 (时间单位均为时基周期) */
+#define RT_STATS_OFFSET         0x0C00
+#define RT_STATS_MAGIC          0x52544558   /* "RTEX" */
+
+struct rt_task_stats {
+    uint32_t cfg;               /* 任务号 | 优先级<<8 | 函数号<<16 | 运行中<<24 | 中断释放<<25 */
+    uint32_t period;
+    uint32_t releases;
+    uint32_t overruns;          /* 超过截止期完成 + 错过的释放 */
+    uint32_t wcrt;              /* 最坏响应时间: 释放到完成 */
+    uint32_t last_response;
+    uint32_t min_latency;       /* 释放到开始执行, 抖动 = max - min */
+    uint32_t max_latency;
+};
+
+struct rt_stats {
+    uint32_t magic;
+    uint32_t policy;
+    uint32_t active;            /* 运行中的任务位图 */
+    uint32_t reserved[5];
+    struct rt_task_stats task[RT_MAX_TASKS];
+};
+
+#define RT_STATS ((volatile struct rt_stats *)(SHARED_MEM_BASE + RT_STATS_OFFSET))
+
+void rt_exec_init(void);
+
+/* 处理HETERO_MSG_RT_*配置消息, 成功返回0, 其他命令返回1, 出错返回负的errno */
+int rt_exec_command(const struct hetero_msg *msg);
+
+/*
+ * 由路由中断释放 (rt_irq.c): on时任务不再按周期释放, 周期即相对截止期.
+ * 任务须已停止, 否则返回-EBUSY
+ */
+int rt_exec_set_irq(int id, int on);
+
+/* 以release为释放时刻释放一个作业, 任务未运行或不是中断释放时忽略 */
+void rt_exec_trigger(int id, uint64_t release);
+
+/* 释放到期的作业并按策略执行一个, 执行了作业返回1 */
+int rt_exec_run(void);
+
+#endif /* _RT_EXEC_H */
@@ -0,0 +1,88 @@
+/* rt_irq.c - 路由到RT核的外设中断, 释放绑定的执行器任务 */
+
+#include "hetero_hw.h"
+#include "hetero_timer.h"
+#include "rt_exec.h"
+#include "rt_irq.h"
+
+/* 每个源绑定的任务号, -1 = 未绑定 (只清除挂起位) */
+static int8_t bound[IRQ_ROUTE_NUM_SOURCES];
+
+void rt_irq_init(void)
+{
+    uint32_t lines = ((1u << IRQ_ROUTE_NUM_SOURCES) - 1) << 1;
+    int i;
+
+    for (i = 0; i < IRQ_ROUTE_NUM_SOURCES; i++)
+        bound[i] = -1;
+    IRQ_ROUTE_RT_CLEAR = (1u << IRQ_ROUTE_NUM_SOURCES) - 1;
+
+    /* 外部中断1-16: 路由源, 和IPI一样只用来唤醒wfi */
+    __asm__ volatile ("csrs 0xBC0, %0" :: "r"(lines));
+}
+
+/* 任务是否还绑定在其他源上 */
+static int rt_irq_task_bound(int id)
+{
+    int i;
+
+    for (i = 0; i < IRQ_ROUTE_NUM_SOURCES; i++)
+        if (bound[i] == id)
+            return 1;
+    return 0;
+}
+
+int rt_irq_command(const struct hetero_msg *msg)
+{
+    uint32_t src = msg->arg0 & 0xFF;
+    int id = (msg->arg0 >> 8) & 0xFF;
+    int ret;
+
+    if (msg->cmd != HETERO_MSG_RT_IRQ_BIND)
+        return 1;
+
+    if (src >= IRQ_ROUTE_NUM_SOURCES || id >= RT_MAX_TASKS)
+        return -22;     /* EINVAL */
+
+    if (msg->arg1) {
+        if (bound[src] >= 0 && bound[src] != id)
+            return -16; /* EBUSY: 先解绑 */
+        ret = rt_exec_set_irq(id, 1);
+        if (ret)
+            return ret;
+        bound[src] = id;
+    } else {
+        if (bound[src] != id)
+            return -22;
+        bound[src] = -1;
+        if (!rt_irq_task_bound(id)) {
+            ret = rt_exec_set_irq(id, 0);
+            if (ret) {
+                bound[src] = id;
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void rt_irq_service(void)
+{
+    uint32_t pending = IRQ_ROUTE_RT_PENDING;
+    uint64_t now, release;
+    int src;
+
+    if (!pending)
+        return;
+
+    /* STAMP是最近一次锁存的时刻, 同时挂起的几个源都按它计算释放时刻 */
+    now = mtime_read();
+    release = now - ((uint32_t)now - IRQ_ROUTE_STAMP);
+    IRQ_ROUTE_RT_CLEAR = pending;
+
+    for (src = 0; src < IRQ_ROUTE_NUM_SOURCES; src++) {
+        if ((pending & (1u << src)) && bound[src] >= 0)
+            rt_exec_trigger(bound[src], release);
+    }
+}
@@ -0,0 +1,32 @@
+/* rt_irq.h - 路由到RT核的外设中断
+ *
+ * 中断路由矩阵 (soc_linux.py IrqRouter) 把选中的外设中断源锁存后直接接到
+ * 本核 externalInterruptArray[1+n], 本核在wfi中立即醒来, 不经过Linux.
+ * 主核用HETERO_MSG_RT_IRQ_BIND把源绑定到执行器任务: 源锁存后立即释放该任务的
+ * 一个作业, 释放时刻取锁存时的IRQ_ROUTE_STAMP, 因此执行器统计里的释放延迟
+ * 就是 输入边沿 -> 开始执行 的时间. 哪些源送到本核由主核配置 (IRQ_ROUTE_RT)
+ */
+
+#ifndef _RT_IRQ_H
+#define _RT_IRQ_H
+
+#include "hetero_hw.h"
+#include "hetero_ring.h"
+
+#define HETERO_MSG_RT_IRQ_BIND  0x00D6   /* arg0 = 中断源 | 任务号<<8, arg1 = 1绑定/0解绑; 任务须已停止 */
+
+void rt_irq_init(void);
+
+/* 处理HETERO_MSG_RT_IRQ_BIND, 成功返回0, 其他命令返回1, 出错返回负的errno */
+int rt_irq_command(const struct hetero_msg *msg);
+
+/* 有尚未取走的路由中断 */
+static inline int rt_irq_pending(void)
+{
+    return IRQ_ROUTE_RT_PENDING != 0;
+}
+
+/* 取走挂起的路由中断, 释放绑定的任务 */
+void rt_irq_service(void);
+
+#endif /* _RT_IRQ_H */
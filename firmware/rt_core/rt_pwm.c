@@ -0,0 +1,110 @@
+/* rt_pwm.c - RT核PWM设定值队列, 经RTCorePWM的影子寄存器在周期边界生效 */
+
+#include "hetero_hw.h"
+#include "rt_pwm.h"
+
+#ifdef RT_PWM_BASE
+
+#if RT_PWM_NUM_CHANNELS > RT_PWM_MAX_CHANNELS
+#error "RTCorePWM has more channels than struct rt_pwm_frame"
+#endif
+
+#define PWM_PERIOD              REG32(RT_PWM_BASE + 0x00)
+#define PWM_ENABLE              REG32(RT_PWM_BASE + 0x04)
+#define PWM_HOLD                REG32(RT_PWM_BASE + 0x08)
+#define PWM_UPDATE              REG32(RT_PWM_BASE + 0x0C)
+#define PWM_STATUS              REG32(RT_PWM_BASE + 0x10)
+#define PWM_WIDTH(n)            REG32(RT_PWM_BASE + 0x20 + (n) * 4)
+
+/* 帧队列, 下标自由增长 */
+static struct rt_pwm_frame queue[RT_PWM_QUEUE_LEN];
+static uint32_t q_head, q_tail;
+
+void rt_pwm_init(void)
+{
+    /* 外部中断17: 影子寄存器已生效, 只用来唤醒wfi */
+    __asm__ volatile ("csrs 0xBC0, %0" :: "r"(1u << 17));
+}
+
+/* 上一次装填已生效时, 把队首帧写进影子寄存器并装填 */
+static void rt_pwm_load(void)
+{
+    const struct rt_pwm_frame *f;
+    int i;
+
+    if (q_head == q_tail || (PWM_UPDATE & 1))
+        return;
+
+    f = &queue[q_tail % RT_PWM_QUEUE_LEN];
+    PWM_PERIOD = f->period;
+    PWM_ENABLE = f->enable;
+    PWM_HOLD = f->hold;
+    for (i = 0; i < RT_PWM_NUM_CHANNELS; i++)
+        PWM_WIDTH(i) = f->width[i];
+    PWM_UPDATE = 1;
+    q_tail++;
+}
+
+int rt_pwm_command(struct hetero_msg *msg)
+{
+    volatile const uint32_t *src = (volatile const uint32_t *)msg->arg0;
+    uint32_t n = msg->arg1 & 0xFFFF;
+    uint32_t flags = msg->arg1 >> 16;
+    uint32_t *dst;
+    uint32_t i, w;
+
+    if (msg->cmd != HETERO_MSG_RT_PWM_BATCH)
+        return 1;
+
+    if (!n || n > RT_PWM_QUEUE_LEN || (flags & ~RT_PWM_F_FLUSH) || (msg->arg0 & 3) ||
+        !shm_range_ok(msg->arg0, n * sizeof(struct rt_pwm_frame)))
+        return -22;     /* EINVAL */
+
+    if (flags & RT_PWM_F_FLUSH)
+        q_head = q_tail;
+    if (q_head - q_tail + n > RT_PWM_QUEUE_LEN)
+        return -28;     /* ENOSPC */
+
+    /* ring_pop已作废D-Cache, 直接读共享内存中的帧 */
+    for (i = 0; i < n; i++) {
+        dst = (uint32_t *)&queue[q_head % RT_PWM_QUEUE_LEN];
+        for (w = 0; w < sizeof(struct rt_pwm_frame) / 4; w++)
+            dst[w] = *src++;
+        q_head++;
+    }
+
+    /* PWM空闲时第一帧马上装填 */
+    rt_pwm_load();
+
+    msg->arg1 = q_head - q_tail;
+    return 0;
+}
+
+void rt_pwm_service(void)
+{
+    if (!rt_pwm_pending())
+        return;
+
+    PWM_STATUS = 1;
+    rt_pwm_load();
+}
+
+#else /* !RT_PWM_BASE */
+
+/* 门电路没有RTCorePWM: 0x80146000处没有从设备, 不能访问 */
+void rt_pwm_init(void)
+{
+}
+
+int rt_pwm_command(struct hetero_msg *msg)
+{
+    if (msg->cmd != HETERO_MSG_RT_PWM_BATCH)
+        return 1;
+    return -19;         /* ENODEV */
+}
+
+void rt_pwm_service(void)
+{
+}
+
+#endif /* RT_PWM_BASE */
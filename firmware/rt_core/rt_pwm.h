@@ -0,0 +1,53 @@
+/* rt_pwm.h - RT核PWM设定值队列
+ *
+ * PWM引脚接在 soc_linux.py RTCorePWM 上 (make.py --pwm-offload), 各通道共用
+ * 一个周期计数器. 主核用HETERO_MSG_RT_PWM_BATCH成批提交设定值帧, 本核拷进
+ * 队列后应答; 硬件生效一帧 (上一帧保持满hold个周期后的周期边界) 时置位
+ * externalInterruptArray[17], 本核醒来把下一帧写进影子寄存器并装填.
+ * 只要在一帧的保持时间内装填下一帧, 生效时刻就与本核的响应时间无关.
+ * 布局与 driver_v3/hetero_regs.h 一致
+ */
+
+#ifndef _RT_PWM_H
+#define _RT_PWM_H
+
+#include <stdint.h>
+
+#include "hetero_ring.h"
+
+/*
+ * RT_PWM_BASE (0x80146000) 和 RT_PWM_NUM_CHANNELS 取自SoC生成的常量 (见Makefile的
+ * SOC_H), 只有 make.py --pwm-offload 的门电路才有; 未定义时批量命令返回-ENODEV
+ */
+
+#define HETERO_MSG_RT_PWM_BATCH 0x00D7   /* arg0 = 帧数组总线地址, arg1 = 帧数 | 标志<<16; 应答arg1 = 队列中的帧数 */
+
+#define RT_PWM_MAX_CHANNELS     4
+#define RT_PWM_QUEUE_LEN        64
+#define RT_PWM_F_FLUSH          0x1      /* 先丢弃尚未装填的帧 */
+
+struct rt_pwm_frame {
+    uint32_t period;            /* 时基周期数, 0 = 停止 */
+    uint32_t enable;            /* 通道使能位图 */
+    uint32_t hold;              /* 保持的PWM周期数, 0按1计 */
+    uint32_t width[RT_PWM_MAX_CHANNELS];
+};
+
+void rt_pwm_init(void);
+
+/* 处理HETERO_MSG_RT_PWM_BATCH, 成功返回0 (arg1填队列帧数), 其他命令返回1, 出错返回负的errno */
+int rt_pwm_command(struct hetero_msg *msg);
+
+/* 硬件已生效一帧, 等待装填下一帧; 读中断挂起CSR, 没有PWM硬件时也不访问总线 */
+static inline int rt_pwm_pending(void)
+{
+    uint32_t pending;
+
+    __asm__ volatile ("csrr %0, 0xFC0" : "=r"(pending));
+    return (pending >> 17) & 1;
+}
+
+/* 清除生效标志并装填下一帧 */
+void rt_pwm_service(void);
+
+#endif /* _RT_PWM_H */
@@ -63,6 +63,17 @@ def main():
     parser.add_argument("--spi-data-width", default=8,   type=int,       help="SPI data width (max bits per xfer).")
     parser.add_argument("--spi-clk-freq",   default=1e6, type=int,       help="SPI clock frequency.")
     parser.add_argument("--fdtoverlays",    default="",                  help="Device Tree Overlays to apply.")
+    parser.add_argument("--small-core-bursts", default="on", choices=["on", "off"], help="Small-core Wishbone bursts: on = pass CTI/BTE, off = classic single-beat cycles.")
+    parser.add_argument("--io-core-clk-freq", default=None, type=float,  help="IO core clock frequency (default: sys_clk, same domain as Linux).")
+    parser.add_argument("--rt-core-clk-freq", default=None, type=float,  help="RT core clock frequency (default: sys_clk, same domain as Linux).")
+    parser.add_argument("--shared-mem-coherent", action="store_true",  help="Put shared memory in main RAM behind the coherent DMA port (implies --with-coherent-dma).")
+    parser.add_argument("--l2-partition",   default="rt", choices=["rt", "off"], help="L2 partitioning (heterogeneous boards with l2_size): rt = RT core owns one L2 way, off = all masters share all ways.")
+    parser.add_argument("--l2-bypass",      default="",                  help="Comma-separated masters that do not allocate in L2 (io, rt, main).")
+    parser.add_argument("--i2c-offload",    action="store_true",         help="Give the I2C pins to the IO core; Linux uses the hetero_i2c adapter instead of bitbang i2c0.")
+    parser.add_argument("--spi-offload",    action="store_true",         help="Give the SPI pins to the IO core (8-bit words); Linux uses the hetero_spi controller.")
+    parser.add_argument("--pwm-offload",    action="store_true",         help="Give the RGB LED PWMs to the RT core; Linux submits setpoint batches (hetero_pwm_submit).")
+    parser.add_argument("--eth-offload",    action="store_true",         help="Put the IO core in the Ethernet RX path (filter/classify/timestamp); Linux uses the hetero_eth NAPI netdev.")
+    parser.add_argument("--bus-qos",        default="rt", choices=["rt", "rr"], help="Bus arbitration: rt = RT core masters first, rr = round-robin.")
     VexRiscvSMP.args_fill(parser)
     args = parser.parse_args()
 
@@ -90,6 +101,8 @@ def main():
 
         if "usb_host" in board.soc_capabilities:
             args.with_coherent_dma = True
+        if args.shared_mem_coherent and board.soc_kwargs.get("with_heterogeneous", False):
+            args.with_coherent_dma = True
 
         VexRiscvSMP.args_read(args)
 
@@ -142,6 +155,40 @@ def main():
         print(f"  - L2缓存: {soc_kwargs.get('l2_size', 0)}B")
         if soc_kwargs.get('with_heterogeneous', False):
             print(f"  - ★ 异构支持: 启用（将添加2个小核）")
+            soc_kwargs["bus_qos"] = args.bus_qos
+            soc_kwargs["small_core_bursts"] = args.small_core_bursts == "on"
+            if args.shared_mem_coherent:
+                soc_kwargs["shared_mem_coherent"] = True
+                print(f"  - 共享内存: 主存保留区, 经一致性DMA口")
+            soc_kwargs["io_core_clk_freq"] = args.io_core_clk_freq
+            soc_kwargs["rt_core_clk_freq"] = args.rt_core_clk_freq
+            for name, freq in [("IO核", args.io_core_clk_freq), ("RT核", args.rt_core_clk_freq)]:
+                if freq:
+                    print(f"  - {name}时钟: {freq/1e6:.0f}MHz (独立时钟域)")
+            print(f"  - 小核总线突发: {'增量突发' if args.small_core_bursts == 'on' else '经典单拍'}")
+            print(f"  - 总线仲裁: {'RT核优先' if args.bus_qos == 'rt' else '轮询'}")
+            if args.i2c_offload:
+                soc_kwargs["i2c_offload"] = True
+                print(f"  - I2C: 交给IO核 (hetero_i2c)")
+            if args.spi_offload:
+                soc_kwargs["spi_offload"] = True
+                print(f"  - SPI: 交给IO核 (hetero_spi)")
+            if args.pwm_offload:
+                soc_kwargs["pwm_offload"] = True
+                print(f"  - PWM: 交给RT核 (影子寄存器, 周期边界同步更新)")
+            if args.eth_offload:
+                if "ethernet" not in board.soc_capabilities:
+                    parser.error("--eth-offload: board has no ethernet")
+                soc_kwargs["eth_offload"] = True
+                print(f"  - 以太网: IO核预处理接收 (hetero_eth)")
+            soc_kwargs["l2_partition"] = args.l2_partition
+            soc_kwargs["l2_bypass"] = [m for m in args.l2_bypass.split(",") if m]
+            for m in soc_kwargs["l2_bypass"]:
+                if m not in ["io", "rt", "main"]:
+                    parser.error(f"--l2-bypass: unknown master {m}")
+            if soc_kwargs.get("l2_size", 0):
+                print(f"  - L2分区: {'RT核独占一路' if args.l2_partition == 'rt' else '不分区'}"
+                      + (f", 旁路: {args.l2_bypass}" if args.l2_bypass else ""))
 
         # SoC creation -----------------------------------------------------------------------------
         print(f"\n创建SoC...")
@@ -7,13 +7,22 @@
 # SPDX-License-Identifier: BSD-2-Clause
 
 import os
+import math
 import json
 import shutil
 import subprocess
+from functools import reduce
+from operator import or_
 
 from migen import *
+from migen.genlib import roundrobin
+from migen.genlib.cdc import MultiReg, PulseSynchronizer
+from migen.genlib.misc import split, displacer, chooser
+from migen.genlib.record import Record, layout_len
+from migen.genlib.fifo import SyncFIFO
 
 from litex.soc.interconnect.csr import *
+from litex.soc.interconnect.csr_eventmanager import *
 from litex.soc.integration.soc import SoCRegion
 from litex.soc.interconnect import wishbone
 
@@ -23,8 +32,1398 @@ from litex.soc.cores.spi     import SPIMaster
 from litex.soc.cores.bitbang import I2CMaster
 from litex.soc.cores.pwm     import PWM
 
+from liteeth.mac.core import LiteEthMACCore
+
 from litex.tools.litex_json2dts_linux import generate_dts
 
+# Heterogeneous Helpers ----------------------------------------------------------------------------
+
+class MainIPI(Module, AutoCSR):
+    """小核 -> Linux 的中断源, ipi_pending 中对应hart位非零时产生中断"""
+    def __init__(self, pending):
+        self.submodules.ev = EventManager()
+        self.ev.ipi = EventSourceLevel()
+        self.ev.finalize()
+
+        self.comb += self.ev.ipi.trigger.eq(pending != 0)
+
+class SharedSRAMAtomic(Module):
+    """共享SRAM + 原子操作窗口
+
+    所有主设备(Linux各hart和两个小核)都经系统总线访问本模块, 读-改-写在模块内
+    一次完成, 期间不响应其他访问, 因此对所有核都是原子的.
+
+    Wishbone不带主设备号, 上下文由软件放在别名地址里: 每个核只读写自己上下文
+    的operand/compare和别名窗口, 两步之间被其他核打断也不会串数据.
+    上下文: 0 Linux (各hart共用, 由驱动加锁串行), 1 IO核, 2 RT核, 3 保留.
+
+    偏移 (窗口共256KB):
+      0x00000  SRAM本体 (32KB)
+      0x08000 + ctx*8    operand[ctx], +4: compare[ctx]
+      0x10000 + ctx*0x4000 + off  ADD别名:  读 = fetch-add(operand[ctx]) 返回旧值; 写 = 原子加上写入值
+      0x20000 + ctx*0x4000 + off  SWAP别名: 读 = swap(operand[ctx]) 返回旧值; 写 = 普通写
+      0x30000 + ctx*0x4000 + off  CAS别名:  读返回旧值, 旧值 == compare[ctx] 时写入operand[ctx]
+
+    原子操作只覆盖SRAM的低16KB (off < 0x4000: 消息环, RT统计, 缓冲池), 高16KB的
+    vring不需要原子操作.
+
+    SRAM本体支持增量突发 (CTI=2, BTE线性/4/8/16回绕): 首拍2个周期, 之后每拍
+    1个周期, 读口提前一拍取下一个字. 原子窗口和上下文寄存器只做单拍访问
+    """
+    def __init__(self, size=0x8000, nctx=4):
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+
+        # # #
+
+        words     = size // 4
+        word_bits = log2_int(words)
+        amo_bits  = word_bits - 1
+        ctx_bits  = log2_int(nctx)
+
+        # 双口: 读口在突发时预取下一个字, 写口写当前字
+        mem  = Memory(32, words)
+        rd   = mem.get_port()
+        port = mem.get_port(write_capable=True, we_granularity=8)
+        self.specials += mem, rd, port
+
+        operand = Array(Signal(32, name=f"amo_operand{i}") for i in range(nctx))
+        compare = Array(Signal(32, name=f"amo_compare{i}") for i in range(nctx))
+
+        # 字地址: op = 0时[word_bits-1:0]为SRAM字偏移, [word_bits]选上下文寄存器;
+        # op = 1/2/3时[amo_bits-1:0]为字偏移, 其上ctx_bits位为上下文
+        op      = bus.adr[amo_bits + ctx_bits:amo_bits + ctx_bits + 2]
+        plain   = (op == 0) & ~bus.adr[word_bits]
+        regs    = (op == 0) &  bus.adr[word_bits]
+        ctx     = bus.adr[amo_bits:amo_bits + ctx_bits]
+        reg_ctx = bus.adr[1:1 + ctx_bits]
+        word    = Signal(word_bits)
+        self.comb += word.eq(Mux(op == 0, bus.adr[:word_bits], bus.adr[:amo_bits]))
+        old     = rd.dat_r
+
+        # 突发的下一个字地址, 回绕突发只在低2/3/4位内递增
+        next_word = Signal(word_bits)
+        self.comb += Case(bus.bte, {
+            0: next_word.eq(word + 1),
+            1: next_word.eq(Cat((word[:2] + 1)[:2], word[2:])),
+            2: next_word.eq(Cat((word[:3] + 1)[:3], word[3:])),
+            3: next_word.eq(Cat((word[:4] + 1)[:4], word[4:])),
+        })
+
+        # 读口当前地址, 下一拍rd.dat_r即为该地址的数据
+        rd_word = Signal(word_bits)
+        self.sync += rd_word.eq(rd.adr)
+
+        self.comb += [
+            rd.adr.eq(word),
+            port.adr.eq(word),
+        ]
+
+        self.submodules.fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(bus.cyc & bus.stb,
+                If(regs,
+                    NextState("REGS")
+                ).Elif(plain & (bus.cti == 2),
+                    NextState("BURST")
+                ).Else(
+                    NextState("RMW")
+                )
+            )
+        )
+        # SRAM本体的突发: 读口上一拍的地址就是本拍地址时应答, 同时预取下一个字;
+        # 主设备插入等待(stb无效)或换地址时重新取
+        burst_hit = Signal()
+        self.comb += burst_hit.eq(bus.cyc & bus.stb & plain & (rd_word == word))
+        fsm.act("BURST",
+            bus.ack.eq(burst_hit),
+            bus.dat_r.eq(old),
+            port.dat_w.eq(bus.dat_w),
+            If(burst_hit,
+                rd.adr.eq(next_word),
+                If(bus.we, port.we.eq(bus.sel))
+            ),
+            If(~bus.cyc | (burst_hit & (bus.cti != 2)),
+                NextState("IDLE")
+            )
+        )
+        # 上下文寄存器
+        fsm.act("REGS",
+            bus.ack.eq(1),
+            bus.dat_r.eq(Mux(bus.adr[0], compare[reg_ctx], operand[reg_ctx])),
+            NextState("IDLE")
+        )
+        self.sync += If(fsm.ongoing("REGS") & bus.we,
+            If(bus.adr[0],
+                compare[reg_ctx].eq(bus.dat_w)
+            ).Else(
+                operand[reg_ctx].eq(bus.dat_w)
+            )
+        )
+        # 读出旧值(同步读已完成), 同一拍写回新值并应答
+        fsm.act("RMW",
+            bus.ack.eq(1),
+            bus.dat_r.eq(old),
+            Case(op, {
+                0: [
+                    port.dat_w.eq(bus.dat_w),
+                    If(bus.we, port.we.eq(bus.sel)),
+                ],
+                1: [
+                    port.dat_w.eq(old + Mux(bus.we, bus.dat_w, operand[ctx])),
+                    port.we.eq(0xf),
+                ],
+                2: [
+                    port.dat_w.eq(Mux(bus.we, bus.dat_w, operand[ctx])),
+                    port.we.eq(0xf),
+                ],
+                3: [
+                    port.dat_w.eq(operand[ctx]),
+                    If(~bus.we & (old == compare[ctx]), port.we.eq(0xf)),
+                ],
+                "default": [],
+            }),
+            NextState("IDLE")
+        )
+
+class SharedMemCoherent(Module):
+    """DDR中的一致性共享内存: 与SharedSRAMAtomic相同的窗口布局, 数据经
+    VexRiscv-SMP的一致性DMA口存放在主存保留区 (base开始的size字节)
+
+    SRAM本体窗口直接转发到DMA总线 (保留CTI/BTE突发), Linux按可缓存方式映射
+    同一块物理内存, 由集群的一致性逻辑保证小核看到最新数据, 不需要刷缓存.
+    原子窗口在DMA总线上做读-改-写, 两次访问之间保持cyc, 其他DMA主设备不能插入;
+    Linux核的普通写不经过本模块, 所以原子访问的字只能经原子窗口修改.
+    地址译码和上下文与SharedSRAMAtomic一致
+    """
+    def __init__(self, base, size=0x8000, nctx=4):
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.dma = dma = wishbone.Interface(data_width=32, adr_width=30)
+
+        # # #
+
+        words     = size // 4
+        word_bits = log2_int(words)
+        amo_bits  = word_bits - 1
+        ctx_bits  = log2_int(nctx)
+
+        operand = Array(Signal(32, name=f"camo_operand{i}") for i in range(nctx))
+        compare = Array(Signal(32, name=f"camo_compare{i}") for i in range(nctx))
+
+        op      = bus.adr[amo_bits + ctx_bits:amo_bits + ctx_bits + 2]
+        plain   = (op == 0) & ~bus.adr[word_bits]
+        regs    = (op == 0) &  bus.adr[word_bits]
+        ctx     = bus.adr[amo_bits:amo_bits + ctx_bits]
+        reg_ctx = bus.adr[1:1 + ctx_bits]
+        word    = Signal(word_bits)
+        self.comb += word.eq(Mux(op == 0, bus.adr[:word_bits], bus.adr[:amo_bits]))
+        old     = Signal(32)
+        new     = Signal(32)
+        store   = Signal()
+
+        self.comb += [
+            dma.adr.eq((base >> 2) + word),
+            dma.sel.eq(0xf),
+        ]
+
+        self.submodules.fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(bus.cyc & bus.stb,
+                If(plain,
+                    NextState("PASS")
+                ).Elif(regs,
+                    NextState("REGS")
+                ).Else(
+                    NextState("READ")
+                )
+            )
+        )
+        # SRAM本体: 直接转发, 突发由DMA总线处理
+        fsm.act("PASS",
+            dma.cyc.eq(bus.cyc),
+            dma.stb.eq(bus.stb),
+            dma.we.eq(bus.we),
+            dma.sel.eq(bus.sel),
+            dma.dat_w.eq(bus.dat_w),
+            dma.cti.eq(bus.cti),
+            dma.bte.eq(bus.bte),
+            bus.dat_r.eq(dma.dat_r),
+            bus.ack.eq(dma.ack),
+            bus.err.eq(dma.err),
+            If(~bus.cyc | ((dma.ack | dma.err) & (bus.cti != 2)),
+                NextState("IDLE")
+            )
+        )
+        fsm.act("REGS",
+            bus.ack.eq(1),
+            bus.dat_r.eq(Mux(bus.adr[0], compare[reg_ctx], operand[reg_ctx])),
+            NextState("IDLE")
+        )
+        self.sync += If(fsm.ongoing("REGS") & bus.we,
+            If(bus.adr[0],
+                compare[reg_ctx].eq(bus.dat_w)
+            ).Else(
+                operand[reg_ctx].eq(bus.dat_w)
+            )
+        )
+        # 原子窗口: 读旧值 -> 写新值, 期间cyc不撤销
+        self.comb += Case(op, {
+            1: [new.eq(old + Mux(bus.we, bus.dat_w, operand[ctx])), store.eq(1)],
+            2: [new.eq(Mux(bus.we, bus.dat_w, operand[ctx])), store.eq(1)],
+            3: [new.eq(operand[ctx]), store.eq(~bus.we & (old == compare[ctx]))],
+            "default": [],
+        })
+        fsm.act("READ",
+            dma.cyc.eq(1),
+            dma.stb.eq(1),
+            If(dma.ack,
+                NextValue(old, dma.dat_r),
+                NextState("WRITE")
+            )
+        )
+        fsm.act("WRITE",
+            dma.cyc.eq(store),
+            dma.stb.eq(store),
+            dma.we.eq(1),
+            dma.dat_w.eq(new),
+            If(dma.ack | ~store,
+                NextState("ACK")
+            )
+        )
+        fsm.act("ACK",
+            bus.ack.eq(1),
+            bus.dat_r.eq(old),
+            NextState("IDLE")
+        )
+
+class HardwareSync(Module):
+    """计数信号量 + 事件标志组
+
+    偏移 (窗口4KB):
+      0x000 + n*4   SEM_TAKE[n]: 读 = 非零则减一, 返回减之前的计数(0表示失败); 写 = 设置计数
+      0x400 + n*4   SEM_GIVE[n]: 读 = 当前计数; 写 = 计数加上写入值(饱和)
+      0x800 + g*16  EVT_SET[g]:  读 = 标志; 写 = 置位
+            +4      EVT_CLR[g]:  写 = 清除
+            +8      EVT_MASK[g]: 等待的标志
+            +12     EVT_CFG[g]:  [7:0] 满足时触发的IPI位, [8] 1=全部满足 0=任一满足
+
+    信号量计数放在块RAM里, 一次读改写两拍, 数量可以扩展到256个;
+    事件组条件由0变1时在 irq 上产生一拍脉冲, 接到 ipi_pending
+    """
+    def __init__(self, num_sems=64, num_groups=16, count_width=16):
+        assert num_sems <= 256 and num_groups <= 64
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq = Signal(32)
+
+        # # #
+
+        # 字地址[9:8]选区域, [7:0]为对象编号
+        region = bus.adr[8:10]
+        index  = bus.adr[:8]
+
+        # 信号量 ---------------------------------------------------------------------------------
+        sems = Memory(count_width, num_sems)
+        port = sems.get_port(write_capable=True)
+        self.specials += sems, port
+
+        count_max = 2**count_width - 1
+        count     = port.dat_r
+        gived     = Signal(count_width + 1)
+        self.comb += [
+            port.adr.eq(index),
+            gived.eq(count + bus.dat_w[:count_width]),
+        ]
+
+        # 事件组 ---------------------------------------------------------------------------------
+        flags = Array(Signal(32, name=f"evt_flags{i}") for i in range(num_groups))
+        masks = Array(Signal(32, name=f"evt_mask{i}") for i in range(num_groups))
+        cfgs  = Array(Signal(9,  name=f"evt_cfg{i}") for i in range(num_groups))
+        group = bus.adr[2:2 + log2_int(num_groups)]
+        reg   = bus.adr[:2]
+
+        self.submodules.fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(bus.cyc & bus.stb,
+                If(region[1],
+                    NextState("EVT")
+                ).Else(
+                    NextState("SEM")
+                )
+            )
+        )
+        # 同步读出计数后, 同一拍写回
+        fsm.act("SEM",
+            bus.ack.eq(1),
+            bus.dat_r.eq(count),
+            If(region[0],
+                # GIVE
+                If(bus.we,
+                    port.dat_w.eq(Mux(gived > count_max, count_max, gived)),
+                    port.we.eq(1)
+                )
+            ).Else(
+                # TAKE
+                If(bus.we,
+                    port.dat_w.eq(bus.dat_w),
+                    port.we.eq(1)
+                ).Elif(count != 0,
+                    port.dat_w.eq(count - 1),
+                    port.we.eq(1)
+                )
+            ),
+            NextState("IDLE")
+        )
+        fsm.act("EVT",
+            bus.ack.eq(1),
+            Case(reg, {
+                0: bus.dat_r.eq(flags[group]),
+                2: bus.dat_r.eq(masks[group]),
+                3: bus.dat_r.eq(cfgs[group]),
+                "default": bus.dat_r.eq(0),
+            }),
+            NextState("IDLE")
+        )
+        self.sync += If(fsm.ongoing("EVT") & bus.we,
+            Case(reg, {
+                0: flags[group].eq(flags[group] | bus.dat_w),
+                1: flags[group].eq(flags[group] & ~bus.dat_w),
+                2: masks[group].eq(bus.dat_w),
+                3: cfgs[group].eq(bus.dat_w),
+            })
+        )
+
+        # 条件满足(上升沿)时触发目标核IPI
+        irqs = []
+        for i in range(num_groups):
+            hit   = flags[i] & masks[i]
+            match = Signal(name=f"evt_match{i}")
+            last  = Signal(name=f"evt_match{i}_d")
+            self.comb += match.eq((masks[i] != 0) &
+                Mux(cfgs[i][8], hit == masks[i], hit != 0))
+            self.sync += last.eq(match)
+            irqs.append(Mux(match & ~last, cfgs[i][:8], 0))
+        self.comb += self.irq.eq(reduce(or_, irqs))
+
+class QueueManager(Module):
+    """硬件缓冲区句柄队列 (空闲链表/工作队列)
+
+    偏移 (窗口4KB, 每个队列16字节):
+      0x00 + q*16  DATA[q]:   写 = 入队(满则丢弃并置溢出位); 读 = 出队, 空时返回0xFFFFFFFF
+            +4     COUNT[q]:  读 = 当前句柄数
+            +8     THRESH[q]: 句柄数达到阈值(非零)时触发中断
+            +12    CFG[q]:    [7:0] 触发的IPI位; [8] 溢出标志(读), 写1清除
+
+    所有队列共用一块RAM (num_queues*depth个字), 入队/出队各一次总线访问;
+    句柄数由低于阈值变为达到阈值时在 irq 上产生一拍脉冲
+    """
+    EMPTY = 0xffffffff
+
+    def __init__(self, num_queues=8, depth=64):
+        assert num_queues <= 256
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq = Signal(32)
+
+        # # #
+
+        depth_bits = log2_int(depth)
+        ptr_width  = depth_bits + 1
+
+        mem  = Memory(32, num_queues * depth)
+        port = mem.get_port(write_capable=True)
+        self.specials += mem, port
+
+        heads    = Array(Signal(ptr_width, name=f"qm_head{i}") for i in range(num_queues))
+        tails    = Array(Signal(ptr_width, name=f"qm_tail{i}") for i in range(num_queues))
+        threshs  = Array(Signal(ptr_width, name=f"qm_thresh{i}") for i in range(num_queues))
+        cfgs     = Array(Signal(8, name=f"qm_cfg{i}") for i in range(num_queues))
+        overflow = Array(Signal(name=f"qm_overflow{i}") for i in range(num_queues))
+        counts   = Array(Signal(ptr_width, name=f"qm_count{i}") for i in range(num_queues))
+        for i in range(num_queues):
+            self.comb += counts[i].eq(heads[i] - tails[i])
+
+        q     = bus.adr[2:2 + log2_int(num_queues)]
+        reg   = bus.adr[:2]
+        count = counts[q]
+        full  = count == depth
+        empty = count == 0
+
+        # RAM地址: 入队写head, 出队读tail
+        ptr = Mux(bus.we, heads[q], tails[q])[:depth_bits]
+        self.comb += [
+            port.adr.eq(Cat(ptr, q)),
+            port.dat_w.eq(bus.dat_w),
+        ]
+
+        self.submodules.fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(bus.cyc & bus.stb,
+                NextState("ACCESS")
+            )
+        )
+        # 同步读出队头后应答
+        fsm.act("ACCESS",
+            bus.ack.eq(1),
+            Case(reg, {
+                0: bus.dat_r.eq(Mux(empty, self.EMPTY, port.dat_r)),
+                1: bus.dat_r.eq(count),
+                2: bus.dat_r.eq(threshs[q]),
+                3: bus.dat_r.eq(Cat(cfgs[q], overflow[q])),
+            }),
+            If((reg == 0) & bus.we & ~full,
+                port.we.eq(1)
+            ),
+            NextState("IDLE")
+        )
+        self.sync += If(fsm.ongoing("ACCESS"),
+            Case(reg, {
+                0: If(bus.we,
+                        If(full,
+                            overflow[q].eq(1)
+                        ).Else(
+                            heads[q].eq(heads[q] + 1)
+                        )
+                    ).Elif(~empty,
+                        tails[q].eq(tails[q] + 1)
+                    ),
+                2: If(bus.we, threshs[q].eq(bus.dat_w)),
+                3: If(bus.we,
+                        cfgs[q].eq(bus.dat_w[:8]),
+                        If(bus.dat_w[8], overflow[q].eq(0))
+                    ),
+                "default": [],
+            })
+        )
+
+        # 占用数达到阈值(上升沿)时触发
+        irqs = []
+        for i in range(num_queues):
+            above = Signal(name=f"qm_above{i}")
+            last  = Signal(name=f"qm_above{i}_d")
+            self.comb += above.eq((threshs[i] != 0) & (counts[i] >= threshs[i]))
+            self.sync += last.eq(above)
+            irqs.append(Mux(above & ~last, cfgs[i], 0))
+        self.comb += self.irq.eq(reduce(or_, irqs))
+
+class CoreTimer(Module):
+    """小核机器定时器 (CLINT风格), 每个小核一个mtimecmp
+
+    mtime每个sys时钟加一, 与Linux (VexRiscv-SMP CLINT) 同一时基;
+    mtime >= mtimecmp[n] 时拉高小核n的 timerInterrupt, 写入更大的mtimecmp后撤销.
+
+    偏移 (窗口4KB):
+      0x00         MTIME_LO:       读 = mtime低32位, 同时锁存高32位 (高低两半取自同一周期)
+      0x04         MTIME_HI:       读 = 上次读MTIME_LO时锁存的高32位
+      0x08 + n*8   MTIMECMP_LO[n]
+      0x0C + n*8   MTIMECMP_HI[n]
+
+    mtime只读; mtimecmp复位为全1, 即不产生中断
+    """
+    def __init__(self, num_cores=2):
+        assert num_cores <= 8
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq   = Signal(num_cores)
+        self.mtime = mtime = Signal(64)
+
+        # # #
+
+        mtime_lo = Signal(32)
+        mtime_hi = Signal(32)
+        cmp_lo = Array(Signal(32, reset=2**32 - 1, name=f"mtimecmp{i}_lo") for i in range(num_cores))
+        cmp_hi = Array(Signal(32, reset=2**32 - 1, name=f"mtimecmp{i}_hi") for i in range(num_cores))
+
+        self.sync += mtime.eq(mtime + 1)
+
+        # 字地址[3:0]: 0/1为mtime, 2+2n/3+2n为mtimecmp[n]
+        word = bus.adr[:4]
+        core = bus.adr[1:4] - 1
+        hi   = word[0]
+
+        self.sync += [
+            bus.ack.eq(0),
+            If(bus.cyc & bus.stb & ~bus.ack,
+                bus.ack.eq(1),
+                # 应答拍才输出数据, 低32位也要在锁存高32位的同一拍取, 否则低位
+                # 跨过0xFFFFFFFF时读到的是进位前的高位和进位后的低位
+                If((word == 0) & ~bus.we,
+                    mtime_lo.eq(mtime[:32]),
+                    mtime_hi.eq(mtime[32:])
+                ),
+                If((word >= 2) & bus.we,
+                    If(hi,
+                        cmp_hi[core].eq(bus.dat_w)
+                    ).Else(
+                        cmp_lo[core].eq(bus.dat_w)
+                    )
+                )
+            )
+        ]
+        self.comb += Case(word, {
+            0: bus.dat_r.eq(mtime_lo),
+            1: bus.dat_r.eq(mtime_hi),
+            "default": bus.dat_r.eq(Mux(hi, cmp_hi[core], cmp_lo[core])),
+        })
+
+        for i in range(num_cores):
+            self.comb += self.irq[i].eq(mtime >= Cat(cmp_lo[i], cmp_hi[i]))
+
+class TimedMailbox(Module):
+    """定时投递邮箱: 消息在指定的mtime时刻出现在小核的槽里并触发IPI
+
+    每个小核num_slots个槽, 槽n = 小核*num_slots + s, 每槽32字节:
+      0x00 CMD, 0x04 SEQ, 0x08 ARG0, 0x0C ARG1  (与struct hetero_msg相同)
+      0x10 TIME_LO, 0x14 TIME_HI                 目标时刻 (CoreTimer的mtime)
+      0x18 CTRL: 写bit0 = 装填, 写bit1 = 释放(取消); 读bit0 = 已装填, bit1 = 已投递
+      0x1C FIRED: 读 = 所有已投递槽的位图
+
+    已装填的槽在 mtime >= TIME 的那一拍变为已投递, 并在 irq 上产生一拍
+    目标小核IPI位的脉冲; 小核读出消息后写CTRL bit1释放
+    """
+    def __init__(self, mtime, num_cores=2, num_slots=4):
+        nslots = num_cores * num_slots
+        assert nslots <= 32
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq = Signal(32)
+
+        # # #
+
+        # 每槽8个字: 0-3消息, 4-5时刻, 6控制, 7已投递位图
+        msgs   = Array(Array(Signal(32, name=f"tmbox{i}_w{w}") for w in range(4)) for i in range(nslots))
+        t_lo   = Array(Signal(32, name=f"tmbox{i}_time_lo") for i in range(nslots))
+        t_hi   = Array(Signal(32, name=f"tmbox{i}_time_hi") for i in range(nslots))
+        armed  = Array(Signal(name=f"tmbox{i}_armed") for i in range(nslots))
+        fired  = Array(Signal(name=f"tmbox{i}_fired") for i in range(nslots))
+        fire   = [Signal(name=f"tmbox{i}_fire") for i in range(nslots)]
+
+        reg  = bus.adr[:3]
+        slot = bus.adr[3:3 + log2_int(nslots, need_pow2=False)]
+        access = Signal()
+        self.comb += access.eq(bus.cyc & bus.stb & ~bus.ack)
+
+        self.sync += [
+            bus.ack.eq(access),
+            If(access & bus.we,
+                Case(reg, {
+                    4: t_lo[slot].eq(bus.dat_w),
+                    5: t_hi[slot].eq(bus.dat_w),
+                    6: [],
+                    7: [],
+                    "default": msgs[slot][reg[:2]].eq(bus.dat_w),
+                })
+            )
+        ]
+        self.comb += Case(reg, {
+            4: bus.dat_r.eq(t_lo[slot]),
+            5: bus.dat_r.eq(t_hi[slot]),
+            6: bus.dat_r.eq(Cat(armed[slot], fired[slot])),
+            7: bus.dat_r.eq(Cat(*fired)),
+            "default": bus.dat_r.eq(msgs[slot][reg[:2]]),
+        })
+
+        # 比较器: 装填后到达目标时刻即投递; 同一拍的CTRL写优先
+        irqs = []
+        for i in range(nslots):
+            ctrl_we = access & bus.we & (reg == 6) & (slot == i)
+            self.comb += fire[i].eq(armed[i] & (mtime >= Cat(t_lo[i], t_hi[i])))
+            self.sync += [
+                If(ctrl_we,
+                    If(bus.dat_w[1],
+                        armed[i].eq(0),
+                        fired[i].eq(0)
+                    ).Elif(bus.dat_w[0],
+                        armed[i].eq(1),
+                        fired[i].eq(0)
+                    )
+                ).Elif(fire[i],
+                    armed[i].eq(0),
+                    fired[i].eq(1)
+                )
+            ]
+            irqs.append(Mux(fire[i] & ~ctrl_we, 1 << (i // num_slots), 0))
+        self.comb += self.irq.eq(reduce(or_, irqs))
+
+class IrqRouter(Module, AutoCSR):
+    """中断路由矩阵: 外设中断源直接送到RT核, 需要时同时转发给Linux
+
+    sources[n]为电平输入 (已在sys域), 按polarity的边沿 (0上升沿, 1下降沿)
+    锁存到两组挂起位:
+      rt_pending:   rt掩码内的源, 电平输出rt_irq[n]接RT核 externalInterruptArray[1+n]
+      main_pending: main掩码内的源, 新置位时main_irq产生一拍, 置位Linux hart0的IPI
+    两组挂起位各自写1清除 (rt_clear/main_clear), 同一拍的清除优先;
+    stamp为最近一次锁存时mtime的低32位, 用于计算输入到响应的延迟
+    """
+    def __init__(self, mtime, num_sources=16):
+        assert num_sources <= 31
+        self.sources = Signal(num_sources)
+        self.rt_irq  = Signal(num_sources)
+        self.main_irq = Signal()
+
+        self.raw          = CSRStatus(num_sources, description="Current source levels")
+        self.polarity     = CSRStorage(num_sources, description="1 = falling edge, 0 = rising edge")
+        self.rt           = CSRStorage(num_sources, description="Route source to RT core externalInterruptArray[1+n]")
+        self.rt_pending   = CSRStatus(num_sources, description="Latched events routed to the RT core")
+        self.rt_clear     = CSRStorage(num_sources, description="Write 1 to clear rt_pending")
+        self.main         = CSRStorage(num_sources, description="Forward source to Linux (hart0 IPI)")
+        self.main_pending = CSRStatus(num_sources, description="Latched events forwarded to Linux")
+        self.main_clear   = CSRStorage(num_sources, description="Write 1 to clear main_pending")
+        self.stamp        = CSRStatus(32, description="mtime[31:0] of the last latched event")
+
+        # # #
+
+        prev = Signal(num_sources)
+        edge = Signal(num_sources)
+        rt_pending   = Signal(num_sources)
+        main_pending = Signal(num_sources)
+        rt_set   = Signal(num_sources)
+        main_set = Signal(num_sources)
+
+        pol = self.polarity.storage
+        self.sync += prev.eq(self.sources)
+        self.comb += [
+            edge.eq((self.sources & ~prev & ~pol) | (~self.sources & prev & pol)),
+            rt_set.eq(edge & self.rt.storage),
+            main_set.eq(edge & self.main.storage),
+        ]
+        self.sync += [
+            rt_pending.eq((rt_pending | rt_set) &
+                ~Mux(self.rt_clear.re, self.rt_clear.storage, 0)),
+            main_pending.eq((main_pending | main_set) &
+                ~Mux(self.main_clear.re, self.main_clear.storage, 0)),
+            If((rt_set | main_set) != 0,
+                self.stamp.status.eq(mtime[:32])
+            )
+        ]
+        self.comb += [
+            self.raw.status.eq(self.sources),
+            self.rt_pending.status.eq(rt_pending),
+            self.main_pending.status.eq(main_pending),
+            self.rt_irq.eq(rt_pending),
+            self.main_irq.eq(main_set != 0),
+        ]
+
+class IOCoreI2C(Module):
+    """交给IO核的I2C引脚, 时序由IO核固件 (firmware/io_core/io_i2c.c) 产生
+
+    SCL/SDA都是开漏: 写0拉低, 写1释放. 读回引脚实际电平, 用于从设备
+    时钟延展和读数据/ACK.
+
+    偏移 (窗口4KB):
+      0x00  OUT: bit0 SCL, bit1 SDA (复位为1, 释放)
+      0x04  IN:  bit0 SCL, bit1 SDA (两级同步)
+    """
+    def __init__(self, pads):
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+
+        # # #
+
+        out   = Signal(2, reset=0b11)
+        pin_i = Signal(2)
+        sync_i = Signal(2)
+
+        self.specials += [
+            Tristate(pads.scl, 0, ~out[0], pin_i[0]),
+            Tristate(pads.sda, 0, ~out[1], pin_i[1]),
+            MultiReg(pin_i, sync_i),
+        ]
+
+        self.sync += [
+            bus.ack.eq(0),
+            If(bus.cyc & bus.stb & ~bus.ack,
+                bus.ack.eq(1),
+                If(bus.we & (bus.adr[0] == 0),
+                    out.eq(bus.dat_w[:2])
+                )
+            )
+        ]
+        self.comb += bus.dat_r.eq(Mux(bus.adr[0], sync_i, out))
+
+class IOCoreSPI(Module):
+    """交给IO核的SPI主机: 不带CSR的LiteX SPIMaster, 前面加收发FIFO
+
+    IO核 (firmware/io_core/io_spi.c) 先填TX FIFO, 本模块在TX非空且RX未满时
+    立即开始下一个字, 字与字之间只隔一两个周期; 收到的字进RX FIFO.
+    片选为手动模式, 由软件在整个spi_message期间保持.
+
+    偏移 (窗口4KB):
+      0x00  DATA:   写 = 压入TX FIFO (满时丢弃), 读 = 弹出RX FIFO
+      0x04  STATUS: [7:0] TX FIFO字数, [15:8] RX FIFO字数, bit16 忙
+      0x08  CS:     片选位图, 1 = 选中
+      0x0C  DIV:    SCLK = sys_clk / DIV
+    """
+    def __init__(self, pads, sys_clk_freq, spi_clk_freq, data_width=8, depth=64):
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+
+        # # #
+
+        self.submodules.spi = spi = SPIMaster(pads, data_width, sys_clk_freq, spi_clk_freq, with_csr=False)
+        self.submodules.tx_fifo = tx = SyncFIFO(data_width, depth)
+        self.submodules.rx_fifo = rx = SyncFIFO(data_width, depth)
+
+        cs     = Signal(len(pads.cs_n))
+        div    = Signal(16, reset=int(math.ceil(sys_clk_freq/spi_clk_freq)))
+        active = Signal()
+        start  = Signal()
+
+        # SPIMaster空闲时done为1, 开始后的下一拍变为0, 移位结束回到1
+        self.comb += [
+            spi.cs.eq(cs),
+            spi.cs_mode.eq(1),
+            spi.length.eq(data_width),
+            spi.clk_divider.eq(div),
+            spi.mosi.eq(tx.dout),
+            start.eq(tx.readable & rx.writable & ~active & spi.done),
+            spi.start.eq(start),
+            tx.re.eq(start),
+            rx.din.eq(spi.miso),
+            rx.we.eq(active & spi.done),
+        ]
+        self.sync += If(start,
+            active.eq(1)
+        ).Elif(spi.done,
+            active.eq(0)
+        )
+
+        word  = bus.adr[:2]
+        bus_rd = bus.ack & ~bus.we
+        bus_wr = bus.ack & bus.we
+        self.sync += [
+            bus.ack.eq(0),
+            If(bus.cyc & bus.stb & ~bus.ack,
+                bus.ack.eq(1)
+            ),
+            If(bus_wr & (word == 2), cs.eq(bus.dat_w)),
+            If(bus_wr & (word == 3), div.eq(bus.dat_w)),
+        ]
+        self.comb += [
+            tx.din.eq(bus.dat_w),
+            tx.we.eq(bus_wr & (word == 0)),
+            rx.re.eq(bus_rd & (word == 0)),
+            Case(word, {
+                0: bus.dat_r.eq(rx.dout),
+                1: bus.dat_r.eq(Cat(tx.level, Constant(0, 8 - len(tx.level)),
+                                    rx.level, Constant(0, 8 - len(rx.level)),
+                                    tx.readable | active)),
+                2: bus.dat_r.eq(cs),
+                3: bus.dat_r.eq(div),
+            })
+        ]
+
+class RTCorePWM(Module):
+    """交给RT核的多通道PWM, 各通道共用一个周期计数器, 设定值经影子寄存器同步更新
+
+    RT核 (firmware/rt_core/rt_pwm.c) 写影子寄存器后写UPDATE装填; 当前设定值的
+    HOLD个周期用完后, 在周期边界一次把所有影子寄存器装入生效寄存器, 清除装填
+    并置位STATUS (接RT核 externalInterruptArray), RT核醒来装填下一组.
+    所以生效时刻只取决于硬件的周期计数, 与RT核的响应时间无关, 也不会出现
+    一个周期内新旧设定值混用的毛刺. 没有装填时保持当前设定值.
+
+    偏移 (窗口4KB), 时间单位为sys时钟周期:
+      0x00        PERIOD:   影子周期, 0 = 停止 (输出为低, 装填立即生效)
+      0x04        ENABLE:   影子通道使能位图
+      0x08        HOLD:     影子保持周期数, 0按1计
+      0x0C        UPDATE:   写bit0 = 装填, 读bit0 = 已装填未生效
+      0x10        STATUS:   bit0 = 影子寄存器已生效, 写1清除
+      0x14        CYCLES:   已完成的PWM周期数
+      0x20 + n*4  WIDTH[n]: 影子高电平周期数, 最多4个通道
+    """
+    def __init__(self, pads):
+        assert len(pads) <= 4
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq = Signal()
+
+        # # #
+
+        n = len(pads)
+        period_s = Signal(32)
+        enable_s = Signal(n)
+        hold_s   = Signal(32)
+        width_s  = Array(Signal(32, name=f"rt_pwm{i}_width_s") for i in range(n))
+        period   = Signal(32)
+        enable   = Signal(n)
+        hold     = Signal(32)
+        width    = [Signal(32, name=f"rt_pwm{i}_width") for i in range(n)]
+        armed    = Signal()
+        applied  = Signal()
+        counter  = Signal(32)
+        cycles   = Signal(32)
+
+        # 周期边界: 计数到PERIOD-1; 停止时每拍都可以装填
+        boundary = Signal()
+        tick     = Signal()
+        load     = Signal()
+        self.comb += [
+            boundary.eq((period != 0) & (counter == period - 1)),
+            tick.eq(boundary | (period == 0)),
+            load.eq(armed & tick & (hold <= 1)),
+        ]
+        self.sync += [
+            If(tick,
+                counter.eq(0)
+            ).Else(
+                counter.eq(counter + 1)
+            ),
+            If(boundary, cycles.eq(cycles + 1)),
+            If(load,
+                period.eq(period_s),
+                enable.eq(enable_s),
+                hold.eq(hold_s),
+                *[width[i].eq(width_s[i]) for i in range(n)]
+            ).Elif(boundary & (hold > 1),
+                hold.eq(hold - 1)
+            )
+        ]
+        for i in range(n):
+            self.comb += pads[i].eq(enable[i] & (period != 0) & (counter < width[i]))
+
+        word   = bus.adr[:4]
+        bus_wr = bus.cyc & bus.stb & ~bus.ack & bus.we
+        channel_ok = Signal()
+        self.comb += channel_ok.eq((word >= 8) & (word[:2] < n) & (word < 12))
+        self.sync += [
+            bus.ack.eq(0),
+            If(bus.cyc & bus.stb & ~bus.ack,
+                bus.ack.eq(1)
+            ),
+            If(bus_wr,
+                Case(word, {
+                    0: period_s.eq(bus.dat_w),
+                    1: enable_s.eq(bus.dat_w),
+                    2: hold_s.eq(bus.dat_w),
+                    "default": If(channel_ok, width_s[word[:2]].eq(bus.dat_w)),
+                })
+            ),
+            # 同一拍的装填写入优先于生效
+            If(bus_wr & (word == 3) & bus.dat_w[0],
+                armed.eq(1)
+            ).Elif(load,
+                armed.eq(0)
+            ),
+            If(load,
+                applied.eq(1)
+            ).Elif(bus_wr & (word == 4) & bus.dat_w[0],
+                applied.eq(0)
+            ),
+        ]
+        self.comb += [
+            Case(word, {
+                0: bus.dat_r.eq(period_s),
+                1: bus.dat_r.eq(enable_s),
+                2: bus.dat_r.eq(hold_s),
+                3: bus.dat_r.eq(armed),
+                4: bus.dat_r.eq(applied),
+                5: bus.dat_r.eq(cycles),
+                "default": bus.dat_r.eq(Mux(channel_ok, width_s[word[:2]], 0)),
+            }),
+            self.irq.eq(applied),
+        ]
+
+class IOCoreEthernet(Module):
+    """交给IO核的以太网MAC: LiteEthMACCore加上不带CSR的收发槽
+
+    接收: 帧写进编号最小的空闲接收槽, 第一个字到达时锁存mtime低32位作为时间戳;
+    无错的完整帧把 (长度, 槽号, 时间戳) 压入完成FIFO, FIFO非空时irq为高.
+    IO核 (firmware/io_core/io_eth.c) 过滤/分类后写RX_DONE弹出队首并释放其槽.
+    没有空闲槽时整帧丢弃计入RX_MISSED, MAC报错或超过一槽的帧计入RX_ERRORS.
+    发送: IO核把帧写进发送槽后写TX_START, 按写入顺序发送.
+
+    偏移 (窗口64KB), 每槽slot_size字节:
+      0x0000  RX_LEVEL:  完成FIFO中的帧数
+      0x0004  RX_FRAME:  队首帧 [11:0]长度 [19:16]槽号
+      0x0008  RX_STAMP:  队首帧的时间戳
+      0x000C  RX_DONE:   写 = 弹出队首并释放其槽
+      0x0010  RX_MISSED: 没有空闲槽丢弃的帧数
+      0x0014  RX_ERRORS: 出错丢弃的帧数
+      0x0018  TX_START:  写 [11:0]长度 [19:16]槽号, 排队发送; 长度为0或超过一槽时忽略
+      0x001C  TX_LEVEL:  排队及正在发送的帧数
+      0x0020  INFO:      [7:0]接收槽数 [15:8]发送槽数
+      0x4000  TX_SLOT[n]
+      0x8000  RX_SLOT[n] (只读)
+    """
+    def __init__(self, phy, mtime, nrxslots=8, ntxslots=2, slot_size=2048):
+        assert nrxslots <= 16 and ntxslots <= 8 and slot_size == 2048
+        self.bus = bus = wishbone.Interface(data_width=32, adr_width=30)
+        self.irq = Signal()
+
+        # # #
+
+        slot_bits = log2_int(slot_size // 4)
+        self.submodules.core = core = LiteEthMACCore(phy, dw=32, endianness="little")
+
+        # 接收 -------------------------------------------------------------------------------------
+        rx_mem = Memory(32, nrxslots << slot_bits)
+        rx_wr  = rx_mem.get_port(write_capable=True)
+        rx_rd  = rx_mem.get_port()
+        self.specials += rx_mem, rx_wr, rx_rd
+
+        # 完成FIFO: [11:0]长度 [15:12]槽号 [47:16]时间戳, 每项占一个槽, 不会溢出
+        self.submodules.rx_fifo = rx_fifo = SyncFIFO(48, nrxslots)
+
+        src     = core.source
+        free    = Signal(nrxslots, reset=2**nrxslots - 1)
+        first   = Signal(4)
+        slot    = Signal(4)
+        ptr     = Signal(slot_bits + 1)
+        length  = Signal(12)
+        stamp   = Signal(32)
+        error   = Signal()
+        nbytes  = Signal(3)
+        missed  = Signal(32)
+        errors  = Signal(32)
+        commit  = Signal()
+        release = Signal()
+
+        # 编号最小的空闲槽
+        for i in reversed(range(nrxslots)):
+            self.comb += If(free[i], first.eq(i))
+        self.comb += If(src.last,
+            Case(src.last_be, {
+                0b0001: nbytes.eq(1),
+                0b0010: nbytes.eq(2),
+                0b0100: nbytes.eq(3),
+                "default": nbytes.eq(4),
+            })
+        ).Else(
+            nbytes.eq(4)
+        )
+
+        self.submodules.rx_fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(src.valid,
+                If(free != 0,
+                    NextValue(slot, first),
+                    NextValue(ptr, 0),
+                    NextValue(length, 0),
+                    NextValue(error, 0),
+                    NextValue(stamp, mtime[:32]),
+                    NextState("RECEIVE")
+                ).Else(
+                    NextValue(missed, missed + 1),
+                    NextState("DISCARD")
+                )
+            )
+        )
+        # ptr最高位置位 = 槽已写满, 之后的字不再写入, 整帧按出错丢弃
+        fsm.act("RECEIVE",
+            src.ready.eq(1),
+            If(src.valid,
+                rx_wr.we.eq(~ptr[slot_bits]),
+                If(~ptr[slot_bits], NextValue(ptr, ptr + 1)),
+                NextValue(length, length + nbytes),
+                If(ptr[slot_bits] | (src.error != 0), NextValue(error, 1)),
+                If(src.last, NextState("COMMIT"))
+            )
+        )
+        fsm.act("COMMIT",
+            If(error,
+                NextValue(errors, errors + 1)
+            ).Else(
+                commit.eq(1)
+            ),
+            NextState("IDLE")
+        )
+        fsm.act("DISCARD",
+            src.ready.eq(1),
+            If(src.valid & src.last, NextState("IDLE"))
+        )
+
+        head_slot = rx_fifo.dout[12:16]
+        self.comb += [
+            rx_wr.adr.eq(Cat(ptr[:slot_bits], slot)),
+            rx_wr.dat_w.eq(src.data),
+            rx_fifo.din.eq(Cat(length, slot, stamp)),
+            rx_fifo.we.eq(commit),
+            rx_fifo.re.eq(release & rx_fifo.readable),
+            self.irq.eq(rx_fifo.readable),
+        ]
+        # 提交的是空闲槽, 释放的是队首的已占用槽, 同一拍不会是同一个槽
+        for i in range(nrxslots):
+            self.sync += If(commit & (slot == i),
+                free[i].eq(0)
+            ).Elif(rx_fifo.re & (head_slot == i),
+                free[i].eq(1)
+            )
+
+        # 发送 -------------------------------------------------------------------------------------
+        tx_mem = Memory(32, ntxslots << slot_bits)
+        tx_rd  = tx_mem.get_port()
+        tx_wr  = tx_mem.get_port(write_capable=True, we_granularity=8)
+        self.specials += tx_mem, tx_rd, tx_wr
+
+        # 发送命令FIFO: [11:0]长度 [15:12]槽号, 帧发完才弹出
+        self.submodules.tx_fifo = tx_fifo = SyncFIFO(16, ntxslots)
+
+        sink    = core.sink
+        tx_len  = tx_fifo.dout[:12]
+        tx_slot = tx_fifo.dout[12:16]
+        tx_ptr  = Signal(slot_bits)
+        tx_last = Signal()
+        last_be = Signal(4)
+        advance = Signal()
+
+        self.comb += [
+            tx_last.eq(tx_ptr == (tx_len - 1)[2:]),
+            Case(tx_len[:2], {
+                1: last_be.eq(0b0001),
+                2: last_be.eq(0b0010),
+                3: last_be.eq(0b0100),
+                0: last_be.eq(0b1000),
+            }),
+            # 同步读口: 前进的这一拍就给出下一个字的地址
+            tx_rd.adr.eq(Cat(Mux(advance, tx_ptr + 1, tx_ptr)[:slot_bits], tx_slot)),
+        ]
+
+        self.submodules.tx_fsm = tfsm = FSM(reset_state="IDLE")
+        tfsm.act("IDLE",
+            NextValue(tx_ptr, 0),
+            If(tx_fifo.readable, NextState("PREFETCH"))
+        )
+        tfsm.act("PREFETCH",
+            NextState("SEND")
+        )
+        tfsm.act("SEND",
+            sink.valid.eq(1),
+            sink.data.eq(tx_rd.dat_r),
+            sink.last.eq(tx_last),
+            sink.last_be.eq(Mux(tx_last, last_be, 0)),
+            If(sink.ready,
+                advance.eq(1),
+                NextValue(tx_ptr, tx_ptr + 1),
+                If(tx_last,
+                    tx_fifo.re.eq(1),
+                    NextState("IDLE")
+                )
+            )
+        )
+
+        # 总线 -------------------------------------------------------------------------------------
+        region = bus.adr[12:14]    # 0 = 寄存器, 1 = 发送槽, 2/3 = 接收槽
+        word   = bus.adr[:4]
+        access = Signal()
+        reg_wr = Signal()
+        self.comb += [
+            access.eq(bus.cyc & bus.stb & ~bus.ack),
+            reg_wr.eq(access & bus.we & (region == 0)),
+            release.eq(reg_wr & (word == 3)),
+            tx_fifo.din.eq(Cat(bus.dat_w[:12], bus.dat_w[16:20])),
+            tx_fifo.we.eq(reg_wr & (word == 6) &
+                (bus.dat_w[:12] != 0) & (bus.dat_w[:12] <= slot_size)),
+            rx_rd.adr.eq(bus.adr[:13]),
+            tx_wr.adr.eq(bus.adr[:12]),
+            tx_wr.dat_w.eq(bus.dat_w),
+            If(access & bus.we & (region == 1),
+                tx_wr.we.eq(bus.sel)
+            ),
+        ]
+        # 槽是同步读, ack晚一拍, 这时主设备仍保持地址
+        self.sync += bus.ack.eq(access)
+        self.comb += Case(region, {
+            0: Case(word, {
+                0: bus.dat_r.eq(rx_fifo.level),
+                1: bus.dat_r.eq(Cat(rx_fifo.dout[:12], Constant(0, 4), head_slot)),
+                2: bus.dat_r.eq(rx_fifo.dout[16:48]),
+                4: bus.dat_r.eq(missed),
+                5: bus.dat_r.eq(errors),
+                7: bus.dat_r.eq(tx_fifo.level),
+                8: bus.dat_r.eq(Cat(Constant(nrxslots, 8), Constant(ntxslots, 8))),
+                "default": bus.dat_r.eq(0),
+            }),
+            1: bus.dat_r.eq(tx_wr.dat_r),
+            "default": bus.dat_r.eq(rx_rd.dat_r),
+        })
+
+class QoSArbiter(Module):
+    """带优先级的Wishbone仲裁器, 替代LiteX共享互连的轮询仲裁
+
+    所有主设备轮询; enable为1时 high 中的主设备按列表顺序固定优先,
+    有高优先级请求时轮询指针不前进. 与 wishbone.Arbiter 一样授权保持到
+    当前主设备撤销cyc, 不打断进行中的周期, 所以高优先级主设备最多等待
+    一个其他主设备的周期 (含突发)
+    """
+    def __init__(self, high, low, target):
+        masters = high + low
+        n = len(masters)
+        self.enable = Signal(reset=1)
+        self.grant  = grant = Signal(max=max(n, 2))
+
+        # # #
+
+        requests = Array(m.cyc for m in masters)
+        high_req = Signal()
+        pick     = Signal(max=max(n, 2))
+        rearb    = Signal()
+
+        self.submodules.rr = rr = roundrobin.RoundRobin(n, roundrobin.SP_CE)
+        self.comb += [
+            rr.request.eq(Cat(*[m.cyc for m in masters])),
+            high_req.eq(self.enable & reduce(or_, [m.cyc for m in high], 0)),
+            rearb.eq(~requests[grant]),
+            rr.ce.eq(rearb & ~high_req),
+            pick.eq(rr.grant),
+        ]
+        # 列表靠前的优先, 后写的赋值生效
+        for i in reversed(range(len(high))):
+            self.comb += If(self.enable & high[i].cyc, pick.eq(i))
+        self.sync += If(rearb, grant.eq(pick))
+
+        # 主设备 -> 目标
+        for name, size, direction in wishbone._layout:
+            if direction == DIR_M_TO_S:
+                choices = Array(getattr(m, name) for m in masters)
+                self.comb += getattr(target, name).eq(choices[grant])
+
+        # 目标 -> 主设备, ack/err只给当前授权的主设备
+        for name, size, direction in wishbone._layout:
+            if direction == DIR_S_TO_M:
+                source = getattr(target, name)
+                for i, m in enumerate(masters):
+                    dest = getattr(m, name)
+                    if name in ["ack", "err"]:
+                        self.comb += dest.eq(source & (grant == i))
+                    else:
+                        self.comb += dest.eq(source)
+
+class HeteroL2Cache(Module):
+    """分路组相联L2, 替代LiteX add_sdram里的直接映射 wishbone.Cache
+
+    接口与 wishbone.Cache 相同 (cachesize按32位字计, slave位宽 >= master,
+    一行 = slave一拍). 查找时比较所有路, 同一地址最多在一路里, 所以分区和
+    旁路随时可以切换, 不需要刷缓存.
+
+    way_mask 由外部按当前主设备给出, 未命中时只在其中的路里替换 (轮转指针);
+    为0表示旁路: 命中照常, 未命中直接访问slave且不分配.
+    hit/miss 在每次访问判定时各脉冲一个周期
+    """
+    def __init__(self, cachesize, master, slave, reverse=True, ways=4, **kwargs):
+        self.master   = master
+        self.slave    = slave
+        self.way_mask = Signal(ways, reset=2**ways - 1)
+        self.hit      = Signal()
+        self.miss     = Signal()
+
+        # # #
+
+        dw_from = len(master.dat_r)
+        dw_to   = len(slave.dat_r)
+        assert dw_to >= dw_from
+        assert ways >= 2 and ways & (ways - 1) == 0
+
+        # 地址: TAG | SET | OFFSET (OFFSET = 行内32位字)
+        offsetbits  = log2_int(dw_to//dw_from)
+        addressbits = len(slave.adr) + offsetbits
+        setbits     = log2_int(cachesize//ways) - offsetbits
+        tagbits     = addressbits - setbits
+        adr_offset, adr_set, adr_tag = split(master.adr, offsetbits, setbits, tagbits)
+
+        if adr_offset is None:
+            adr_offset_r = None
+        else:
+            adr_offset_r = Signal(offsetbits, reset_less=True)
+            self.sync += adr_offset_r.eq(adr_offset)
+
+        wbits      = log2_int(ways)
+        victim     = Signal(wbits)
+        victim_r   = Signal(wbits)
+        rr         = Signal(wbits)
+        hit_way    = Signal(wbits)
+        hits       = Signal(ways)
+        refill     = Signal()
+        refilled   = Signal()
+        master_we  = Signal()
+        tag_we     = Signal()
+        tag_dirty  = Signal()
+
+        # 每路一块数据RAM和标签RAM, 都用master地址的SET寻址
+        tag_layout = [("tag", tagbits), ("valid", 1), ("dirty", 1)]
+        tag_do = []
+        data_r = []
+        for w in range(ways):
+            data_mem  = Memory(dw_to, 2**setbits)
+            data_port = data_mem.get_port(write_capable=True, we_granularity=8)
+            tag_mem   = Memory(layout_len(tag_layout), 2**setbits)
+            tag_port  = tag_mem.get_port(write_capable=True)
+            self.specials += data_mem, data_port, tag_mem, tag_port
+
+            do = Record(tag_layout)
+            di = Record(tag_layout)
+            self.comb += [
+                data_port.adr.eq(adr_set),
+                tag_port.adr.eq(adr_set),
+                do.raw_bits().eq(tag_port.dat_r),
+                tag_port.dat_w.eq(di.raw_bits()),
+                hits[w].eq(do.valid & (do.tag == adr_tag)),
+                If(refill,
+                    data_port.dat_w.eq(slave.dat_r),
+                    If(victim_r == w, data_port.we.eq(2**(dw_to//8) - 1)),
+                    di.tag.eq(adr_tag),
+                    di.valid.eq(1),
+                    tag_port.we.eq(victim_r == w)
+                ).Else(
+                    data_port.dat_w.eq(Replicate(master.dat_w, dw_to//dw_from)),
+                    If(master_we & (hit_way == w),
+                        displacer(master.sel, adr_offset, data_port.we, 2**offsetbits, reverse=reverse)
+                    ),
+                    di.raw_bits().eq(do.raw_bits()),
+                    di.dirty.eq(tag_dirty),
+                    tag_port.we.eq(tag_we & (hit_way == w))
+                )
+            ]
+            tag_do.append(do)
+            data_r.append(data_port.dat_r)
+
+        # 命中路编码
+        for w in range(ways):
+            self.comb += If(hits[w], hit_way.eq(w))
+
+        # 替换路: 从rr开始的第一个允许的路, 靠前的赋值最后写以优先
+        for k in reversed(range(ways)):
+            cand = Signal(wbits)
+            self.comb += [
+                cand.eq(rr + k),
+                If(Array(self.way_mask[i] for i in range(ways))[cand], victim.eq(cand))
+            ]
+
+        tags_r    = Array(do.tag for do in tag_do)
+        dirty_r   = Array(do.valid & do.dirty for do in tag_do)
+        data_r    = Array(data_r)
+        evict_dat = Signal(dw_to)
+        self.comb += [
+            evict_dat.eq(data_r[victim_r]),
+            slave.sel.eq(2**(dw_to//8) - 1),
+            slave.dat_w.eq(evict_dat),
+            chooser(data_r[hit_way], adr_offset_r, master.dat_r, reverse=reverse),
+        ]
+
+        self.submodules.fsm = fsm = FSM(reset_state="IDLE")
+        fsm.act("IDLE",
+            If(master.cyc & master.stb,
+                NextState("TEST_HIT")
+            )
+        )
+        fsm.act("TEST_HIT",
+            If(hits != 0,
+                # 重填后的再次命中不计数
+                self.hit.eq(~refilled),
+                NextValue(refilled, 0),
+                master.ack.eq(1),
+                If(master.we,
+                    master_we.eq(1),
+                    tag_we.eq(1),
+                    tag_dirty.eq(1)
+                ),
+                NextState("IDLE")
+            ).Elif(self.way_mask == 0,
+                self.miss.eq(1),
+                NextState("BYPASS")
+            ).Else(
+                self.miss.eq(1),
+                NextValue(victim_r, victim),
+                NextValue(rr, rr + 1),
+                If(dirty_r[victim],
+                    NextState("EVICT")
+                ).Else(
+                    NextState("REFILL")
+                )
+            )
+        )
+        fsm.act("EVICT",
+            slave.cyc.eq(1),
+            slave.stb.eq(1),
+            slave.we.eq(1),
+            slave.adr.eq(Cat(adr_set, tags_r[victim_r])),
+            If(slave.ack,
+                NextState("REFILL")
+            )
+        )
+        fsm.act("REFILL",
+            slave.cyc.eq(1),
+            slave.stb.eq(1),
+            slave.adr.eq(Cat(adr_set, adr_tag)),
+            If(slave.ack,
+                refill.eq(1),
+                NextValue(refilled, 1),
+                NextState("WAIT")
+            )
+        )
+        # 等标签RAM读出新写入的标签, 再回到TEST_HIT命中
+        fsm.act("WAIT",
+            NextState("TEST_HIT")
+        )
+
+        # 旁路: 单拍直通slave, 只写master选中的字节
+        bypass_dat = Signal(dw_from)
+        self.comb += chooser(slave.dat_r, adr_offset_r, bypass_dat, reverse=reverse)
+        fsm.act("BYPASS",
+            slave.cyc.eq(1),
+            slave.stb.eq(1),
+            slave.we.eq(master.we),
+            slave.adr.eq(Cat(adr_set, adr_tag)),
+            slave.dat_w.eq(Replicate(master.dat_w, dw_to//dw_from)),
+            displacer(master.sel, adr_offset, slave.sel, 2**offsetbits, reverse=reverse),
+            If(slave.ack,
+                master.ack.eq(1),
+                master.dat_r.eq(bypass_dat),
+                NextState("IDLE")
+            )
+        )
+
+class WishboneAsyncBridge(Module):
+    """跨时钟域Wishbone桥: 小核时钟域的主设备 -> sys域系统总线
+
+    请求和应答各用一个翻转脉冲同步器传递. 主设备在ack之前保持adr/dat_w/sel/we
+    不变 (Wishbone要求), 所以sys侧在请求脉冲到达后采样时已稳定; dat_r/err在sys域
+    锁存后才发回应答脉冲, 同样稳定. 每次访问多出约4个同步周期, 突发按单拍转发
+    """
+    def __init__(self, cd_master, cd_slave="sys"):
+        self.master = master = wishbone.Interface(data_width=32, adr_width=30)
+        self.slave  = slave  = wishbone.Interface(data_width=32, adr_width=30)
+
+        # # #
+
+        req = PulseSynchronizer(cd_master, cd_slave)
+        ack = PulseSynchronizer(cd_slave, cd_master)
+        self.submodules += req, ack
+
+        # 主设备侧: 发出请求后等应答脉冲
+        pending = Signal()
+        dat_r   = Signal(32)
+        err     = Signal()
+        self.comb += [
+            req.i.eq(master.cyc & master.stb & ~pending),
+            master.ack.eq(ack.o & ~err),
+            master.err.eq(ack.o & err),
+            master.dat_r.eq(dat_r),
+        ]
+        sync_m = getattr(self.sync, cd_master)
+        sync_m += If(req.i,
+            pending.eq(1)
+        ).Elif(ack.o,
+            pending.eq(0)
+        )
+
+        # sys侧: 用主设备保持的地址/数据发起一次经典周期
+        active = Signal()
+        done   = Signal()
+        self.comb += [
+            slave.cyc.eq(active),
+            slave.stb.eq(active),
+            slave.adr.eq(master.adr),
+            slave.dat_w.eq(master.dat_w),
+            slave.sel.eq(master.sel),
+            slave.we.eq(master.we),
+            done.eq(active & (slave.ack | slave.err)),
+            ack.i.eq(done),
+        ]
+        sync_s = getattr(self.sync, cd_slave)
+        sync_s += [
+            If(req.o,
+                active.eq(1)
+            ).Elif(done,
+                active.eq(0)
+            ),
+            If(done,
+                dat_r.eq(slave.dat_r),
+                err.eq(slave.err)
+            )
+        ]
+
 # SoCLinux -----------------------------------------------------------------------------------------
 
 def SoCLinux(soc_cls, **kwargs):
@@ -32,6 +1431,31 @@ def SoCLinux(soc_cls, **kwargs):
         def __init__(self, **kwargs):
             # 检查是否启用异构系统
             self.with_heterogeneous = kwargs.pop("with_heterogeneous", False)
+            # 总线仲裁: "rt" = RT核主设备固定最高优先级, "rr" = LiteX默认轮询
+            self.bus_qos = kwargs.pop("bus_qos", "rt")
+            # 小核总线突发: True = 透传CTI/BTE (缓存行填充为一次增量突发),
+            # False = 转为经典单拍周期, 用于不能正确处理CTI的主总线桥
+            self.small_core_bursts = kwargs.pop("small_core_bursts", True)
+            # 小核时钟频率 (IO核, RT核), None = 与Linux同在sys域
+            self.small_core_clk_freq = [
+                kwargs.pop("io_core_clk_freq", None),
+                kwargs.pop("rt_core_clk_freq", None),
+            ]
+            self._small_core_cds = {}
+            # 共享内存放在DDR保留区, 经SMP集群的一致性DMA口访问 (需要 --with-coherent-dma)
+            self.shared_mem_coherent = kwargs.pop("shared_mem_coherent", False)
+            # L2分区: "rt" = RT核独占一路, 其他主设备用其余各路, "off" = 不分区;
+            # l2_bypass: 未命中不分配的主设备 ("main", "io", "rt"), 运行时可由l2_ctrl修改
+            self.l2_partition = kwargs.pop("l2_partition", "rt")
+            self.l2_bypass    = kwargs.pop("l2_bypass", [])
+            # I2C引脚交给IO核, Linux经邮箱提交整个传输 (driver_v3/hetero_i2c.c)
+            self.i2c_offload  = kwargs.pop("i2c_offload", False)
+            # SPI交给IO核, Linux为spi_controller (driver_v3/hetero_spi.c)
+            self.spi_offload  = kwargs.pop("spi_offload", False)
+            # RGB LED的PWM交给RT核, Linux成批提交设定值 (hetero_pwm_submit)
+            self.pwm_offload  = kwargs.pop("pwm_offload", False)
+            # 以太网接收交给IO核过滤/分类, Linux为NAPI网卡 (driver_v3/hetero_eth.c)
+            self.eth_offload  = kwargs.pop("eth_offload", False)
             
             # SoC ----------------------------------------------------------------------------------
             # 不要硬编码cpu_type和cpu_variant，让它们通过kwargs传递
@@ -58,35 +1482,88 @@ def SoCLinux(soc_cls, **kwargs):
             # 3. 添加邮箱通信
             self._add_mailbox_system()
             
-            # 4. 添加硬件互斥锁
+            # 4. 添加硬件互斥锁和同步块
             self._add_hardware_mutex()
+            self._add_hardware_sync()
             
-            # 5. 添加小核
+            # 5. 添加小核定时器和小核
+            self._add_core_timer()
+            self._add_timed_mailbox()
+            self._add_global_timebase()
+            self._add_irq_router()
             self._add_small_cores()
             
+            # 板级BaseSoC已调用过add_ethernet, 这时才有mtime和IO核的中断线
+            if getattr(self, "_io_eth_phy", None) is not None:
+                self._add_io_core_ethernet(self._io_eth_phy)
+            
+            # 硬件IPI源接入 ipi_pending
+            self._connect_ipi_sources()
+            
             # 6. 添加常量定义
             self.add_constant("HETEROGENEOUS_ENABLED", 1)
             self.add_constant("NUM_SMALL_CORES", 2)
             self.add_constant("SHARED_MEM_BASE", 0x80100000)
             self.add_constant("SHARED_MEM_SIZE", 0x8000)
+            self.add_constant("SHARED_MEM_AMO_CTX", 0x80108000)
+            self.add_constant("SHARED_MEM_AMO_ADD", 0x80110000)
+            self.add_constant("SHARED_MEM_AMO_SWAP", 0x80120000)
+            self.add_constant("SHARED_MEM_AMO_CAS", 0x80130000)
             
             print("\n✓ 异构系统支持已添加")
 
         def _add_shared_memory(self):
             """添加共享内存区域"""
-            print("  添加共享内存 (32KB @ 0x80100000)...")
+            if self.shared_mem_coherent:
+                self._add_shared_memory_coherent()
+                return
             
-            # 在系统总线上预留共享内存区域
-            self.bus.add_region(
+            print("  添加共享内存 (32KB @ 0x80100000, 含原子操作窗口)...")
+            
+            # 共享SRAM挂在系统总线上, 后面跟原子操作别名窗口
+            self.submodules.shared_sram = SharedSRAMAtomic(size=0x8000)
+            self.bus.add_slave(
                 "shared_mem",
+                self.shared_sram.bus,
                 SoCRegion(
                     origin = 0x80100000,
-                    size   = 0x8000,  # 32KB
+                    size   = 0x40000,  # 32KB SRAM + 原子窗口
                     mode   = "rw",
                     cached = False     # 非缓存，保证一致性
                 )
             )
 
+        def _add_shared_memory_coherent(self):
+            """共享内存放在主存最高32KB, 小核经一致性DMA口访问
+
+            小核看到的地址不变 (0x80100000起, 含原子窗口); Linux从设备树的
+            reserved-memory "hetero-shm" 找到物理地址并按可缓存方式映射
+            """
+            if not hasattr(self, "dma_bus"):
+                raise ValueError("一致性共享内存需要VexRiscv-SMP一致性DMA口 (--with-coherent-dma)")
+            if "main_ram" not in self.bus.regions:
+                raise ValueError("一致性共享内存需要main_ram区域")
+            
+            main_ram = self.bus.regions["main_ram"]
+            phys = main_ram.origin + main_ram.size - 0x8000
+            print(f"  添加一致性共享内存 (32KB, 主存0x{phys:08x}, 经DMA口)...")
+            
+            self.submodules.shared_sram = SharedMemCoherent(base=phys, size=0x8000)
+            self.bus.add_slave(
+                "shared_mem",
+                self.shared_sram.bus,
+                SoCRegion(
+                    origin = 0x80100000,
+                    size   = 0x40000,  # 32KB窗口 + 原子窗口
+                    mode   = "rw",
+                    cached = False     # 小核侧; Linux经主存映射访问
+                )
+            )
+            self.dma_bus.add_master("shared_mem", master=self.shared_sram.dma)
+            
+            self.add_constant("SHARED_MEM_COHERENT", 1)
+            self.add_constant("SHARED_MEM_PHYS", phys)
+
         def _add_inter_core_interrupts(self):
             """添加核间中断机制"""
             print("  添加核间中断系统...")
@@ -110,17 +1587,18 @@ def SoCLinux(soc_cls, **kwargs):
             # 内部中断信号
             ipi_pending = Signal(32)
             
-            # 中断逻辑
-            self.sync += [
-                # 触发中断
-                If(self.ipi_trigger.re,
-                    ipi_pending.eq(ipi_pending | self.ipi_trigger.storage)
-                ),
-                # 清除中断
-                If(self.ipi_clear.re,
-                    ipi_pending.eq(ipi_pending & ~self.ipi_clear.storage)
-                )
+            # 硬件中断源 (同步块/定时器等), 在 _connect_ipi_sources 里汇总
+            self.ipi_hw_set  = Signal(32)
+            self.ipi_sources = []
+            
+            # 中断逻辑: 软件触发和硬件源置位, 同一拍的清除优先
+            ipi_set   = Signal(32)
+            ipi_clear = Signal(32)
+            self.comb += [
+                ipi_set.eq(self.ipi_hw_set | Mux(self.ipi_trigger.re, self.ipi_trigger.storage, 0)),
+                ipi_clear.eq(Mux(self.ipi_clear.re, self.ipi_clear.storage, 0)),
             ]
+            self.sync += ipi_pending.eq((ipi_pending | ipi_set) & ~ipi_clear)
             
             # 连接到状态寄存器
             self.comb += self.ipi_status.status.eq(ipi_pending & self.ipi_enable.storage)
@@ -128,6 +1606,14 @@ def SoCLinux(soc_cls, **kwargs):
             # 保存中断信号供小核使用
             self.ipi_pending = ipi_pending
 
+            # IPI位分配: bit0 IO核, bit1 RT核, bit2-5 Linux hart0-3
+            # 每个hart一路中断接入Linux中断控制器, 由中断亲和性绑定到对应hart
+            for hart in range(4):
+                bit = 2 + hart
+                setattr(self.submodules, f"main_ipi{hart}",
+                    MainIPI(ipi_pending[bit] & self.ipi_enable.storage[bit]))
+                self.irq.add(f"main_ipi{hart}", use_loc_if_exists=True)
+
         def _add_mailbox_system(self):
             """添加邮箱通信系统"""
             print("  添加邮箱系统...")
@@ -142,13 +1628,29 @@ def SoCLinux(soc_cls, **kwargs):
                 setattr(self.submodules, f"mbox_main_to_core{core_id}_status",
                     CSRStatus(8, name=f"mbox_main_to_core{core_id}_status"))
                 
-                # 小核到主核的邮箱
+                # 小核到主核的邮箱（小核通过总线写入，需为可写寄存器）
                 setattr(self.submodules, f"mbox_core{core_id}_to_main_resp",
-                    CSRStatus(32, name=f"mbox_core{core_id}_to_main_resp"))
+                    CSRStorage(32, name=f"mbox_core{core_id}_to_main_resp"))
                 setattr(self.submodules, f"mbox_core{core_id}_to_main_data",
-                    CSRStatus(32, name=f"mbox_core{core_id}_to_main_data"))
+                    CSRStorage(32, name=f"mbox_core{core_id}_to_main_data"))
                 setattr(self.submodules, f"mbox_core{core_id}_to_main_ctrl",
                     CSRStorage(8, name=f"mbox_core{core_id}_to_main_ctrl"))
+                
+                # 邮箱状态: bit0=命令未被小核取走, bit1=有未确认的响应
+                # 小核写resp置位bit1, 主核向ctrl写bit0确认后清除
+                cmd    = getattr(self, f"mbox_main_to_core{core_id}_cmd")
+                resp   = getattr(self, f"mbox_core{core_id}_to_main_resp")
+                ctrl   = getattr(self, f"mbox_core{core_id}_to_main_ctrl")
+                status = getattr(self, f"mbox_main_to_core{core_id}_status")
+                rx_pending = Signal(name=f"mbox_core{core_id}_rx_pending")
+                self.sync += [
+                    If(resp.re,
+                        rx_pending.eq(1)
+                    ).Elif(ctrl.re & ctrl.storage[0],
+                        rx_pending.eq(0)
+                    )
+                ]
+                self.comb += status.status.eq(Cat(cmd.storage != 0, rx_pending))
 
         def _add_hardware_mutex(self):
             """添加硬件互斥锁"""
@@ -193,16 +1695,188 @@ def SoCLinux(soc_cls, **kwargs):
             # 连接状态
             self.comb += self.hw_mutex_status.status.eq(mutex_locked)
 
+        def _add_hardware_sync(self):
+            """添加计数信号量、事件标志组和句柄队列"""
+            print("  添加硬件同步块 (64个信号量, 16个事件组, 8个句柄队列)...")
+            
+            self.submodules.hw_sync = HardwareSync(num_sems=64, num_groups=16)
+            self.bus.add_slave(
+                "hw_sync",
+                self.hw_sync.bus,
+                SoCRegion(
+                    origin = 0x80140000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.ipi_sources.append(self.hw_sync.irq)
+            self.add_constant("HW_SYNC_BASE", 0x80140000)
+            
+            # 缓冲区句柄队列
+            self.submodules.queue_mgr = QueueManager(num_queues=8, depth=64)
+            self.bus.add_slave(
+                "queue_mgr",
+                self.queue_mgr.bus,
+                SoCRegion(
+                    origin = 0x80141000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.ipi_sources.append(self.queue_mgr.irq)
+            self.add_constant("QUEUE_MGR_BASE", 0x80141000)
+
+        def _add_core_timer(self):
+            """添加小核机器定时器 (接小核 timerInterrupt)"""
+            print("  添加小核定时器 (mtime/mtimecmp @ 0x80142000)...")
+            
+            self.submodules.core_timer = CoreTimer(num_cores=2)
+            self.bus.add_slave(
+                "core_timer",
+                self.core_timer.bus,
+                SoCRegion(
+                    origin = 0x80142000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.add_constant("CORE_TIMER_BASE", 0x80142000)
+
+        def _add_timed_mailbox(self):
+            """添加定时投递邮箱 (按CoreTimer的mtime投递)"""
+            print("  添加定时投递邮箱 (每个小核4个槽 @ 0x80143000)...")
+            
+            self.submodules.timed_mbox = TimedMailbox(self.core_timer.mtime,
+                num_cores=2, num_slots=4)
+            self.bus.add_slave(
+                "timed_mbox",
+                self.timed_mbox.bus,
+                SoCRegion(
+                    origin = 0x80143000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.ipi_sources.append(self.timed_mbox.irq)
+            self.add_constant("TIMED_MBOX_BASE", 0x80143000)
+
+        def _add_global_timebase(self):
+            """全局时基CSR和邮箱消息时间戳"""
+            print("  添加全局时基 (64位周期计数器) 和邮箱时间戳...")
+            
+            mtime = self.core_timer.mtime
+            
+            # 与小核定时器的mtime同一计数器, Linux和两个小核都可以经CSR读取
+            # 高低两个字不是同一拍采样, 按 高-低-高 读取, 两次高字不同时重读
+            self.submodules.global_time = CSRStatus(64, name="global_time",
+                description="Global cycle counter (sys_clk), shared by all six cores")
+            self.comb += self.global_time.status.eq(mtime)
+            
+            # 邮箱时间戳 (时基低32位), 同一消息的两个时间戳之差即单向延迟:
+            #   ts_send: 主核写入非零命令    ts_take: 小核清零命令(取走)
+            #   ts_resp: 小核写入响应        ts_ack:  主核确认响应
+            for core_id in range(2):
+                cmd  = getattr(self, f"mbox_main_to_core{core_id}_cmd")
+                resp = getattr(self, f"mbox_core{core_id}_to_main_resp")
+                ctrl = getattr(self, f"mbox_core{core_id}_to_main_ctrl")
+                
+                events = {
+                    "send": cmd.re & (cmd.storage != 0),
+                    "take": cmd.re & (cmd.storage == 0),
+                    "resp": resp.re,
+                    "ack":  ctrl.re & ctrl.storage[0],
+                }
+                for name, event in events.items():
+                    ts = CSRStatus(32, name=f"mbox_core{core_id}_ts_{name}")
+                    setattr(self.submodules, f"mbox_core{core_id}_ts_{name}", ts)
+                    self.sync += If(event, ts.status.eq(mtime[:32]))
+
+        def _add_irq_router(self):
+            """外设中断路由矩阵, 输出接RT核 externalInterruptArray[1:17]
+
+            中断源由 _add_irq_route_source 登记 (timer0在这里, 开关在add_switches里),
+            源号作为常量 IRQ_ROUTE_<名字> 导出给驱动和固件
+            """
+            print("  添加中断路由矩阵 (16个源 -> RT核/Linux)...")
+
+            self.submodules.irq_route = IrqRouter(self.core_timer.mtime, num_sources=16)
+            self.irq_route_names = []
+            # 转发给Linux: 置位hart0的IPI, 由hetero_regs分发
+            self.ipi_sources.append(Mux(self.irq_route.main_irq, 1 << 2, 0))
+
+            if hasattr(self, "timer0"):
+                self._add_irq_route_source("timer0", self.timer0.ev.zero.trigger)
+
+        def _add_irq_route_source(self, name, signal):
+            """把一个sys域的电平信号登记为路由矩阵的下一个中断源"""
+            n = len(self.irq_route_names)
+            if n >= len(self.irq_route.sources):
+                raise ValueError(f"中断路由矩阵已满, 无法添加 {name}")
+            self.comb += self.irq_route.sources[n].eq(signal)
+            self.irq_route_names.append(name)
+            self.add_constant(f"IRQ_ROUTE_{name.upper()}", n)
+            print(f"    中断路由源{n}: {name}")
+
+        def _connect_ipi_sources(self):
+            """把硬件中断源汇总到 ipi_pending"""
+            if self.ipi_sources:
+                self.comb += self.ipi_hw_set.eq(reduce(or_, self.ipi_sources))
+
         def _add_small_cores(self):
             """添加小核"""
             print("  添加小核...")
             
+            # 小核复位控制（remoteproc加载固件时保持复位）
+            self.submodules.small_core_reset = CSRStorage(2, name="small_core_reset",
+                description="Small core reset (1=hold core in reset)")
+            
             # 小核0：I/O处理核
             self._add_io_core(0, base_addr=0x80200000)
             
             # 小核1：实时任务核  
             self._add_rt_core(1, base_addr=0x80300000)
 
+        def _small_core_clocking(self, core_id):
+            """小核时钟域和输入信号
+
+            未指定频率时小核与Linux同在sys域; 否则由CRG的PLL另出一路时钟,
+            频率相同的两个小核共用一个时钟域. 复位/定时器中断/IPI都是电平信号,
+            两级同步进小核时钟域; CSR和共享内存经 WishboneAsyncBridge 访问.
+            返回 (时钟域名, 复位, 定时器中断, IPI)
+            """
+            freq  = self.small_core_clk_freq[core_id]
+            reset = self.small_core_reset.storage[core_id]
+            timer = self.core_timer.irq[core_id]
+            ipi   = self.ipi_pending[core_id]
+            if freq is None:
+                return "sys", ResetSignal("sys") | reset, timer, ipi
+            
+            cd_name = self._small_core_cds.get(freq)
+            if cd_name is None:
+                pll = getattr(self.crg, "pll", None)
+                if pll is None:
+                    raise ValueError("小核独立时钟需要板级CRG提供PLL (self.crg.pll)")
+                cd_name = f"small_{int(freq/1e6)}mhz"
+                cd = ClockDomain(cd_name)
+                self.clock_domains += cd
+                pll.create_clkout(cd, freq)
+                self.platform.add_false_path_constraints(self.crg.cd_sys.clk, cd.clk)
+                self._small_core_cds[freq] = cd_name
+                print(f"    小核时钟域 {cd_name}: {freq/1e6:.0f}MHz")
+            
+            synced = []
+            for name, sig in [("reset", reset), ("timer", timer), ("ipi", ipi)]:
+                o = Signal(name=f"small_core{core_id}_{name}_sync")
+                self.specials += MultiReg(sig, o, cd_name)
+                synced.append(o)
+            self.add_constant(f"SMALL_CORE{core_id}_CLK_FREQ", int(freq))
+            
+            return cd_name, ResetSignal(cd_name) | synced[0], synced[1], synced[2]
+
         def _add_io_core(self, core_id, base_addr):
             """添加I/O处理小核 - 使用第二个版本的完整实现"""
             print(f"    添加小核{core_id} (I/O处理) @ 0x{base_addr:08x}")
@@ -232,19 +1906,29 @@ def SoCLinux(soc_cls, **kwargs):
             dbus_bte = Signal(2, name=f"io_core_dbus_bte")
             dbus_err = Signal(name=f"io_core_dbus_err")
 
+            cd, core_reset, timer_irq, ipi = self._small_core_clocking(core_id)
+
+            # 以太网接收完成FIFO非空 (externalInterruptArray[1], 由_add_io_core_ethernet驱动),
+            # 电平信号, 独立时钟域时同步进小核时钟域
+            self.io_eth_irq = Signal(name="io_core_eth_irq")
+            eth_irq = self.io_eth_irq
+            if cd != "sys":
+                eth_irq = Signal(name=f"small_core{core_id}_eth_irq_sync")
+                self.specials += MultiReg(self.io_eth_irq, eth_irq, cd)
+
             # 实例化VexRiscv_IOCore
             self.specials += Instance("VexRiscv_IOCore",
                 name=f"vexriscv_io_core_{core_id}",
                 
                 # 时钟和复位
-                i_clk = ClockSignal("sys"),
-                i_reset = ResetSignal("sys"),
+                i_clk = ClockSignal(cd),
+                i_reset = core_reset,
                 
                 # 配置 - 使用第一个版本的中断信号
                 i_externalResetVector = base_addr,
-                i_timerInterrupt = 0,
+                i_timerInterrupt = timer_irq,
                 i_softwareInterrupt = 0,
-                i_externalInterruptArray = Cat(self.ipi_pending[core_id], Signal(31)),
+                i_externalInterruptArray = Cat(ipi, eth_irq, Signal(30)),
                 
                 # 指令总线
                 o_iBusWishbone_CYC = ibus_cyc,
@@ -278,12 +1962,13 @@ def SoCLinux(soc_cls, **kwargs):
                                  ibus_cyc, ibus_stb, ibus_ack, ibus_we, ibus_cti, 
                                  ibus_bte, ibus_err, dbus_adr, dbus_dat_w, dbus_dat_r,
                                  dbus_sel, dbus_cyc, dbus_stb, dbus_ack, dbus_we,
-                                 dbus_cti, dbus_bte, dbus_err, base_addr)
+                                 dbus_cti, dbus_bte, dbus_err, base_addr, cd)
 
             # 添加源文件
             verilog_paths = [
                 f"/home/eda/Desktop/6_core/litex-custom-uart/VexRiscv_IOCore.v",
                 f"/home/eda/FUWEI/litex-custom-uart/VexRiscv_IOCore.v",
+                os.path.join(os.path.dirname(os.path.abspath(__file__)), "VexRiscv_IOCore.v"),
             ]
             
             for path in verilog_paths:
@@ -323,19 +2008,30 @@ def SoCLinux(soc_cls, **kwargs):
             dbus_bte = Signal(2, name=f"rt_core_dbus_bte")
             dbus_err = Signal(name=f"rt_core_dbus_err")
 
+            cd, core_reset, timer_irq, ipi = self._small_core_clocking(core_id)
+
+            # 路由矩阵的挂起位和RT核PWM的生效标志 (externalInterruptArray[17], 由
+            # _add_rt_core_pwm驱动) 都是电平信号, 独立时钟域时同步进小核时钟域
+            self.rt_pwm_irq = Signal(name="rt_core_pwm_irq")
+            routed = Cat(self.irq_route.rt_irq, self.rt_pwm_irq)
+            if cd != "sys":
+                synced = Signal(len(routed), name=f"small_core{core_id}_irq_route_sync")
+                self.specials += MultiReg(routed, synced, cd)
+                routed = synced
+
             # 实例化VexRiscv_RTCore
             self.specials += Instance("VexRiscv_RTCore",
                 name=f"vexriscv_rt_core_{core_id}",
                 
                 # 时钟和复位
-                i_clk = ClockSignal("sys"),
-                i_reset = ResetSignal("sys"),
+                i_clk = ClockSignal(cd),
+                i_reset = core_reset,
                 
                 # 配置
                 i_externalResetVector = base_addr,
-                i_timerInterrupt = 0,
+                i_timerInterrupt = timer_irq,
                 i_softwareInterrupt = 0,
-                i_externalInterruptArray = Cat(self.ipi_pending[core_id], Signal(31)),
+                i_externalInterruptArray = Cat(ipi, routed, Signal(31 - len(routed))),
                 
                 # 指令总线
                 o_iBusWishbone_CYC = ibus_cyc,
@@ -369,12 +2065,13 @@ def SoCLinux(soc_cls, **kwargs):
                                  ibus_cyc, ibus_stb, ibus_ack, ibus_we, ibus_cti, 
                                  ibus_bte, ibus_err, dbus_adr, dbus_dat_w, dbus_dat_r,
                                  dbus_sel, dbus_cyc, dbus_stb, dbus_ack, dbus_we,
-                                 dbus_cti, dbus_bte, dbus_err, base_addr)
+                                 dbus_cti, dbus_bte, dbus_err, base_addr, cd)
 
             # 添加源文件
             verilog_paths = [
                 f"/home/eda/Desktop/6_core/litex-custom-uart/VexRiscv_RTCore.v",
                 f"/home/eda/FUWEI/litex-custom-uart/VexRiscv_RTCore.v",
+                os.path.join(os.path.dirname(os.path.abspath(__file__)), "VexRiscv_RTCore.v"),
             ]
             
             for path in verilog_paths:
@@ -385,12 +2082,110 @@ def SoCLinux(soc_cls, **kwargs):
             
             print(f"  ✓ 实时任务核已添加 (基址: 0x{base_addr:08x})")
 
+        # L2 Cache ---------------------------------------------------------------------------------
+        def add_sdram(self, *args, **kwargs):
+            """异构系统里LiteX建L2时换成HeteroL2Cache (4路, 可按主设备分区/旁路)
+
+            L2在LiteX add_sdram内部创建, 这里只在调用期间替换 wishbone.Cache
+            """
+            if not self.with_heterogeneous:
+                return soc_cls.add_sdram(self, *args, **kwargs)
+            cache_cls = wishbone.Cache
+            wishbone.Cache = HeteroL2Cache
+            try:
+                return soc_cls.add_sdram(self, *args, **kwargs)
+            finally:
+                wishbone.Cache = cache_cls
+
+        def _add_l2_control(self, names, grant):
+            """按当前总线授权的主设备选择L2可替换的路, 并分主设备统计命中/未命中
+
+            主设备分三类: 0 IO核, 1 RT核, 2 Linux (CPU和其余DMA主设备)
+            """
+            print("  添加L2分区控制...")
+            l2 = self.l2_cache
+            ways = len(l2.way_mask)
+            source_of = lambda name: {"small_core_0": 0, "small_core_1": 1}.get(name[:12], 2)
+            bypass_bits = {"io": 1 << 1, "rt": 1 << 2, "main": 1 << 3}
+            reset = int(self.l2_partition == "rt")
+            for b in self.l2_bypass:
+                reset |= bypass_bits[b]
+            self.submodules.l2_ctrl = CSRStorage(4, reset=reset, name="l2_ctrl",
+                description="bit0 = RT core owns the last L2 way, bit1/2/3 = IO core/RT core/Linux bypass (no allocate)")
+
+            source = Signal(2)
+            self.comb += source.eq(Array(source_of(name) for name in names)[grant])
+
+            ctrl = self.l2_ctrl.storage
+            rt_way = 1 << (ways - 1)
+            all_ways = 2**ways - 1
+            self.comb += [
+                l2.way_mask.eq(all_ways),
+                If(ctrl[0],
+                    l2.way_mask.eq(Mux(source == 1, rt_way, all_ways ^ rt_way))
+                ),
+                If(Array(ctrl[1 + n] for n in range(3))[source],
+                    l2.way_mask.eq(0)
+                )
+            ]
+
+            # 每类主设备的命中/未命中计数, 自由运行
+            for n, tag in enumerate(["core0", "core1", "main"]):
+                hit  = CSRStatus(32, name=f"l2_hit_{tag}", description="L2 hits")
+                miss = CSRStatus(32, name=f"l2_miss_{tag}", description="L2 misses")
+                setattr(self.submodules, f"l2_hit_{tag}", hit)
+                setattr(self.submodules, f"l2_miss_{tag}", miss)
+                self.sync += [
+                    If(l2.hit & (source == n), hit.status.eq(hit.status + 1)),
+                    If(l2.miss & (source == n), miss.status.eq(miss.status + 1)),
+                ]
+
+        def _add_bus_qos(self):
+            """用QoSArbiter汇合所有总线主设备, RT核ibus/dbus固定最高优先级
+
+            在finalize里做, 这样make.py之后添加的DMA主设备也在内;
+            LiteX互连只看到一个主设备 (crossbar互连也退化为共享总线).
+            有HeteroL2Cache时 --bus-qos rr 也经这里汇合 (优先级复位为关),
+            L2按仲裁器的授权区分主设备
+            """
+            print("  添加总线QoS仲裁 (RT核优先)...")
+            
+            masters = self.bus.masters
+            high_names = ["small_core_1_dbus", "small_core_1_ibus"]
+            high = [masters.pop(name) for name in high_names]
+            low_names = list(masters.keys())
+            low  = list(masters.values())
+            masters.clear()
+            
+            qos_bus = wishbone.Interface(data_width=32, adr_width=30)
+            self.submodules.bus_qos_arbiter = QoSArbiter(high, low, qos_bus)
+            self.bus.add_master(name="hetero_qos", master=qos_bus)
+            
+            # 运行时可关闭优先级, 便于对比总线等待计数
+            self.submodules.bus_qos_ctrl = CSRStorage(1, reset=int(self.bus_qos == "rt"), name="bus_qos_ctrl",
+                description="1 = RT core masters have fixed highest bus priority, 0 = round-robin")
+            self.comb += self.bus_qos_arbiter.enable.eq(self.bus_qos_ctrl.storage)
+
+            if isinstance(getattr(self, "l2_cache", None), HeteroL2Cache):
+                self._add_l2_control(high_names + low_names, self.bus_qos_arbiter.grant)
+
+        def finalize(self):
+            hetero_l2 = isinstance(getattr(self, "l2_cache", None), HeteroL2Cache)
+            if self.with_heterogeneous and (self.bus_qos == "rt" or hetero_l2) and not self.finalized:
+                self._add_bus_qos()
+            soc_cls.finalize(self)
+
         def _connect_wishbone(self, core_id, ibus_adr, ibus_dat_w, ibus_dat_r, 
                               ibus_sel, ibus_cyc, ibus_stb, ibus_ack, ibus_we,
                               ibus_cti, ibus_bte, ibus_err, dbus_adr, dbus_dat_w,
                               dbus_dat_r, dbus_sel, dbus_cyc, dbus_stb, dbus_ack,
-                              dbus_we, dbus_cti, dbus_bte, dbus_err, base_addr):
+                              dbus_we, dbus_cti, dbus_bte, dbus_err, base_addr, cd="sys"):
             """连接Wishbone总线"""
+            # 关闭突发时CTI/BTE置0, 目标只看到经典周期
+            if not self.small_core_bursts:
+                ibus_cti, ibus_bte = Constant(0, 3), Constant(0, 2)
+                dbus_cti, dbus_bte = Constant(0, 3), Constant(0, 2)
+
             # 指令总线
             ibus = wishbone.Interface(data_width=32, adr_width=30)
             self.comb += [
@@ -423,10 +2218,37 @@ def SoCLinux(soc_cls, **kwargs):
                 dbus_err.eq(dbus.err),
             ]
 
+            # 小核不在sys域时经异步桥接入系统总线, 下面的统计也在sys侧
+            if cd != "sys":
+                ibus_cdc = WishboneAsyncBridge(cd)
+                dbus_cdc = WishboneAsyncBridge(cd)
+                setattr(self.submodules, f"small_core_{core_id}_ibus_cdc", ibus_cdc)
+                setattr(self.submodules, f"small_core_{core_id}_dbus_cdc", dbus_cdc)
+                self.comb += [
+                    ibus.connect(ibus_cdc.master),
+                    dbus.connect(dbus_cdc.master),
+                ]
+                ibus, dbus = ibus_cdc.slave, dbus_cdc.slave
+
             # 添加到系统总线
             self.bus.add_master(name=f"small_core_{core_id}_ibus", master=ibus)
             self.bus.add_master(name=f"small_core_{core_id}_dbus", master=dbus)
 
+            # 总线统计: 等待周期 (cyc&stb未ack, ibus和dbus分别计) 和完成的传输数,
+            # 自由运行, 软件取两次读数之差
+            bus_wait = CSRStatus(32, name=f"bus_wait_core{core_id}",
+                description="Bus cycles spent waiting for ack (ibus + dbus)")
+            bus_xfer = CSRStatus(32, name=f"bus_xfer_core{core_id}",
+                description="Completed bus transfers (ibus + dbus)")
+            setattr(self.submodules, f"bus_wait_core{core_id}", bus_wait)
+            setattr(self.submodules, f"bus_xfer_core{core_id}", bus_xfer)
+            waits = [b.cyc & b.stb & ~b.ack for b in (ibus, dbus)]
+            acks  = [b.cyc & b.stb & b.ack for b in (ibus, dbus)]
+            self.sync += [
+                bus_wait.status.eq(bus_wait.status + waits[0] + waits[1]),
+                bus_xfer.status.eq(bus_xfer.status + acks[0] + acks[1]),
+            ]
+
             # 分配内存区域
             self.bus.add_region(
                 f"small_core_{core_id}_mem",
@@ -441,23 +2263,126 @@ def SoCLinux(soc_cls, **kwargs):
         # RGB Led ----------------------------------------------------------------------------------
         def add_rgb_led(self):
             rgb_led_pads = self.platform.request("rgb_led", 0)
+            if self.with_heterogeneous and self.pwm_offload:
+                return self._add_rt_core_pwm([getattr(rgb_led_pads, n) for n in "rgb"])
             for n in "rgb":
                 self.add_module(name=f"rgb_led_{n}0", module=PWM(getattr(rgb_led_pads, n)))
 
+        def _add_rt_core_pwm(self, pads):
+            """PWM接到RT核的总线从设备上, 不生成rgb_led CSR (设备树里也就没有这些节点)"""
+            print(f"  PWM交给RT核 ({len(pads)}通道, 影子寄存器 @ 0x80146000)...")
+            
+            self.submodules.rt_pwm = RTCorePWM(pads)
+            self.bus.add_slave(
+                "rt_pwm",
+                self.rt_pwm.bus,
+                SoCRegion(
+                    origin = 0x80146000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.comb += self.rt_pwm_irq.eq(self.rt_pwm.irq)
+            self.add_constant("RT_PWM_BASE", 0x80146000)
+            self.add_constant("RT_PWM_NUM_CHANNELS", len(pads))
+
         # Switches ---------------------------------------------------------------------------------
         def add_switches(self):
             self.switches = GPIOIn(Cat(self.platform.request_all("user_sw")), with_irq=True)
             self.irq.add("switches")
+            # 每个开关也是路由矩阵的一个源 (GPIOIn的输入已同步到sys域)
+            if self.with_heterogeneous:
+                for i in range(len(self.switches._in.status)):
+                    self._add_irq_route_source(f"switch{i}", self.switches._in.status[i])
 
         # SPI --------------------------------------------------------------------------------------
         def add_spi(self, data_width, clk_freq):
             spi_pads = self.platform.request("spi")
+            if self.with_heterogeneous and self.spi_offload:
+                return self._add_io_core_spi(spi_pads, clk_freq)
             self.spi = SPIMaster(spi_pads, data_width, self.clk_freq, clk_freq)
 
+        def _add_io_core_spi(self, pads, clk_freq):
+            """SPI接到IO核的总线从设备上 (8位字), 不生成spi CSR;
+            设备树里是compatible = "litex,hetero-spi"的控制器节点, 从设备由overlay添加
+            """
+            print("  SPI交给IO核 (收发FIFO @ 0x80145000)...")
+            
+            self.submodules.io_spi = IOCoreSPI(pads, self.clk_freq, clk_freq)
+            self.bus.add_slave(
+                "io_spi",
+                self.io_spi.bus,
+                SoCRegion(
+                    origin = 0x80145000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.add_constant("IO_SPI_BASE", 0x80145000)
+            self.add_constant("IO_SPI_NUM_CS", len(pads.cs_n))
+
         # I2C --------------------------------------------------------------------------------------
         def add_i2c(self):
+            if self.with_heterogeneous and self.i2c_offload:
+                return self._add_io_core_i2c()
             self.i2c0 = I2CMaster(self.platform.request("i2c", 0))
 
+        def _add_io_core_i2c(self):
+            """I2C引脚接到IO核的总线从设备上, 不生成i2c0 CSR (设备树里也就没有i2c0节点)"""
+            print("  I2C交给IO核 (引脚寄存器 @ 0x80144000)...")
+            
+            self.submodules.io_i2c = IOCoreI2C(self.platform.request("i2c", 0))
+            self.bus.add_slave(
+                "io_i2c",
+                self.io_i2c.bus,
+                SoCRegion(
+                    origin = 0x80144000,
+                    size   = 0x1000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.add_constant("IO_I2C_BASE", 0x80144000)
+
+        # Ethernet ---------------------------------------------------------------------------------
+        def add_ethernet(self, *args, phy=None, **kwargs):
+            if self.with_heterogeneous and self.eth_offload:
+                # 在异构部分之前调用, 先记下PHY, 由_add_heterogeneous_cores接到IO核
+                self._io_eth_phy = phy
+                return
+            soc_cls.add_ethernet(self, *args, phy=phy, **kwargs)
+
+        def _add_io_core_ethernet(self, phy):
+            """以太网MAC接到IO核的总线从设备上, 不生成ethmac CSR (设备树里也就没有ethmac节点);
+            IO核把过滤/分类后的帧成批放进共享内存的接收环, Linux用hetero_eth网卡
+            """
+            print("  以太网交给IO核 (收发槽 @ 0x80150000)...")
+            
+            self.submodules.io_eth = IOCoreEthernet(phy, self.core_timer.mtime)
+            self.bus.add_slave(
+                "io_eth",
+                self.io_eth.bus,
+                SoCRegion(
+                    origin = 0x80150000,
+                    size   = 0x10000,
+                    mode   = "rw",
+                    cached = False
+                )
+            )
+            self.comb += self.io_eth_irq.eq(self.io_eth.irq)
+            self.add_constant("IO_ETH_BASE", 0x80150000)
+            
+            # PHY时钟约束, 与LiteX add_ethernet相同
+            eth_rx_clk = getattr(phy, "crg", phy).cd_eth_rx.clk
+            eth_tx_clk = getattr(phy, "crg", phy).cd_eth_tx.clk
+            if not getattr(phy, "model", False):
+                self.platform.add_period_constraint(eth_rx_clk, 1e9/phy.rx_clk_freq)
+                if eth_rx_clk is not eth_tx_clk:
+                    self.platform.add_period_constraint(eth_tx_clk, 1e9/phy.tx_clk_freq)
+                self.platform.add_false_path_constraints(self.crg.cd_sys.clk, eth_rx_clk, eth_tx_clk)
+
         # Ethernet configuration -------------------------------------------------------------------
         def configure_ethernet(self, remote_ip):
             remote_ip = remote_ip.split(".")
@@ -479,8 +2404,39 @@ def SoCLinux(soc_cls, **kwargs):
             dts = os.path.join("build", board_name, "{}.dts".format(board_name))
 
             with open(json_src) as json_file, open(dts, "w") as dts_file:
-                dts_content = generate_dts(json.load(json_file), polling=False)
+                csr_json = json.load(json_file)
+                dts_content = generate_dts(csr_json, polling=False)
                 dts_file.write(dts_content)
+                
+                # 一致性共享内存: 从主存中保留出来, 由hetero驱动按可缓存方式映射
+                phys = csr_json["constants"].get("shared_mem_phys")
+                if phys is not None:
+                    dts_file.write(
+                        "\n/ {\n"
+                        "    reserved-memory {\n"
+                        "        #address-cells = <1>;\n"
+                        "        #size-cells    = <1>;\n"
+                        "        ranges;\n"
+                        f"        hetero_shm: hetero-shm@{phys:x} {{\n"
+                        f"            reg = <0x{phys:08x} 0x8000>;\n"
+                        "            no-map;\n"
+                        "        };\n"
+                        "    };\n"
+                        "};\n")
+                
+                # IO核SPI控制器, 标签供overlay添加从设备
+                num_cs = csr_json["constants"].get("io_spi_num_cs")
+                if num_cs is not None:
+                    dts_file.write(
+                        "\n/ {\n"
+                        "    hetero_spi: spi {\n"
+                        "        compatible = \"litex,hetero-spi\";\n"
+                        "        #address-cells = <1>;\n"
+                        "        #size-cells    = <0>;\n"
+                        f"        num-cs = <{num_cs}>;\n"
+                        "        status = \"okay\";\n"
+                        "    };\n"
+                        "};\n")
 
         # DTS compilation --------------------------------------------------------------------------
         def compile_dts(self, board_name, symbols=False):